@@ -0,0 +1,283 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+#include <benchmark/benchmark.h>
+
+#include "CompareFolders.hpp"
+#include "CCollectionInfo.hpp"
+#include "CFactoryInfo.hpp"
+#include "CHasher.hpp"
+#include "CHasherMulti.hpp"
+
+#include "bench_library.hpp"
+
+
+using namespace std;
+
+
+
+///////////////////////
+
+/// @brief Returns some content depending on a seed
+static string Content(const size_t size, uint32_t seed)
+{
+    string content(size, '\0');
+    for (auto& c : content) {
+        seed = seed * 1664525u + 1013904223u; // LCG: deterministic and cheap
+        c = static_cast<char>(seed >> 24);
+    }
+    return content;
+}
+
+
+/// @brief Returns a collection of synthetic entries
+/// @param nb_files Number of entries
+/// @param salt     Changes the hash of one entry out of salt. None if 0.
+static cf::CCollectionInfo Build_Collection(const string& root, const size_t nb_files, const size_t salt = 0u)
+{
+    cf::CCollectionInfo collection{ root, cf::eCollectingAlgorithm::SECURE };
+    for (auto i = 0u; i < nb_files; ++i) {
+        auto hash = to_string(i * 2654435761u);
+        if (salt != 0u && i % salt == 0u) {
+            hash += 'X';
+        }
+        collection.setInfo("folder_" + to_string(i / 100u) + "/file_" + to_string(i), { hash, 1500000000, 4096u });
+    }
+    return collection;
+}
+
+
+/// @brief Gives access to the protected operations of the factories
+class CFactoryBench : public cf::CFactoryInfoFast
+{
+public:
+    CFactoryBench() :
+        cf::CFactoryInfoFast{ make_unique<cf::CLoggerNull>(), options() }
+    {   }
+    using cf::AFactoryInfo::listFiles;
+    using cf::AFactoryInfo::listed_t;
+
+private:
+    static cf::options_t options() {
+        cf::options_t options;
+        options.period_progress_ms = 0u;
+        return options;
+    }
+};
+
+
+/// @brief Returns options disabling the progress reports
+static cf::options_t Options_Bench()
+{
+    cf::options_t options;
+    options.period_progress_ms = 0u;
+    return options;
+}
+
+
+
+/////////////////////// ENUMERATION
+
+static void BM_ListFiles(benchmark::State& state)
+{
+    CFactoryBench factory;
+    size_t nb_files = 0u;
+    for (auto _ : state) {
+        nb_files = 0u;
+        factory.listFiles(Tree, [&nb_files](CFactoryBench::listed_t&&) {
+            ++nb_files;
+            return true;
+        });
+        benchmark::DoNotOptimize(nb_files);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * nb_files));
+}
+BENCHMARK(BM_ListFiles)->Unit(benchmark::kMillisecond);
+
+
+
+/////////////////////// HASHING
+
+/// @brief Hashes a single file, whose size is the argument
+static void BM_HashFile(benchmark::State& state)
+{
+    const auto size = static_cast<size_t>(state.range(0));
+    const auto path = fs::temp_directory_path() / "compare_folders_bench_hash";
+    {
+        ofstream stream{ path.string(), ios::out | ios::binary };
+        stream << Content(size, 42u);
+    }
+    const cf::CFactoryInfoSecure factory{ make_unique<cf::CLoggerNull>(), Options_Bench() };
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(factory.collectFile(path));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+    fs::remove(path);
+}
+BENCHMARK(BM_HashFile)->Arg(4 << 10)->Arg(1 << 20)->Arg(16 << 20)->Unit(benchmark::kMicrosecond);
+
+
+/// @brief Hashes 1 MiB in memory with the algorithm given as argument: 0 for SHA-1, 1 for SHA-256
+/// @details The label tells the implementation selected at runtime.
+static void BM_Hasher(benchmark::State& state)
+{
+    constexpr size_t SIZE = 1u << 20;
+    const auto content = Content(SIZE, 42u);
+    cf::CHasher hasher{ state.range(0) == 0 ? cf::CHasher::eAlgorithm::SHA1 : cf::CHasher::eAlgorithm::SHA256 };
+    for (auto _ : state) {
+        hasher.update(content.data(), content.size());
+        benchmark::DoNotOptimize(hasher.digest());
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * SIZE));
+    state.SetLabel(hasher.name() + " " + hasher.provider());
+}
+BENCHMARK(BM_Hasher)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+
+/// @brief Hashes 1024 small messages of 1 KiB: one by one if the argument is 0, by multi-buffer otherwise
+static void BM_HasherMulti(benchmark::State& state)
+{
+    constexpr size_t NB_MESSAGES = 1024u;
+    vector<string> messages;
+    for (auto i = 0u; i < NB_MESSAGES; ++i) {
+        messages.push_back(Content(1024u, i));
+    }
+    cf::CHasher hasher;
+    for (auto _ : state) {
+        if (state.range(0) == 0) {
+            for (const auto& message : messages) {
+                hasher.update(message.data(), message.size());
+                benchmark::DoNotOptimize(hasher.digest());
+            }
+        }
+        else {
+            benchmark::DoNotOptimize(cf::CHasherMulti::Digests(messages));
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * NB_MESSAGES));
+    state.SetLabel(state.range(0) == 0 ? hasher.provider() : cf::CHasherMulti::Provider());
+}
+BENCHMARK(BM_HasherMulti)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+
+
+/////////////////////// COLLECTIONS
+
+/// @brief Fills a collection, whose number of entries is the argument
+static void BM_SetInfo(benchmark::State& state)
+{
+    const auto nb_files = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Build_Collection("root", nb_files));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * nb_files));
+}
+BENCHMARK(BM_SetInfo)->Arg(1000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+
+/// @brief Compares two collections differing by one entry out of ten
+static void BM_Compare(benchmark::State& state)
+{
+    const auto nb_files = static_cast<size_t>(state.range(0));
+    const auto left = Build_Collection("left", nb_files);
+    const auto right = Build_Collection("right", nb_files, 10u);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(left.compare(right));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * nb_files));
+}
+BENCHMARK(BM_Compare)->Arg(1000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+
+
+/////////////////////// SERIALIZATION
+
+static void BM_Json(benchmark::State& state)
+{
+    const auto nb_files = static_cast<size_t>(state.range(0));
+    const auto collection = Build_Collection("root", nb_files);
+    size_t size = 0u;
+    for (auto _ : state) {
+        const auto json = collection.json();
+        size = json.size();
+        benchmark::DoNotOptimize(json);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * size));
+}
+BENCHMARK(BM_Json)->Arg(1000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+
+static void BM_ReadInfo(benchmark::State& state)
+{
+    const auto nb_files = static_cast<size_t>(state.range(0));
+    const auto path = fs::temp_directory_path() / "compare_folders_bench.json";
+    const auto json = Build_Collection("root", nb_files).json();
+    {
+        ofstream stream{ path.string(), ios::out | ios::binary };
+        stream << json;
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cf::AFactoryInfo::ReadInfo(path));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * json.size()));
+    fs::remove(path);
+}
+BENCHMARK(BM_ReadInfo)->Arg(1000)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+
+
+/////////////////////// END TO END
+
+/// @brief Scans the tree with the algorithm given as argument: 0 for secure, 1 for fast
+static void BM_ScanFolder(benchmark::State& state)
+{
+    const auto algo = state.range(0) == 0 ? cf::eCollectingAlgorithm::SECURE : cf::eCollectingAlgorithm::FAST;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cf::ScanFolder(Tree.string(), algo, make_unique<cf::CLoggerNull>(), Options_Bench()));
+    }
+}
+BENCHMARK(BM_ScanFolder)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+/// @brief Scans the tree with the fast algorithm, requesting the number of statuses given as argument at once
+static void BM_ScanFolderFast(benchmark::State& state)
+{
+    auto options = Options_Bench();
+    options.depth_stat = static_cast<unsigned>(state.range(0));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cf::ScanFolder(Tree.string(), cf::eCollectingAlgorithm::FAST, make_unique<cf::CLoggerNull>(), options));
+    }
+}
+BENCHMARK(BM_ScanFolderFast)->Arg(1)->Arg(4)->Arg(16)->Arg(64)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+
+/// @brief Compares the tree with itself, with the algorithm given as argument: 0 for secure, 1 for fast
+static void BM_CompareFolders(benchmark::State& state)
+{
+    const auto algo = state.range(0) == 0 ? cf::eCollectingAlgorithm::SECURE : cf::eCollectingAlgorithm::FAST;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cf::CompareFolders(Tree.string(), Tree.string(), algo, make_unique<cf::CLoggerNull>(), Options_Bench()));
+    }
+}
+BENCHMARK(BM_CompareFolders)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,66 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#include <iostream>
+#include <exception>
+
+#include <benchmark/benchmark.h>
+
+#include "CTreeGenerator.hpp"
+#include "bench_library.hpp"
+
+
+using namespace std;
+
+
+fs::path Tree;
+
+
+/// @brief Runs the benchmarks on a tree built once
+/// @details Use --benchmark_out=<file> --benchmark_out_format=json to store the results
+int main(int argc, char* argv[])
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+
+    int result = 0;
+    Tree = fs::temp_directory_path() / "compare_folders_bench";
+    try {
+        // 2000 files of 4 KiB, all different
+        spec_tree_t spec;
+        spec.depth = 1u;
+        spec.nb_folders = 20u;
+        spec.nb_files = 100u;
+        spec.size_min = 4u * 1024u;
+        spec.size_max = 4u * 1024u;
+        spec.ratio_duplicates = 0.0;
+        fs::remove_all(Tree);
+        CTreeGenerator{ spec }.generate(Tree);
+        benchmark::RunSpecifiedBenchmarks();
+    }
+    catch (const exception& e) {
+        cout << e.what() << endl;
+        result = -1;
+    }
+
+    boost::system::error_code error;
+    fs::remove_all(Tree, error);
+    return result;
+}
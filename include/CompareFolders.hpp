@@ -19,71 +19,103 @@
 #ifndef _SRC_EXCEPTIONS_H__
 #define _SRC_EXCEPTIONS_H__
 
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
 #include <stdexcept>
 #include <list>
 #include <string>
 #include <memory>
+#include <iosfwd>
 
 namespace cf
 {
       /// @brief Description of the keys used in JSON files
+      /// @details All the strings handled by the library are encoded in UTF-8
       struct JSON_KEYS_t{
          /// @brief Differences betwwen two folders
          struct DIFF_t{
-             std::wstring IDENTICAL;///< Identical files
-             std::wstring DIFFERENT;///< Different files
-             std::wstring UNIQUE_LEFT;///< Files that are unique to the left
-             std::wstring UNIQUE_RIGHT;///< Files that are unique to the right
-             std::wstring RENAMED;///< Files that are identical but where renamed, moved or duplicated
-             std::wstring LEFT;
-             std::wstring RIGHT;
+             std::string IDENTICAL;///< Identical files
+             std::string DIFFERENT;///< Different files
+             std::string UNIQUE_LEFT;///< Files that are unique to the left
+             std::string UNIQUE_RIGHT;///< Files that are unique to the right
+             std::string RENAMED;///< Files that are identical but where renamed, moved or duplicated
+             std::string LEFT;
+             std::string RIGHT;
          };
          /// @brief Description of a folder's content
          struct CONTENT_t{
-             std::wstring FILES;//< Files inside a folder
-             std::wstring HASH;///< Hash of a file's content
-             std::wstring TIME;///< Time of file's last modification
-             std::wstring SIZE;///< Size of the file
+             std::string FILES;//< Files inside a folder
+             std::string HASH;///< Hash of a file's content
+             std::string TIME;///< Time of file's last modification
+             std::string SIZE;///< Size of the file
+             std::string DIRECTORIES;///< Aggregate digests of the directories
+             std::string ERRORS;///< Files that could not be read, and why
          };
-         std::wstring GENERATOR; ///< Program used to generate the JSON file
-         std::wstring ROOT;///< Root folder
-         std::wstring ALGO_HASH;///< Algorithm used to compute hashes
+         /// @brief Changes of a folder's content relative to a base
+         struct DELTA_t{
+             std::string BASE;///< Digest of the base's root
+             std::string DIGEST;///< Digest of the root, once the changes applied
+             std::string ADDED;///< Files added
+             std::string MODIFIED;///< Files modified
+             std::string REMOVED;///< Files removed
+         };
+         std::string GENERATOR; ///< Program used to generate the JSON file
+         std::string ROOT;///< Root folder
+         std::string ALGO_HASH;///< Algorithm used to compute hashes
+         std::string TIME_SCAN;///< Time when the scan started, in seconds and their fraction
          DIFF_t DIFF;
          CONTENT_t CONTENT;
+         DELTA_t DELTA;
      };
 
      /// @brief Description of the const values that may be used in JSON files
      struct JSON_CONST_VALUES_t {
-         std::wstring GENERATOR;
-         std::wstring ALGO_HASH_FAST;
-         std::wstring ALGO_HASH_SECURE;
+         std::string GENERATOR;
+         std::string ALGO_HASH_FAST;    ///< Fast algorithm, the modification times in whole seconds. Written by the former versions.
+         std::string ALGO_HASH_FAST_NS; ///< Fast algorithm, the modification times with their fraction of second
+         std::string ALGO_HASH_SECURE;
+         std::string HASH_SAMPLED;  ///< Prefix of the hashes computed on samples of a file, followed by `<size_sampling>x<nb_samples>:`
      };
 
      static const JSON_KEYS_t JSON_KEYS {
-         L"Generator",                   // GENERATOR
-         L"root",                        // ROOT
-         L"hash",                        // ALGO_HASH
+         "Generator",                   // GENERATOR
+         "root",                        // ROOT
+         "hash",                        // ALGO_HASH
+         "scanned",                     // TIME_SCAN
          {   // DIFF
-             L"identical",               // IDENTICAL
-             L"different",               // DIFFERENT
-             L"unique left",             // UNIQUE_LEFT
-             L"unique right",            // UNIQUE_RIGHT
-             L"renamed and duplicates",  // RENAMED
-             L"left",                    // LEFT
-             L"right"                    // RIGHT
+             "identical",               // IDENTICAL
+             "different",               // DIFFERENT
+             "unique left",             // UNIQUE_LEFT
+             "unique right",            // UNIQUE_RIGHT
+             "renamed and duplicates",  // RENAMED
+             "left",                    // LEFT
+             "right"                    // RIGHT
          },
          {   // CONTENT
-             L"files",                   // FILES
-             L"hash",                    // HASH
-             L"last_modified",           // TIME
-             L"size"                     // SIZE
+             "files",                   // FILES
+             "hash",                    // HASH
+             "last_modified",           // TIME
+             "size",                    // SIZE
+             "directories",             // DIRECTORIES
+             "errors"                   // ERRORS
+         },
+         {   // DELTA
+             "base",                    // BASE
+             "digest",                  // DIGEST
+             "added",                   // ADDED
+             "modified",                // MODIFIED
+             "removed"                  // REMOVED
          }
      };
 
      static const JSON_CONST_VALUES_t JSON_CONST_VALUES {
-         L"info.xtof.COMPARE_FOLDERS",   // GENERATOR
-         L"fast",                        // ALGO_HASH_FAST
-         L"secure"                       // ALGO_HASH_SECURE
+         "info.xtof.COMPARE_FOLDERS",   // GENERATOR
+         "fast",                        // ALGO_HASH_FAST
+         "fast_ns",                     // ALGO_HASH_FAST_NS
+         "secure",                      // ALGO_HASH_SECURE
+         "sampled:"                     // HASH_SAMPLED
      };
 
     /// @brief A fatal error occured
@@ -95,6 +127,15 @@ namespace cf
         ExceptionFatal(const std::string& msg);
     };
 
+    /// @brief The operation was cancelled, or its deadline was exceeded
+    class ExceptionCancelled : public ExceptionFatal
+    {
+    public:
+        /// @brief Constructor
+        /// @param msg Message explaining the origin of the exception
+        ExceptionCancelled(const std::string& msg);
+    };
+
     /// @brief A an error occured which **may** be recoverable
     class Exception : public std::runtime_error
     {
@@ -105,6 +146,61 @@ namespace cf
     };
 
 
+    /// @brief Progress of a scan or a comparison
+    /// @details The counters are cumulative since the beginning of the operation.
+    struct progress_t {
+        std::uint64_t files_enumerated; ///< Files listed, to be collected
+        std::uint64_t files_hashed;     ///< Files whose info was collected, or that could not be read
+        std::uint64_t bytes_hashed;     ///< Bytes read to hash the files' content
+        std::uint64_t files_compared;   ///< Files compared. A path on both sides counts once, as does each file renamed on the left.
+        double seconds;                 ///< Time elapsed since the beginning of the operation
+
+        /// @brief Returns the number of bytes hashed per second
+        inline double throughput() const noexcept {
+            return seconds > 0.0 ? static_cast<double>(bytes_hashed) / seconds : 0.0;
+        }
+        /// @brief Returns the estimated number of seconds left to collect the files enumerated, or a negative value if unknown
+        inline double eta() const noexcept {
+            if (files_hashed == 0u) {
+                return -1.0;
+            }
+            const auto files_left = files_enumerated > files_hashed ? files_enumerated - files_hashed : 0u;
+            return seconds * static_cast<double>(files_left) / static_cast<double>(files_hashed);
+        }
+    };
+
+
+    /// @brief Time spent in a phase of an operation
+    struct time_phase_t {
+        double wall = 0.0;  ///< Elapsed time, in seconds
+        double cpu = 0.0;   ///< CPU time, in seconds
+    };
+
+
+    /// @brief Statistics of a scan or a comparison, filled if requested by the options
+    /// @details The phases run by the hashing threads (enumerating, statting, reading, hashing) sum the time of each thread
+    ///          and measure the CPU of the threads themselves: they can exceed the total.
+    ///          The other phases measure the CPU of the whole process.
+    ///          The statistics of successive operations add up.
+    struct stats_t {
+        time_phase_t enumerating;           ///< Listing the files
+        time_phase_t statting;              ///< Reading the files' status
+        time_phase_t reading;               ///< Reading the files' content
+        time_phase_t hashing;               ///< Hashing the files' content
+        time_phase_t parsing;               ///< Reading the JSON files
+        time_phase_t comparing;             ///< Comparing the collections
+        time_phase_t serializing;           ///< Writing the JSON output
+        time_phase_t total;                 ///< The whole operation
+        std::uint64_t files_hashed = 0u;    ///< Files whose info was collected, or that could not be read
+        std::uint64_t bytes_hashed = 0u;    ///< Bytes read to hash the files' content
+        std::uint64_t files_compared = 0u;  ///< Files compared, counted as in progress_t
+        std::uint64_t operations = 0u;      ///< Estimated operations on the filesystem: directory entries and statuses read, files opened, read and closed.
+                                            ///< The actual system calls depend on the buffering of the standard library.
+        std::uint64_t cache_hits = 0u;      ///< Hashes read from the cache or carried forward from a baseline
+        std::uint64_t memory_peak = 0u;     ///< Peak resident memory of the process, in bytes. 0 if unknown.
+    };
+
+
     /// @brief Interface for a logger. The public operations **shall be callable from multiple concurrent threads**
     class ILogger
     {
@@ -117,6 +213,9 @@ namespace cf
         /// @brief Logs the provided message
         /// @detail The implementations of this operation shall be callable from concurrent threads.
         virtual void message(const std::string& message) = 0;
+        /// @brief Receives the progress of the current operation, periodically
+        /// @detail Does nothing by default. Never called concurrently with the other operations.
+        virtual void progress(const progress_t&) { }
     };
 
     /// @brief Null error logger (Singleton)
@@ -127,17 +226,92 @@ namespace cf
         void message(const std::string&) override { }
     };
 
+    /// @brief Token used to cancel an operation from another thread
+    /// @details The operation stops as soon as possible, joining all its threads, then throws **ExceptionCancelled**.
+    class CCancelToken
+    {
+    public:
+        CCancelToken() = default;
+        CCancelToken(const CCancelToken&) = delete;
+        void operator=(const CCancelToken&) = delete;
+        /// @brief Requests the cancellation. Can be called from any thread.
+        inline void cancel() noexcept {
+            _cancelled.store(true, std::memory_order_release);
+        }
+        /// @brief Returns true if the cancellation was requested
+        inline bool cancelled() const noexcept {
+            return _cancelled.load(std::memory_order_acquire);
+        }
+    private:
+        std::atomic_bool _cancelled{ false };
+    };
+
+    /// @brief Options tuning the collection of the files' info
+    struct options_t {
+        /// @brief Path of a persistent cache storing the hashes computed by the *secure* algorithm
+        /// @details A file keeping the same inode, size, modification and status change times is not hashed again.
+        ///          No cache is used if empty.
+        std::string path_cache;
+        /// @brief Period of the progress reports sent to the logger, in milliseconds. No report if 0.
+        unsigned period_progress_ms = 1000u;
+        /// @brief Token cancelling the operation. Not cancellable if null.
+        std::shared_ptr<const CCancelToken> cancel;
+        /// @brief The operation is cancelled if not done by this time
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+        /// @brief Memory the collected info can use, in bytes. Unbounded if 0.
+        /// @details Beyond it, the info is spilled to temporary files. Honored when scanning to a stream
+        ///          and when comparing, unless some deltas have to be applied.
+        std::size_t memory_budget = 0u;
+        /// @brief Directory receiving the temporary files. The system's one if empty.
+        std::string path_temp;
+        /// @brief Receives the statistics of the operation. Not measured if null.
+        std::shared_ptr<stats_t> stats;
+        /// @brief Receives a Chrome trace of the operation, in the JSON trace event format. Not traced if empty.
+        std::string path_trace;
+        /// @brief Number of file statuses requested at once by the *fast* algorithm
+        /// @details Hides the latency of network filesystems. With 1, the files are processed one by one.
+        ///          Each request in flight is a thread: the depth is capped to 256.
+        unsigned depth_stat = 16u;
+        /// @brief Files up to this size are hashed several at once by the *secure* algorithm, in SIMD lanes. Never if 0.
+        /// @details Only where AVX2 is available and not outrun by the processor's SHA instructions.
+        std::size_t size_multi_buffer = 16u * 1024u;
+        /// @brief Only the files matching these *gitignore* style patterns, or inside a matching directory, are collected.
+        ///        All the files if empty.
+        std::list<std::string> includes;
+        /// @brief The files and directories matching these *gitignore* style patterns are ignored
+        /// @details The excluded directories are not descended into. A pattern starting with `!` includes again
+        ///          what the previous ones excluded, but inside an excluded directory.
+        ///          Both patterns also filter the JSON files compared and the baselines, except the bases of the deltas.
+        std::list<std::string> excludes;
+        /// @brief Files larger than this are only sampled by the *secure* algorithm. Always hashed whole if 0.
+        /// @details The digest covers the size, the first and last blocks and some blocks evenly spaced in between.
+        ///          It is tagged as sampled in the JSON files, with both parameters: comparing snapshots sampled
+        ///          differently fails. A baseline sampled differently is not carried forward.
+        std::uint64_t size_sampling = 0u;
+        /// @brief Number of blocks sampled between the first and the last ones
+        unsigned nb_samples = 16u;
+        /// @brief The JSON snapshots also hold the aggregate digests of the directories
+        /// @details Comparing a snapshot then does not compute them again. Not written by default.
+        bool digests = false;
+    };
+
     /// @brief JSON file
 	/// @details This is a mere facade to the path
     struct json_t {
         explicit json_t(const std::string& p_path) :
             path{ p_path }
         {     }
+        /// @brief A JSON file whose content is updated by a chain of deltas produced by ScanFolderDelta()
+        json_t(const std::string& p_path, const std::list<std::string>& p_deltas) :
+            path{ p_path }, deltas{ p_deltas }
+        {     }
         const std::string path;
+        const std::list<std::string> deltas;   ///< Deltas applied in order to the content of the file
     };
 
 
     /// @brief Holds the differences between two folders named *left* and *right*
+    /// @details All the paths are encoded in UTF-8
     struct diff_t
     {
         /// @brief Custom operator== as std::list does not provide any
@@ -149,20 +323,67 @@ namespace cf
         {
             bool operator==(const renamed_t& rhs) const noexcept;
             std::string hash;             ///< hash of the files
-            std::list<std::wstring> left;  ///< Left files with the same content
-            std::list<std::wstring> right; ///< Right files with the same content
+            std::list<std::string> left;  ///< Left files with the same content
+            std::list<std::string> right; ///< Right files with the same content
         };
 
-        std::wstring root_left;               ///< Left directory root path
-        std::wstring root_right;              ///< Right directory root path
-        std::list<std::wstring> identical;    ///< Identical files
-        std::list<std::wstring> different;    ///< Different files
-        std::list<std::wstring> unique_left;  ///< Files that are unique to the left directory
-        std::list<std::wstring> unique_right; ///< Files that are unique to the right directory
+        std::string root_left;               ///< Left directory root path
+        std::string root_right;              ///< Right directory root path
+        std::list<std::string> identical;    ///< Identical files
+        std::list<std::string> different;    ///< Different files, or files that could not be read on a side
+        std::list<std::string> unique_left;  ///< Files that are unique to the left directory
+        std::list<std::string> unique_right; ///< Files that are unique to the right directory
         std::list<renamed_t> renamed;        ///< Files with different reative path that have the same content
     };
 
 
+    /// @brief Interface receiving the differences between two folders as soon as they are found
+    /// @details Allows to process huge differences without holding them in memory.
+    ///          All the paths are encoded in UTF-8.
+    class IDiffListener
+    {
+    public:
+        IDiffListener() = default;
+        virtual ~IDiffListener() = default;
+        /// @brief A file is identical on both sides
+        virtual void identical(const std::string& path) = 0;
+        /// @brief A file has a different content on both sides
+        virtual void different(const std::string& path) = 0;
+        /// @brief A file is unique to the left
+        virtual void uniqueLeft(const std::string& path) = 0;
+        /// @brief A file is unique to the right
+        virtual void uniqueRight(const std::string& path) = 0;
+        /// @brief Some files were renamed, moved or duplicated
+        virtual void renamed(const diff_t::renamed_t& renamed) = 0;
+    };
+
+    /// @brief Writes the differences to a stream as *newline delimited JSON*, one record per line
+    /// @details Each record is an object with a single member named after JSON_KEYS.DIFF,
+    ///          mirroring the layout of the document produced by Json().
+    ///          The stream is flushed after each record: a consumer tailing it receives the records one by one.
+    ///          The first records come once both sides are collected, as the comparison needs them whole.
+    class CDiffWriterNdjson : public IDiffListener
+    {
+    public:
+        /// @param stream Stream receiving the records. It must outlive the writer.
+        explicit CDiffWriterNdjson(std::ostream& stream) :
+            _stream(stream)
+        {   }
+        void identical(const std::string& path) override;
+        void different(const std::string& path) override;
+        void uniqueLeft(const std::string& path) override;
+        void uniqueRight(const std::string& path) override;
+        void renamed(const diff_t::renamed_t& renamed) override;
+
+    private:
+        /// @brief Writes a record holding a single path
+        void write(const std::string& key, const std::string& path);
+
+        std::ostream& _stream;
+        std::string _record;    ///< Buffer reused from record to record
+    };
+
+
     /// @brief Algorithm used to compute file's hashes
     /// @detailled Hashes are used to find which files are different, or were renamed / moved.
     typedef enum eHashingAlgorithm {
@@ -175,39 +396,137 @@ namespace cf
     /// @param left First folder's path
     /// @param right Second folder's path
     /// @param logErrors A logger to catch minor errors that could happen.The function will handle its lifetime.
+    /// @param options Options tuning the collection
     /// @details Returns the differences between the two folders.
     ///          Identical files but with a different names are also detected.
     ///          A null logger is provided by default
-    diff_t CompareFolders(const std::string& left, const std::string& right, const eHashingAlgorithm algo, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>());
+    diff_t CompareFolders(const std::string& left, const std::string& right, const eHashingAlgorithm algo, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>(), const options_t& options = options_t{});
 
     /// @brief Compares the content of two JSON files
     /// @param left First JSON file
     /// @param right Second JSON file
+    /// @param options Options tuning the comparison. Only the memory budget and the temporary directory are used.
     /// @details Returns the differences between the content described by the JSON files.
     ///          Identical files but with a different names are also detected.
 	///			 **Please note** that a json file in UTF-8 **with BOM** won't be correctly parsed!!
-    diff_t CompareFolders(const json_t left, const json_t right);
+    diff_t CompareFolders(const json_t left, const json_t right, const options_t& options = options_t{});
 
     /// @brief Compares the content of two JSON files
     /// @param folder The folder path
     /// @param json The JSON file
     /// @param logErrors A logger to catch minor errors that could happen. The function will handle its lifetime.
+    /// @param options Options tuning the collection
     /// @details Returns the differences between the content described by the JSON files.
     ///          Identical files but with a different names are also detected.
 	///			 **Please note** that a json file in UTF-8 **with BOM** won't be correctly parsed!!
     ///          A null logger is provided by default
-    diff_t CompareFolders(const std::string& folder, const json_t json, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>());
+    diff_t CompareFolders(const std::string& folder, const json_t json, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>(), const options_t& options = options_t{});
+
+    /// @brief Compares the content of two folders, streaming the differences as they are found
+    /// @param left First folder's path
+    /// @param right Second folder's path
+    /// @param listener Receives the differences
+    /// @param logErrors A logger to catch minor errors that could happen.The function will handle its lifetime.
+    /// @param options Options tuning the collection
+    void CompareFolders(const std::string& left, const std::string& right, const eHashingAlgorithm algo, IDiffListener& listener, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>(), const options_t& options = options_t{});
+
+    /// @brief Compares the content of two JSON files, streaming the differences as they are found
+    /// @param left First JSON file
+    /// @param right Second JSON file
+    /// @param listener Receives the differences
+    /// @param options Options tuning the comparison. Only the memory budget and the temporary directory are used.
+    void CompareFolders(const json_t left, const json_t right, IDiffListener& listener, const options_t& options = options_t{});
+
+    /// @brief Compares the content of a folder and a JSON file, streaming the differences as they are found
+    /// @param folder The folder path
+    /// @param json The JSON file
+    /// @param listener Receives the differences
+    /// @param logErrors A logger to catch minor errors that could happen. The function will handle its lifetime.
+    /// @param options Options tuning the collection
+    void CompareFolders(const std::string& folder, const json_t json, IDiffListener& listener, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>(), const options_t& options = options_t{});
 
-    /// @brief Produces a JSON wstring with the difference between two folders
+    /// @brief Produces an UTF-8 JSON string with the difference between two folders
     /// @param diff Difference between two folders
-    std::wstring Json(const diff_t diff);
+    std::string Json(const diff_t& diff);
 
-    /// @brief Analyzes the content of a folder and returns a JSON string
+    /// @brief Analyzes the content of a folder and returns an UTF-8 JSON string
     /// @param path          Path of the folder to be analyzed
     /// @param method        Algorithm used to collect info about the files
     /// @param logErrors     Error logger. The function will handle its lifetime.
+    /// @param options       Options tuning the collection
     /// @details             A null logger is provided by default
-    std::wstring ScanFolder(const std::string& path, const eHashingAlgorithm algo, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>());
+    std::string ScanFolder(const std::string& path, const eHashingAlgorithm algo, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>(), const options_t& options = options_t{});
+
+    /// @brief Analyzes the content of a folder and writes an UTF-8 JSON string to a stream
+    /// @param path          Path of the folder to be analyzed
+    /// @param method        Algorithm used to collect info about the files
+    /// @param output        Receives the same JSON string as returned by ScanFolder()
+    /// @param logErrors     Error logger. The function will handle its lifetime.
+    /// @param options       Options tuning the collection
+    /// @details             The memory used is bounded by options_t::memory_budget, whatever the number of files.
+    ///                      A null logger is provided by default
+    void ScanFolder(const std::string& path, const eHashingAlgorithm algo, std::ostream& output, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>(), const options_t& options = options_t{});
+
+    /// @brief Analyzes the content of a folder, starting from a previous scan, and returns an UTF-8 JSON string
+    /// @param path          Path of the folder to be analyzed
+    /// @param baseline      JSON file produced by a previous scan of the folder
+    /// @param logErrors     Error logger. The function will handle its lifetime.
+    /// @param options       Options tuning the collection
+    /// @details             The algorithm of the baseline is used. Only the new files and the files whose size
+    ///                      or modification time changed are hashed: the other hashes are carried forward.
+    ///                      So are not the files modified less than a second before the baseline's scan,
+    ///                      nor any file if the baseline, written by a former version, does not tell its scan time.
+    ///                      A null logger is provided by default
+    std::string ScanFolder(const std::string& path, const json_t baseline, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>(), const options_t& options = options_t{});
+
+    /// @brief Analyzes the content of a folder and returns its changes since a base scan, as an UTF-8 JSON string
+    /// @param path          Path of the folder to be analyzed
+    /// @param base          JSON file produced by a previous scan of the folder. It may carry some deltas.
+    /// @param logErrors     Error logger. The function will handle its lifetime.
+    /// @param options       Options tuning the collection
+    /// @details             The resulting *delta* only lists the files added, modified and removed.
+    ///                      It can be applied to the base with json_t.
+    ///                      The algorithm of the base is used, as well as its hashes for the files left unchanged.
+    ///                      A null logger is provided by default
+    std::string ScanFolderDelta(const std::string& path, const json_t base, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>(), const options_t& options = options_t{});
+
+    class CWatchFolder;
+
+    /// @brief Keeps the description of a folder up to date, watching the changes of its files
+    /// @details The folder is scanned once, then only the files that are modified are hashed again.
+    ///          The operations can be called at any moment, from any thread.
+    ///          Only available on Linux.
+    class CWatcher
+    {
+    public:
+        /// @brief Scans a folder then starts watching it
+        /// @param path          Path of the folder to be watched
+        /// @param algo          Algorithm used to collect info about the files
+        /// @param logErrors     Error logger. The watcher will handle its lifetime.
+        /// @param options       Options tuning the collection
+        /// @details             The cancellation token and the deadline of the options only bound the first scan.
+        ///                      May throw **ExceptionFatal**
+        CWatcher(const std::string& path, const eHashingAlgorithm algo, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>(), const options_t& options = options_t{});
+        ~CWatcher();
+        CWatcher(const CWatcher&) = delete;
+        void operator=(const CWatcher&) = delete;
+
+        /// @brief Returns the current state of the folder as an UTF-8 JSON string, as ScanFolder() would
+        std::string json() const;
+
+        /// @brief Compares the current state of the folder to another folder, scanned with the same algorithm
+        diff_t compare(const std::string& folder) const;
+
+        /// @brief Compares the current state of the folder to a JSON file
+        diff_t compare(const json_t json) const;
+
+        /// @brief Returns the number of changes applied since the folder was scanned
+        std::uint64_t changes() const;
+
+    private:
+        std::unique_ptr<CWatchFolder> _watch;
+        const options_t _options;
+    };
 
 	/// @brief 	Creates a new file containing an UTF-8 representation of the provided wstring
 	/// @details The resulting file will be UTF-8 which *may* be headed by a **BOM**
@@ -215,6 +534,60 @@ namespace cf
 	/// @param str 		wide string to encode in UTF-8 then write to disk
 	/// @param withBOM 	Is writing a BOM header to the UTF-8 file required? (default: false)
 	void WriteWString(std::ofstream& stream, const std::wstring& str, const bool withBOM = false);
+
+    /// @brief Converts an UTF-8 string, as returned by the library, to a wide string
+    std::wstring ToWString(const std::string& utf8);
+
+    /// @brief Converts a wide string to UTF-8, as expected by the library
+    std::string ToUtf8(const std::wstring& wstr);
+
+
+    // ===== WIDE STRINGS
+    // Thin wrappers kept for the callers of the former API, which handled the paths as wide strings.
+
+    /// @brief Holds the differences between two folders, with the paths as wide strings
+    /// @deprecated Use diff_t, whose paths are encoded in UTF-8
+    struct wdiff_t
+    {
+        wdiff_t() = default;
+        /// @brief Converts the paths of a diff_t. Implicit: the functions returning a diff_t can initialize a wdiff_t.
+        wdiff_t(const diff_t& diff);
+
+        /// @brief Converts the paths back to UTF-8
+        diff_t utf8() const;
+
+        /// @brief Files with different path but the very same content
+        struct renamed_t
+        {
+            std::string hash;               ///< hash of the files
+            std::list<std::wstring> left;   ///< Left files with the same content
+            std::list<std::wstring> right;  ///< Right files with the same content
+        };
+
+        std::wstring root_left;               ///< Left directory root path
+        std::wstring root_right;              ///< Right directory root path
+        std::list<std::wstring> identical;    ///< Identical files
+        std::list<std::wstring> different;    ///< Different files, or files that could not be read on a side
+        std::list<std::wstring> unique_left;  ///< Files that are unique to the left directory
+        std::list<std::wstring> unique_right; ///< Files that are unique to the right directory
+        std::list<renamed_t> renamed;         ///< Files with different reative path that have the same content
+    };
+
+    /// @brief Compares the content of two folders given as wide strings
+    /// @deprecated Use the UTF-8 overload
+    wdiff_t CompareFolders(const std::wstring& left, const std::wstring& right, const eHashingAlgorithm algo, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>(), const options_t& options = options_t{});
+
+    /// @brief Compares the content of a folder given as a wide string and a JSON file
+    /// @deprecated Use the UTF-8 overload
+    wdiff_t CompareFolders(const std::wstring& folder, const json_t json, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>(), const options_t& options = options_t{});
+
+    /// @brief Produces a JSON wide string with the difference between two folders
+    /// @deprecated Use the UTF-8 overload
+    std::wstring Json(const wdiff_t& diff);
+
+    /// @brief Analyzes the content of a folder given as a wide string and returns a JSON wide string
+    /// @deprecated Use the UTF-8 overload
+    std::wstring ScanFolder(const std::wstring& path, const eHashingAlgorithm algo, std::unique_ptr<ILogger> logger = std::make_unique< CLoggerNull>(), const options_t& options = options_t{});
 }
 
 #endif
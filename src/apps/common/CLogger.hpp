@@ -2,6 +2,7 @@
 #define __SRC_APP_COMMON_CLOGGER_HPP__
 
 #include <iostream>
+#include <iomanip>
 #include <string>
 
 #include <rlutil/rlutil.h>
@@ -16,6 +17,9 @@ public:
         rlutil::saveDefaultColor();        
     }
     ~CLogger() {
+        if (_progress_shown) {
+            std::cout << std::endl;
+        }
         rlutil::resetColor();
     }
 
@@ -29,6 +33,50 @@ public:
         std::cout << message << std::endl;
         rlutil::resetColor();
     }
+    /// @brief Displays the progress on a single line, overwritten by the next report
+    void progress(const cf::progress_t& progress) override final {
+        rlutil::setColor(rlutil::CYAN);
+        std::cout << '\r' << progress.files_hashed << " / " << progress.files_enumerated << " files";
+        if (progress.bytes_hashed != 0u) {
+            std::cout << "   " << static_cast<unsigned long long>(progress.throughput() / (1024.0 * 1024.0)) << " MiB/s";
+        }
+        if (progress.eta() >= 0.0) {
+            std::cout << "   ETA " << static_cast<unsigned long long>(progress.eta()) << " s";
+        }
+        std::cout << "      " << std::flush;
+        rlutil::resetColor();
+        _progress_shown = true;
+    }
+
+    /// @brief Displays the statistics of an operation
+    void stats(const cf::stats_t& stats) {
+        const auto phase = [](const char* name, const cf::time_phase_t& time) {
+            std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(12) << time.wall << std::setw(12) << time.cpu << '\n';
+        };
+        rlutil::setColor(rlutil::CYAN);
+        std::cout << "\nSTATISTICS\n\n" << std::left << std::setw(14) << "phase" << std::right
+                  << std::setw(12) << "wall (s)" << std::setw(12) << "cpu (s)" << '\n';
+        phase("enumerating", stats.enumerating);
+        phase("statting", stats.statting);
+        phase("reading", stats.reading);
+        phase("hashing", stats.hashing);
+        phase("parsing", stats.parsing);
+        phase("comparing", stats.comparing);
+        phase("serializing", stats.serializing);
+        phase("total", stats.total);
+        std::cout << "\nfiles hashed:   " << stats.files_hashed
+                  << "\nbytes hashed:   " << stats.bytes_hashed
+                  << "\nfiles compared: " << stats.files_compared
+                  << "\nest. fs ops:    " << stats.operations
+                  << "\ncache hits:     " << stats.cache_hits
+                  << "\npeak memory:    " << stats.memory_peak / (1024u * 1024u) << " MiB" << std::endl;
+        std::cout.unsetf(std::ios::floatfield | std::ios::adjustfield);
+        rlutil::resetColor();
+    }
+
+private:
+    bool _progress_shown = false;   ///< Is the progress line displayed?
 };
 
 
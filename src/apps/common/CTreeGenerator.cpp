@@ -0,0 +1,322 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+#include "CTreeGenerator.hpp"
+
+
+using namespace std;
+
+
+/// @brief Size of the chunks written to the files
+static constexpr size_t SIZE_CHUNK = 64u * 1024u;
+/// @brief Files larger than this size begin with the id of their content
+static constexpr uint64_t SIZE_ID = sizeof(uint64_t);
+
+
+/// @brief SplitMix64: tiny and fully specified, hence the same numbers on every platform
+static inline uint64_t split_mix(uint64_t& state)
+{
+    state += 0x9E3779B97F4A7C15ull;
+    auto z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+
+/// @brief Returns the number of bits needed to represent value
+static inline unsigned bit_length(uint64_t value)
+{
+    auto length = 0u;
+    for (; value != 0u; value >>= 1) {
+        ++length;
+    }
+    return length;
+}
+
+
+/// @brief Joins a relative folder and a name
+static inline string join(const string& folder, const string& name)
+{
+    return folder.empty() ? name : folder + '/' + name;
+}
+
+
+
+///////////////////////
+
+CTreeGenerator::CTreeGenerator(const spec_tree_t& spec) :
+    _spec(spec),
+    _state{ spec.seed },
+    _id_next{ 0u },
+    _bytes_written{ 0u }
+{
+    const auto is_probability = [](const double ratio) {
+        return ratio >= 0.0 && ratio <= 1.0;
+    };
+    if (_spec.size_min > _spec.size_max || _spec.size_max >= (uint64_t{ 1u } << 62)) {
+        throw invalid_argument{ "Invalid range of file sizes." };
+    }
+    if (!is_probability(_spec.ratio_duplicates) || !is_probability(_spec.ratio_modified) || !is_probability(_spec.ratio_renamed) ||
+        !is_probability(_spec.ratio_removed) || _spec.ratio_added < 0.0 ||
+        _spec.ratio_modified + _spec.ratio_renamed + _spec.ratio_removed > 1.0) {
+        throw invalid_argument{ "Invalid ratios: the modified, renamed and removed files cannot exceed the number of files." };
+    }
+}
+
+
+void CTreeGenerator::generate(const fs::path& root)
+{
+    _bytes_written = 0u;
+    buildLeft();
+    write(root, _files_left);
+}
+
+
+cf::diff_t CTreeGenerator::generate(const fs::path& left, const fs::path& right, const hasher_t& hasher)
+{
+    _bytes_written = 0u;
+    buildLeft();
+    buildRight();
+    write(left, _files_left);
+    write(right, _files_right);
+    return expected(left, right, hasher);
+}
+
+
+
+/////////////////////// RANDOM
+
+uint64_t CTreeGenerator::next()
+{
+    return split_mix(_state);
+}
+
+
+uint64_t CTreeGenerator::next(const uint64_t max)
+{
+    return max == 0u ? 0u : next() % max;
+}
+
+
+bool CTreeGenerator::draw(const double probability)
+{
+    return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0) < probability; // 53 bits
+}
+
+
+/// @details With a log-uniform distribution, a bit length is drawn first, then a size of this length.
+CTreeGenerator::content_t CTreeGenerator::newContent()
+{
+    uint64_t size;
+    if (_spec.distribution == eSizeDistribution::UNIFORM) {
+        size = _spec.size_min + next(_spec.size_max - _spec.size_min + 1u);
+    }
+    else {
+        const auto bits_min = bit_length(_spec.size_min);
+        const auto bits = bits_min + static_cast<unsigned>(next(bit_length(_spec.size_max) - bits_min + 1u));
+        const auto low = max<uint64_t>(_spec.size_min, bits == 0u ? 0u : uint64_t{ 1u } << (bits - 1u));
+        const auto high = min<uint64_t>(_spec.size_max, bits == 0u ? 0u : (uint64_t{ 1u } << bits) - 1u);
+        size = low + next(high - low + 1u);
+    }
+    return { _id_next++, size };
+}
+
+
+
+/////////////////////// TREES
+
+/// @details The folders are created level after level, then filled with files.
+///          A duplicated file has the content of any file created before it.
+void CTreeGenerator::buildLeft()
+{
+    _state = _spec.seed;
+    _id_next = 0u;
+
+    _folders.assign(1u, string{});
+    size_t begin = 0u;
+    for (auto level = 0u; level < _spec.depth; ++level) {
+        const auto end = _folders.size();
+        for (auto i = begin; i < end; ++i) {
+            const auto parent = _folders[i];
+            for (auto j = 0u; j < _spec.nb_folders; ++j) {
+                _folders.push_back(join(parent, "folder_" + to_string(j)));
+            }
+        }
+        begin = end;
+    }
+
+    _files_left.clear();
+    _files_left.reserve(_folders.size() * _spec.nb_files);
+    for (const auto& folder : _folders) {
+        for (auto j = 0u; j < _spec.nb_files; ++j) {
+            const auto content = !_files_left.empty() && draw(_spec.ratio_duplicates) ?
+                _files_left[next(_files_left.size())].content : newContent();
+            _files_left.push_back({ join(folder, "file_" + to_string(j)), content });
+        }
+    }
+}
+
+
+/// @details The moved and added files are put in random folders, under names that cannot clash.
+void CTreeGenerator::buildRight()
+{
+    _files_right.clear();
+    _files_right.reserve(_files_left.size());
+    auto nb_renamed = 0u;
+    for (const auto& file : _files_left)
+    {
+        auto choice = static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+        if (choice < _spec.ratio_removed) {
+            continue;
+        }
+        choice -= _spec.ratio_removed;
+        if (choice < _spec.ratio_renamed) {
+            _files_right.push_back({ join(_folders[next(_folders.size())], "renamed_" + to_string(nb_renamed++)), file.content });
+            continue;
+        }
+        choice -= _spec.ratio_renamed;
+        if (choice < _spec.ratio_modified) {
+            _files_right.push_back({ file.path, newContent() });
+            continue;
+        }
+        _files_right.push_back(file);
+    }
+
+    const auto nb_added = static_cast<uint64_t>(llround(_spec.ratio_added * _files_left.size()));
+    for (uint64_t i = 0u; i < nb_added; ++i) {
+        _files_right.push_back({ join(_folders[next(_folders.size())], "added_" + to_string(i)), newContent() });
+    }
+}
+
+
+void CTreeGenerator::write(const fs::path& root, const vector<file_t>& files)
+{
+    if (fs::exists(root)) {
+        throw runtime_error{ root.string() + " already exists." };
+    }
+    for (const auto& folder : _folders) {
+        fs::create_directories(root / folder);
+    }
+
+    for (const auto& file : files)
+    {
+        const auto path = root / file.path;
+        ofstream stream{ path.string(), ios::out | ios::binary };
+        visit(file.content, [&stream](const char* data, const size_t size) {
+            stream.write(data, static_cast<streamsize>(size));
+        });
+        if (!stream) {
+            throw runtime_error{ "Cannot write " + path.string() };
+        }
+        _bytes_written += file.content.size;
+    }
+}
+
+
+void CTreeGenerator::visit(const content_t& content, const function<void(const char*, size_t)>& visitor) const
+{
+    uint64_t state = _spec.seed ^ (content.id * 0xD6E8FEB86659FD93ull);
+    string chunk;
+    chunk.reserve(SIZE_CHUNK + SIZE_ID);
+    for (uint64_t offset = 0u; offset < content.size; )
+    {
+        chunk.clear();
+        while (chunk.size() < SIZE_CHUNK && offset + chunk.size() < content.size) {
+            const auto value = (offset == 0u && chunk.empty() && content.size > SIZE_ID) ? content.id : split_mix(state);
+            for (auto i = 0u; i < SIZE_ID && offset + chunk.size() < content.size; ++i) {
+                chunk.push_back(static_cast<char>(value >> (8u * i)));
+            }
+        }
+        visitor(chunk.data(), chunk.size());
+        offset += chunk.size();
+    }
+}
+
+
+/// @details The large files begin with their content's id: different ids, different contents.
+///          The small ones may have the same content by chance: their key is their content.
+string CTreeGenerator::key(const content_t& content) const
+{
+    if (content.size > SIZE_ID) {
+        return '#' + to_string(content.id);
+    }
+    string key{ '=' };
+    visit(content, [&key](const char* data, const size_t size) {
+        key.append(data, size);
+    });
+    return key;
+}
+
+
+
+/////////////////////// DIFFERENCES
+
+/// @details Follows the rules of the comparison: a file missing on the other side is *renamed*
+///          if any file on the other side has the same content, and then lists all the files sharing it.
+cf::diff_t CTreeGenerator::expected(const fs::path& left, const fs::path& right, const hasher_t& hasher) const
+{
+    map<string, string> keys_left, keys_right;
+    map<string, vector<string>> files_left, files_right;
+    for (const auto& file : _files_left) {
+        const auto k = key(file.content);
+        keys_left.emplace(file.path, k);
+        files_left[k].push_back(file.path);
+    }
+    for (const auto& file : _files_right) {
+        const auto k = key(file.content);
+        keys_right.emplace(file.path, k);
+        files_right[k].push_back(file.path);
+    }
+
+    cf::diff_t diff;
+    diff.root_left = left.string();
+    diff.root_right = right.string();
+    map<string, string> hashes;
+    for (const auto& file : keys_left)
+    {
+        const auto found = keys_right.find(file.first);
+        if (found != keys_right.end()) {
+            (found->second == file.second ? diff.identical : diff.different).push_back(file.first);
+            continue;
+        }
+        const auto twins = files_right.find(file.second);
+        if (twins == files_right.end()) {
+            diff.unique_left.push_back(file.first);
+            continue;
+        }
+        const auto& twins_left = files_left[file.second];
+        auto hash = hashes.find(file.second);
+        if (hash == hashes.end()) {
+            hash = hashes.emplace(file.second, hasher ? hasher(left / twins_left.front()) : string{}).first;
+        }
+        diff.renamed.push_back({ hash->second, { twins_left.begin(), twins_left.end() }, { twins->second.begin(), twins->second.end() } });
+    }
+    for (const auto& file : keys_right) {
+        if (keys_left.find(file.first) == keys_left.end() && files_left.find(file.second) == files_left.end()) {
+            diff.unique_right.push_back(file.first);
+        }
+    }
+    return diff;
+}
@@ -0,0 +1,142 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#ifndef __SRC_APP_COMMON_CTREEGENERATOR_HPP__
+#define __SRC_APP_COMMON_CTREEGENERATOR_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include <boost/filesystem.hpp>
+
+#include "CompareFolders.hpp"
+
+namespace fs = boost::filesystem;
+
+
+/// @brief Distribution of the generated files' size
+enum class eSizeDistribution {
+    UNIFORM,        ///< All the sizes are equally likely
+    LOG_UNIFORM     ///< All the orders of magnitude are equally likely: many small files, a few big ones
+};
+
+
+/// @brief Specification of the trees built by CTreeGenerator
+struct spec_tree_t {
+    std::uint64_t seed = 0u;            ///< Same seed, same trees
+    unsigned depth = 2u;                ///< Levels of subfolders below the root
+    unsigned nb_folders = 4u;           ///< Subfolders in each folder
+    unsigned nb_files = 16u;            ///< Files in each folder
+    std::uint64_t size_min = 0u;        ///< Minimum size of a file, in bytes
+    std::uint64_t size_max = 64u * 1024u; ///< Maximum size of a file, in bytes
+    eSizeDistribution distribution = eSizeDistribution::LOG_UNIFORM;
+    double ratio_duplicates = 0.05;     ///< Probability for a left file to have the content of a previous one
+    double ratio_modified = 0.05;       ///< Probability for a left file to have another content on the right
+    double ratio_renamed = 0.05;        ///< Probability for a left file to be moved on the right
+    double ratio_removed = 0.05;        ///< Probability for a left file to be missing on the right
+    double ratio_added = 0.05;          ///< Number of files only present on the right, relative to the number of left files
+};
+
+
+/// @brief Builds reproducible trees of files, to test and measure the library at scale
+/// @details The *left* tree is built from the specification. The *right* one is derived from it by
+///          modifying, moving and removing some of its files and by adding new ones.
+///          The content of the files is only kept as a seed: millions of files can be generated.
+///          The same seed produces the same trees on every platform.
+class CTreeGenerator
+{
+public:
+    /// @brief Computes the hash of a file, as the compared algorithm would
+    typedef std::function<std::string(const fs::path&)> hasher_t;
+
+    /// @details May throw **std::invalid_argument** if the specification is not consistent
+    explicit CTreeGenerator(const spec_tree_t& spec);
+    ~CTreeGenerator() = default;
+    CTreeGenerator(const CTreeGenerator&) = delete;
+    void operator=(const CTreeGenerator&) = delete;
+
+    /// @brief Writes a single tree
+    /// @param root Folder to create. It shall not exist.
+    /// @details May throw **std::runtime_error**
+    void generate(const fs::path& root);
+
+    /// @brief Writes a left tree and the right one derived from it
+    /// @param left     Left folder to create. It shall not exist.
+    /// @param right    Right folder to create. It shall not exist.
+    /// @param hasher   Computes the hash of the renamed files. Their hash is left empty if not provided.
+    /// @returns The differences reported when comparing the folders with the *secure* algorithm
+    /// @details May throw **std::runtime_error**
+    cf::diff_t generate(const fs::path& left, const fs::path& right, const hasher_t& hasher = hasher_t{});
+
+    /// @brief Returns the number of files of the last left tree
+    inline std::size_t nbFilesLeft() const {
+        return _files_left.size();
+    }
+    /// @brief Returns the number of bytes written by the last generation
+    inline std::uint64_t bytesWritten() const {
+        return _bytes_written;
+    }
+
+private:
+    /// @brief Content of a file
+    struct content_t {
+        std::uint64_t id;   ///< Seed of the content. Written in the first bytes if the file is large enough.
+        std::uint64_t size;
+    };
+    /// @brief A file, given its path relative to the root
+    struct file_t {
+        std::string path;
+        content_t content;
+    };
+
+    /// @brief Returns the next pseudo random number
+    std::uint64_t next();
+    /// @brief Returns a pseudo random number lower than max
+    std::uint64_t next(const std::uint64_t max);
+    /// @brief Returns true with the given probability
+    bool draw(const double probability);
+    /// @brief Returns a new content
+    content_t newContent();
+
+    /// @brief Builds the left files in memory
+    void buildLeft();
+    /// @brief Builds the right files in memory from the left ones
+    void buildRight();
+    /// @brief Creates the folders and writes the files
+    void write(const fs::path& root, const std::vector<file_t>& files);
+    /// @brief Passes the content of a file, chunk after chunk
+    void visit(const content_t& content, const std::function<void(const char*, std::size_t)>& visitor) const;
+    /// @brief Returns a key identifying the content: two files have the same content if and only if they have the same key
+    std::string key(const content_t& content) const;
+    /// @brief Computes the differences between the left and right files
+    cf::diff_t expected(const fs::path& left, const fs::path& right, const hasher_t& hasher) const;
+
+    const spec_tree_t _spec;
+    std::uint64_t _state;               ///< State of the pseudo random generator
+    std::uint64_t _id_next;             ///< Next content id
+    std::uint64_t _bytes_written;
+    std::vector<std::string> _folders;  ///< Relative paths of the folders, the root first
+    std::vector<file_t> _files_left;
+    std::vector<file_t> _files_right;
+};
+
+
+#endif
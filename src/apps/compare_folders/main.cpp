@@ -21,6 +21,8 @@
 #include <fstream>
 #include <array>
 #include <string>
+#include <list>
+#include <chrono>
 
 #include <tclap/CmdLine.h>
 #include "CLogger.hpp"
@@ -53,24 +55,83 @@ int main(int argc, char* argv[])
         TCLAP::CmdLine cmd{ "Compares the content of two directorues, given paths or JSON files. If no output is provided, differences will be displayed." };
         TCLAP::MultiArg<string> folders("d", "directory", "An actual directory to be compared", false, "Directory's path");
         TCLAP::MultiArg<string> json("j", "json", "A JSON file containing the descrition of a previously scanned directory", false, "JSON filepath");
+        TCLAP::MultiArg<string> deltas("", "delta", "A delta applied to the first JSON file. Several deltas are applied in the order they are given.", false, "JSON filepath");
         TCLAP::ValueArg<string> output("o", "output", "A JSON file that will contain the result of the comparison. If provided, no result is displayed on the screen.", false, "", "JSON filepath");
         TCLAP::SwitchArg fast("f", "fast", "Use the fast algorithm to compare the files' content. Way faster, but less reliable than the default algorithm.");
+        TCLAP::SwitchArg ndjson("n", "ndjson", "Output the differences as newline delimited JSON: one record per line, written as soon as it is found.");
+        TCLAP::ValueArg<string> cache("c", "cache", "A file caching the hashes of the scanned files. Unchanged files are not hashed again.", false, "", "Cache filepath");
+        TCLAP::ValueArg<unsigned> timeout("t", "timeout", "Stops scanning the directories if they are not scanned within the given time.", false, 0u, "Seconds");
+        TCLAP::ValueArg<unsigned> memory("m", "memory", "Bounds the memory used to compare the directories. Beyond it, temporary files are used. Ignored with deltas.", false, 0u, "MiB");
+        TCLAP::SwitchArg stats("", "stats", "Displays the time spent in each phase of the comparison and some counters.");
+        TCLAP::ValueArg<string> trace("", "trace", "Writes a Chrome trace of the comparison, to be opened in chrome://tracing or Perfetto.", false, "", "JSON filepath");
+        TCLAP::ValueArg<unsigned> depth_stat("", "stat-depth", "Number of file statuses requested at once by the fast algorithm. Raise it on network filesystems, up to 256.", false, 16u, "Requests");
+        TCLAP::MultiArg<string> includes("", "include", "Only the files matching this gitignore style pattern, or inside a matching directory, are compared. Can be repeated.", false, "Pattern");
+        TCLAP::MultiArg<string> excludes("", "exclude", "The files and directories matching this gitignore style pattern are ignored. Can be repeated.", false, "Pattern");
+        TCLAP::ValueArg<unsigned> sampling("", "sample-above", "The files larger than this are not hashed whole by the secure algorithm: only their size, first and last blocks and some blocks in between. Their hashes are tagged as sampled.", false, 0u, "MiB");
+        TCLAP::ValueArg<unsigned> samples("", "samples", "Number of blocks of 64 KiB sampled between the first and the last ones, with --sample-above.", false, 16u, "Blocks");
         cmd.add(folders);
         cmd.add(json);
+        cmd.add(deltas);
         cmd.add(output);
+        cmd.add(ndjson);
+        cmd.add(cache);
+        cmd.add(timeout);
+        cmd.add(memory);
+        cmd.add(stats);
+        cmd.add(trace);
+        cmd.add(depth_stat);
+        cmd.add(includes);
+        cmd.add(excludes);
+        cmd.add(sampling);
+        cmd.add(samples);
         cmd.parse(argc, argv);
         const auto path_folders = folders.getValue();
         const auto path_json = json.getValue();
+        const auto paths_delta = deltas.getValue();
         const auto path_output = output.getValue();
         const auto fast_hash = fast.getValue();
+        const auto stream_ndjson = ndjson.getValue();
         const auto algo = fast_hash ? cf::eCollectingAlgorithm::FAST : cf::eCollectingAlgorithm::SECURE;
+        cf::options_t options;
+        options.path_cache = cache.getValue();
+        if (timeout.getValue() != 0u) {
+            options.deadline = chrono::steady_clock::now() + chrono::seconds{ timeout.getValue() };
+        }
+        options.memory_budget = static_cast<size_t>(memory.getValue()) * 1024u * 1024u;
+        if (stats.getValue()) {
+            options.stats = make_shared<cf::stats_t>();
+        }
+        options.path_trace = trace.getValue();
+        options.depth_stat = depth_stat.getValue();
+        options.includes.assign(includes.getValue().begin(), includes.getValue().end());
+        options.excludes.assign(excludes.getValue().begin(), excludes.getValue().end());
+        options.size_sampling = static_cast<uint64_t>(sampling.getValue()) * 1024u * 1024u;
+        options.nb_samples = samples.getValue();
 
         if (path_folders.size() + path_json.size() != 2u) {
             throw(TCLAP::ArgException{ "You shall give two entries (JSON or FOLDER) to be compared.\n\nType \"" + string{argv[0]} + " -h\" for help.\n"});
         }
+        if (path_json.empty() && !paths_delta.empty()) {
+            throw(TCLAP::ArgException{ "Deltas can only be applied to a JSON file.\n" });
+        }
+        // The deltas are applied to the first JSON file
+        const auto json_first = [&path_json, &paths_delta]() {
+            return cf::json_t{ path_json[0], list<string>{ paths_delta.begin(), paths_delta.end() } };
+        };
+
+        // Prepare the output
+        ofstream stream_file;
+        if (!path_output.empty()) {
+            stream_file.open(path_output, ios::out);
+            if (!stream_file) {
+                throw runtime_error{ "Cannot write to " + path_output };
+            }
+        }
+        ostream& stream = path_output.empty() ? cout : stream_file;
 
-        // Execute       
-        wstring result;
+        // Execute
+        // In NDJSON mode the differences are written as soon as they are found
+        cf::CDiffWriterNdjson writer{ stream };
 
         // Compare two folders
         if (path_folders.size() == 2u) 
@@ -78,7 +139,12 @@ int main(int argc, char* argv[])
             if (!path_output.empty()) {
                 cout << "\nCOMPARING\n\n" << '\"' << path_folders[0] << "\"\n\tand\n\"" << path_folders[1] << "\"\n" << endl;
             }
-            result = cf::Json(cf::CompareFolders(path_folders[0], path_folders[1], algo, make_unique< CLogger>()));
+            if (stream_ndjson) {
+                cf::CompareFolders(path_folders[0], path_folders[1], algo, writer, make_unique< CLogger>(), options);
+            }
+            else {
+                stream << cf::Json(cf::CompareFolders(path_folders[0], path_folders[1], algo, make_unique< CLogger>(), options));
+            }
         }
         // Compare one folder and one JSON file
         else if (path_folders.size() == 1)
@@ -86,7 +152,12 @@ int main(int argc, char* argv[])
             if (!path_output.empty()) {
                 cout << "\nCOMPARING\n\n" << '\"' << path_folders[0] << "\"\n\tand\n\"" << path_json[0] << "\"\n" << endl;
             }
-            result = cf::Json(cf::CompareFolders(path_folders[0], cf::json_t{path_json [0]}, make_unique< CLogger>()));
+            if (stream_ndjson) {
+                cf::CompareFolders(path_folders[0], json_first(), writer, make_unique< CLogger>(), options);
+            }
+            else {
+                stream << cf::Json(cf::CompareFolders(path_folders[0], json_first(), make_unique< CLogger>(), options));
+            }
         }
         // Compare two JSON files
         else
@@ -94,21 +165,16 @@ int main(int argc, char* argv[])
             if (!path_output.empty()) {
                 cout << "\nCOMPARING\n\n" << '\"' << path_json[0] << "\"\n\tand\n\"" << path_json[1] << "\"\n" << endl;
             }
-            result = cf::Json(cf::CompareFolders(cf::json_t{ path_json[0] }, cf::json_t{ path_json[1] }));
-        }
-
-        // Output the result
-        if (path_output.empty())  {
-            wcout << result;
-        }
-        else
-		{
-            ofstream stream{ path_output , ios::out };
-            if (!stream) {
-                throw runtime_error{ "Cannot write to " + path_output };
+            if (stream_ndjson) {
+                cf::CompareFolders(json_first(), cf::json_t{ path_json[1] }, writer, options);
             }
-			
-			cf::WriteWString(stream, result);
+            else {
+                stream << cf::Json(cf::CompareFolders(json_first(), cf::json_t{ path_json[1] }, options));
+            }
+        }
+        stream.flush();
+        if (options.stats) {
+            CLogger{}.stats(*options.stats);
         }
     }
     catch (TCLAP::ArgException &e)  // catch any exceptions
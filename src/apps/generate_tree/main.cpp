@@ -0,0 +1,128 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#include <cstdint>
+#include <string>
+#include <fstream>
+#include <iostream>
+
+#include <tclap/CmdLine.h>
+
+#include "CLogger.hpp"
+#include "CTreeGenerator.hpp"
+#include "CompareFolders.hpp"
+#include "CFactoryInfo.hpp"
+
+
+using namespace std;
+
+
+/// @brief Generates reproducible trees of files and the expected result of their comparison
+int main(int argc, char* argv[])
+{
+    try
+    {
+        // Parsing args
+        TCLAP::CmdLine cmd{ "Generates a reproducible tree of files, and optionally a second tree derived from it with the expected result of their comparison." };
+        TCLAP::ValueArg<string> left("l", "left", "The folder to generate. It shall not exist.", true, "", "Directory's path");
+        TCLAP::ValueArg<string> right("r", "right", "A folder derived from the left one, to generate. It shall not exist.", false, "", "Directory's path");
+        TCLAP::ValueArg<string> output("o", "output", "A JSON file that will contain the expected result of comparing the left and right folders with the secure algorithm.", false, "", "JSON filepath");
+        TCLAP::ValueArg<uint64_t> seed("s", "seed", "Seed of the generation. The same seed produces the same trees.", false, 0u, "Integer");
+        TCLAP::ValueArg<unsigned> depth("", "depth", "Levels of subfolders below the root.", false, 2u, "Integer");
+        TCLAP::ValueArg<unsigned> folders("", "folders", "Number of subfolders in each folder.", false, 4u, "Integer");
+        TCLAP::ValueArg<unsigned> files("", "files", "Number of files in each folder.", false, 16u, "Integer");
+        TCLAP::ValueArg<uint64_t> size_min("", "size-min", "Minimum size of a file.", false, 0u, "Bytes");
+        TCLAP::ValueArg<uint64_t> size_max("", "size-max", "Maximum size of a file.", false, 64u * 1024u, "Bytes");
+        TCLAP::SwitchArg uniform("", "uniform", "Draws the sizes uniformly. By default all the orders of magnitude are equally likely.");
+        TCLAP::ValueArg<double> duplicates("", "duplicates", "Ratio of left files having the content of another one.", false, 0.05, "Ratio");
+        TCLAP::ValueArg<double> modified("", "modified", "Ratio of left files modified on the right.", false, 0.05, "Ratio");
+        TCLAP::ValueArg<double> renamed("", "renamed", "Ratio of left files moved on the right.", false, 0.05, "Ratio");
+        TCLAP::ValueArg<double> removed("", "removed", "Ratio of left files missing on the right.", false, 0.05, "Ratio");
+        TCLAP::ValueArg<double> added("", "added", "Number of files added on the right, relative to the number of left files.", false, 0.05, "Ratio");
+        cmd.add(left);
+        cmd.add(right);
+        cmd.add(output);
+        cmd.add(seed);
+        cmd.add(depth);
+        cmd.add(folders);
+        cmd.add(files);
+        cmd.add(size_min);
+        cmd.add(size_max);
+        cmd.add(uniform);
+        cmd.add(duplicates);
+        cmd.add(modified);
+        cmd.add(renamed);
+        cmd.add(removed);
+        cmd.add(added);
+        cmd.parse(argc, argv);
+        spec_tree_t spec;
+        spec.seed = seed.getValue();
+        spec.depth = depth.getValue();
+        spec.nb_folders = folders.getValue();
+        spec.nb_files = files.getValue();
+        spec.size_min = size_min.getValue();
+        spec.size_max = size_max.getValue();
+        spec.distribution = uniform.getValue() ? eSizeDistribution::UNIFORM : eSizeDistribution::LOG_UNIFORM;
+        spec.ratio_duplicates = duplicates.getValue();
+        spec.ratio_modified = modified.getValue();
+        spec.ratio_renamed = renamed.getValue();
+        spec.ratio_removed = removed.getValue();
+        spec.ratio_added = added.getValue();
+        const auto path_left = left.getValue();
+        const auto path_right = right.getValue();
+        const auto path_output = output.getValue();
+        if (path_right.empty() && !path_output.empty()) {
+            throw runtime_error{ "A right folder is required to produce the expected differences." };
+        }
+
+        // Generate
+        CTreeGenerator generator{ spec };
+        cout << "\nGENERATING \"" << path_left << '\"' << endl;
+        if (path_right.empty()) {
+            generator.generate(path_left);
+        }
+        else {
+            // The renamed files are reported with the hash of the secure algorithm
+            const cf::CFactoryInfoSecure factory{ make_unique<cf::CLoggerNull>() };
+            const auto diff = generator.generate(path_left, path_right, [&factory](const fs::path& path) {
+                return factory.collectFile(path).hash;
+            });
+            if (!path_output.empty()) {
+                ofstream stream{ path_output, ios::out };
+                stream << cf::Json(diff);
+                if (!stream.flush()) {
+                    throw runtime_error{ "Cannot write to " + path_output };
+                }
+            }
+        }
+        cout << generator.nbFilesLeft() << " left files, " << generator.bytesWritten() << " bytes written" << endl;
+    }
+    catch (TCLAP::ArgException &e)  // catch any exceptions
+    {
+        std::cerr << "error: " << e.error() << std::endl;
+        return -1;
+    }
+    catch (const exception& e)
+    {
+        CLogger logger;
+        logger.error(e.what());
+        return -1;
+    }
+
+    return 0;
+}
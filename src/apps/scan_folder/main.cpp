@@ -19,7 +19,12 @@
 #include <cstdint>
 #include <array>
 #include <string>
+#include <list>
 #include <fstream>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <functional>
 
 #include <tclap/CmdLine.h>
 
@@ -39,26 +44,125 @@ int main(int argc, char* argv[])
     TCLAP::ValueArg<string> folder("d", "dir", "The directory to be analyzed", true, "", "Directory's path");
     TCLAP::ValueArg<string> output("o", "output", "The JSON file that will contain the descrition of the scanned folder", true, "",  "JSON filepath");
     TCLAP::SwitchArg fast("f", "fast", "Use the fast algorithm to represent the files' content. Way faster, but less reliable than the default algorithm.");
+    TCLAP::ValueArg<string> cache("c", "cache", "A file caching the hashes of the scanned files. Unchanged files are not hashed again.", false, "", "Cache filepath");
+    TCLAP::ValueArg<string> baseline("b", "baseline", "A JSON file produced by a previous scan of the directory. Only the files modified since are hashed, using the algorithm of the baseline.", false, "", "JSON filepath");
+    TCLAP::ValueArg<unsigned> watch("w", "watch", "Keeps watching the directory after the scan. The JSON file is updated at the given interval if some files changed.", false, 0u, "Seconds");
+    TCLAP::MultiArg<string> deltas("", "delta", "A delta applied to the baseline. Several deltas are applied in the order they are given.", false, "JSON filepath");
+    TCLAP::SwitchArg write_delta("", "write-delta", "Writes only the changes relative to the baseline: files added, modified and removed.");
+    TCLAP::ValueArg<unsigned> timeout("t", "timeout", "Stops the scan if it is not done within the given time.", false, 0u, "Seconds");
+    TCLAP::ValueArg<unsigned> memory("m", "memory", "Bounds the memory used to scan the directory. Beyond it, temporary files are used. Ignored with a baseline or a watch.", false, 0u, "MiB");
+    TCLAP::SwitchArg stats("", "stats", "Displays the time spent in each phase of the scan and some counters.");
+    TCLAP::ValueArg<string> trace("", "trace", "Writes a Chrome trace of the scan, to be opened in chrome://tracing or Perfetto.", false, "", "JSON filepath");
+    TCLAP::ValueArg<unsigned> depth_stat("", "stat-depth", "Number of file statuses requested at once by the fast algorithm. Raise it on network filesystems, up to 256.", false, 16u, "Requests");
+    TCLAP::MultiArg<string> includes("", "include", "Only the files matching this gitignore style pattern, or inside a matching directory, are scanned. Can be repeated.", false, "Pattern");
+    TCLAP::MultiArg<string> excludes("", "exclude", "The files and directories matching this gitignore style pattern are ignored. Can be repeated.", false, "Pattern");
+    TCLAP::ValueArg<unsigned> sampling("", "sample-above", "The files larger than this are not hashed whole by the secure algorithm: only their size, first and last blocks and some blocks in between. Their hashes are tagged as sampled.", false, 0u, "MiB");
+    TCLAP::ValueArg<unsigned> samples("", "samples", "Number of blocks of 64 KiB sampled between the first and the last ones, with --sample-above.", false, 16u, "Blocks");
+    TCLAP::SwitchArg digests("", "digests", "Also writes the digests of the directories in the JSON file, so that comparing it does not compute them again.");
     cmd.add(folder);
     cmd.add(output);
     cmd.add(fast);
+    cmd.add(cache);
+    cmd.add(baseline);
+    cmd.add(watch);
+    cmd.add(deltas);
+    cmd.add(write_delta);
+    cmd.add(timeout);
+    cmd.add(memory);
+    cmd.add(stats);
+    cmd.add(trace);
+    cmd.add(depth_stat);
+    cmd.add(includes);
+    cmd.add(excludes);
+    cmd.add(sampling);
+    cmd.add(samples);
+    cmd.add(digests);
     cmd.parse(argc, argv);
     const auto path_folder = folder.getValue();
     const auto path_output = output.getValue();
     const auto fast_hash = fast.getValue();
     const auto algo = fast_hash ? cf::eCollectingAlgorithm::FAST : cf::eCollectingAlgorithm::SECURE;
+    cf::options_t options;
+    options.path_cache = cache.getValue();
+    if (timeout.getValue() != 0u) {
+        options.deadline = chrono::steady_clock::now() + chrono::seconds{ timeout.getValue() };
+    }
+    options.memory_budget = static_cast<size_t>(memory.getValue()) * 1024u * 1024u;
+    if (stats.getValue()) {
+        options.stats = make_shared<cf::stats_t>();
+    }
+    options.path_trace = trace.getValue();
+    options.depth_stat = depth_stat.getValue();
+    options.includes.assign(includes.getValue().begin(), includes.getValue().end());
+    options.excludes.assign(excludes.getValue().begin(), excludes.getValue().end());
+    options.size_sampling = static_cast<uint64_t>(sampling.getValue()) * 1024u * 1024u;
+    options.nb_samples = samples.getValue();
+    options.digests = digests.getValue();
+    const auto path_baseline = baseline.getValue();
+    const auto interval_watch = watch.getValue();
+    const auto paths_delta = deltas.getValue();
+    const auto only_delta = write_delta.getValue();
     
 
     cout << "\nSCANNING \"" << path_folder << '\"' << endl;
     
-    try {      
-        const auto json = cf::ScanFolder(path_folder, algo, make_unique<CLogger>());
-        ofstream stream{ path_output , ios::out };
-        if (!stream) {
+    // The file is replaced at once: readers never see a partial snapshot
+    const auto write_output = [&path_output](const function<void(ostream&)>& write) {
+        const auto path_tmp = path_output + ".tmp";
+        {
+            ofstream stream{ path_tmp, ios::out };
+            if (!stream) {
+                throw runtime_error{ "Cannot write to " + path_tmp };
+            }
+            try {
+                write(stream);
+                if (!stream.flush()) {
+                    throw runtime_error{ "Cannot write to " + path_tmp };
+                }
+            }
+            catch (...) { // No partial file is left behind
+                stream.close();
+                std::remove(path_tmp.c_str());
+                throw;
+            }
+        }
+        if (std::rename(path_tmp.c_str(), path_output.c_str()) != 0) {
             throw runtime_error{ "Cannot write to " + path_output };
         }
-		
-		cf::WriteWString(stream, json);
+    };
+    const auto write_json = [&write_output](const string& json) {
+        write_output([&json](ostream& stream) { stream << json; });
+    };
+
+    try {
+        if (interval_watch == 0u) {
+            if (path_baseline.empty()) {
+                if (only_delta || !paths_delta.empty()) {
+                    throw runtime_error{ "A baseline is required to use deltas." };
+                }
+                // Streamed: the size of the JSON string does not matter
+                write_output([&](ostream& stream) { cf::ScanFolder(path_folder, algo, stream, make_unique<CLogger>(), options); });
+            }
+            else {
+                const cf::json_t json_baseline{ path_baseline, list<string>{ paths_delta.begin(), paths_delta.end() } };
+                write_json(only_delta ?
+                    cf::ScanFolderDelta(path_folder, json_baseline, make_unique<CLogger>(), options) :
+                    cf::ScanFolder(path_folder, json_baseline, make_unique<CLogger>(), options));
+            }
+        }
+        else {
+            cf::CWatcher watcher{ path_folder, algo, make_unique<CLogger>(), options };
+            auto changes = watcher.changes();
+            write_json(watcher.json());
+            cout << "\nWATCHING \"" << path_folder << '\"' << endl;
+            while (true) {
+                this_thread::sleep_for(chrono::seconds{ interval_watch });
+                if (watcher.changes() != changes) {
+                    changes = watcher.changes();
+                    write_json(watcher.json());
+                }
+            }
+        }
     }
     catch (const exception& e) {
         CLogger logger;
@@ -66,5 +170,8 @@ int main(int argc, char* argv[])
         return -1;
     }
 
+    if (options.stats) {
+        CLogger{}.stats(*options.stats);
+    }
 	return 0;
 }
@@ -15,35 +15,208 @@
 16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 17 */
 
-#include <sstream>
+#include <string>
+#include <vector>
+#include <list>
+#include <ostream>
+#include <limits>
+#include <stdexcept>
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
 
 #include "CompareFolders.hpp"
 #include "CCollectionInfo.hpp"
+#include "CHasher.hpp"
+#include "Utilities.hpp"
+#include "CTrace.hpp"
 
 
 using namespace std;
-namespace pt = boost::property_tree;
 
 
 
 namespace  cf
 {
+
+    static constexpr size_t SIZE_BUFFER_JSON = 64u * 1024u;  ///< Size of the JSON written to a stream at once
+
+#ifdef _WIN32
+    static constexpr char SEPARATOR = '\\';    ///< Separator of the relative paths' components
+#else
+    static constexpr char SEPARATOR = '/';     ///< Separator of the relative paths' components
+#endif
+
+    /// @brief Is the path located inside the directory? Any path is located inside the root, whose path is empty.
+    static inline bool is_inside(const string& path, const string& directory)
+    {
+        return directory.empty() ||
+            (path.size() > directory.size() && path[directory.size()] == SEPARATOR && path.compare(0u, directory.size(), directory) == 0);
+    }
+
+    /// @brief Returns the last component of a path
+    static inline string name(const string& path)
+    {
+        const auto pos = path.rfind(SEPARATOR);
+        return pos == string::npos ? path : path.substr(pos + 1u);
+    }
+
+    /// @brief Returns the first entry located after the directory's content
+    template<typename T>
+    static inline typename map<string, T>::const_iterator end_directory(const map<string, T>& entries, const string& directory)
+    {
+        return directory.empty() ? entries.end() : entries.lower_bound(directory + static_cast<char>(SEPARATOR + 1));
+    }
+
+    /// @brief Looks for the shallowest directory containing the path with the same digest on both sides
+    /// @param differing Chain of the directories containing the previous path and known to differ. Updated.
+    /// @details Thanks to the chain, each directory is checked only once when the paths are visited in order.
+    static bool find_same_directory(const string& path, vector<string>& differing,
+        const map<string, string>& lhs, const map<string, string>& rhs, string& directory)
+    {
+        const auto isSame = [&lhs, &rhs](const string& dir) {
+            const auto digest_left = lhs.find(dir);
+            const auto digest_right = rhs.find(dir);
+            return digest_left != lhs.end() && digest_right != rhs.end() && digest_left->second == digest_right->second;
+        };
+
+        while (!differing.empty() && !is_inside(path, differing.back())) {
+            differing.pop_back();
+        }
+        if (differing.empty()) {
+            if (isSame(string{})) {
+                directory.clear();
+                return true;
+            }
+            differing.emplace_back();
+        }
+
+        const auto pos = differing.back().empty() ? 0u : differing.back().size() + 1u;
+        for (auto sep = path.find(SEPARATOR, pos); sep != string::npos; sep = path.find(SEPARATOR, sep + 1u))
+        {
+            auto dir = path.substr(0u, sep);
+            if (isSame(dir)) {
+                directory = std::move(dir);
+                return true;
+            }
+            differing.push_back(std::move(dir));
+        }
+        return false;
+    }
+
+
+    /// @brief Computes the digests of the directories from the files' hashes, visited in the order of their paths
+    /// @details As the paths are sorted, the content of a directory is contiguous:
+    ///          the directories are opened and closed like a stack while visiting the paths.
+    ///          Each child is hashed with its type, name and digest.
+    class CDigestBuilder
+    {
+    public:
+        CDigestBuilder() {
+            _opened.emplace_back(string{});
+        }
+
+        /// @brief Adds a file, whose path comes after the previous one
+        void add(const string& path, const string& hash)
+        {
+            while (!is_inside(path, _opened.back().path)) {
+                close();
+            }
+            const auto& current = _opened.back().path;
+            for (auto sep = path.find(SEPARATOR, current.empty() ? 0u : current.size() + 1u); sep != string::npos; sep = path.find(SEPARATOR, sep + 1u)) {
+                _opened.emplace_back(path.substr(0u, sep));
+            }
+            update(_opened.back().hasher, 'f', name(path), hash);
+        }
+
+        /// @brief Returns the digests of all the directories, by relative path
+        map<string, string> finish()
+        {
+            while (!_opened.empty()) {
+                close();
+            }
+            return std::move(_digests);
+        }
+
+    private:
+        struct directory_t {
+            explicit directory_t(string p_path) :
+                path{ std::move(p_path) }
+            {   }
+            const string path;
+            CHasher hasher;
+        };
+
+        static void update(CHasher& hasher, const char type, const string& name, const string& digest)
+        {
+            hasher.update(&type, 1u);
+            hasher.update(name.c_str(), name.size() + 1u);
+            hasher.update(digest.c_str(), digest.size() + 1u);
+        }
+
+        /// @brief Closes the current directory, adding its digest to its parent
+        void close()
+        {
+            auto& directory = _opened.back();
+            auto digest = directory.hasher.digest();
+            auto path = directory.path;
+            _opened.pop_back();
+            if (!_opened.empty()) {
+                update(_opened.back().hasher, 'd', name(path), digest);
+            }
+            _digests.emplace(std::move(path), std::move(digest));
+        }
+
+        list<directory_t> _opened;      ///< From the root to the current directory
+        map<string, string> _digests;   ///< Digests of the closed directories
+    };
+
+
     
     ///////////////////////
 
-    void CCollectionInfo::setInfo(const fs::path& path, const info_t& info)
-    {        
+    CCollectionInfo::CCollectionInfo(const CCollectionInfo& rhs) :
+        _file_infos{ rhs._file_infos },
+        _hash_files{ rhs._hash_files },
+        _errors{ rhs._errors },
+        _root{ rhs._root },
+        _algo{ rhs._algo },
+        _seconds_only{ rhs._seconds_only },
+        _time_scan_ns{ rhs._time_scan_ns },
+        _digests_valid{ false }
+    {   }
+
+
+    CCollectionInfo::CCollectionInfo(CCollectionInfo&& rhs) :
+        _file_infos{ std::move(rhs._file_infos) },
+        _hash_files{ std::move(rhs._hash_files) },
+        _errors{ std::move(rhs._errors) },
+        _root{ rhs._root },
+        _algo{ rhs._algo },
+        _seconds_only{ rhs._seconds_only },
+        _time_scan_ns{ rhs._time_scan_ns },
+        _dir_digests{ std::move(rhs._dir_digests) },
+        _digests_valid{ rhs._digests_valid }
+    {
+        rhs._digests_valid = false;
+    }
+
+
+
+    ///////////////////////
+
+    void CCollectionInfo::setInfo(const string& path, const info_t& info)
+    {
+        _digests_valid = false;
+        _errors.erase(path);
+
         // Is it the first time a hash is provided for this file?
         {
             const auto idx =_file_infos.find(path);
             if(idx == _file_infos.end()) {
                 _file_infos.emplace(make_pair(path, info));
             }
-            else {
-                idx->second = info;
+            else { // Updating: the file is no more listed with its former hash
+                removePath(path);
+                _file_infos.emplace(make_pair(path, info));
             }
         }
         
@@ -51,24 +224,41 @@ namespace  cf
         {
             const auto idx = _hash_files.find(info.hash);
             if(idx == _hash_files.end()) {
-                _hash_files.emplace(make_pair(info.hash, list<fs::path>{path}));
+                _hash_files.emplace(make_pair(info.hash, list<string>{path}));
             }
             else {
                 idx->second.push_back(path);
             }
         }
     }
+
+
+
+    void CCollectionInfo::setError(const string& path, const string& error)
+    {
+        removePath(path);
+        _errors[path] = error;
+    }
     
     
     
     ///////////////////////
     
-    void CCollectionInfo::removePath(const fs::path& path)
+    const CCollectionInfo::info_t* CCollectionInfo::find(const string& path) const
+    {
+        const auto file_info = _file_infos.find(path);
+        return file_info == _file_infos.end() ? nullptr : &file_info->second;
+    }
+
+
+    void CCollectionInfo::removePath(const string& path)
     {
+        _errors.erase(path);
         const auto file_info = _file_infos.find(path);
         if(file_info == _file_infos.end()) { // not found
             return;
         }
+        _digests_valid = false;
         
         // Removing the entry in the collection of files
         const auto file = file_info->first;
@@ -79,41 +269,261 @@ namespace  cf
         const auto hash_files = _hash_files.find(info.hash);
         assert(hash_files != _hash_files.end());
         auto& files_with_hash = hash_files->second;
-        const auto idx_file = find(files_with_hash.begin(), files_with_hash.end(), file);
+        const auto idx_file = std::find(files_with_hash.begin(), files_with_hash.end(), file);
         assert(idx_file != files_with_hash.end());
         files_with_hash.erase(idx_file);
         if(files_with_hash.empty()) { // No more files with the same hash: erasing the entry
             _hash_files.erase(hash_files);
         }
     }
+
+
+    void CCollectionInfo::removeDirectory(const string& directory)
+    {
+        auto file_info = _file_infos.lower_bound(directory + SEPARATOR);
+        const auto last = end_directory(_file_infos, directory);
+        while (file_info != last) {
+            const auto path = (file_info++)->first;
+            removePath(path);
+        }
+        _errors.erase(_errors.lower_bound(directory + SEPARATOR), end_directory(_errors, directory));
+    }
     
     
     
+    ///////////////////////
+
+    void CCollectionInfo::filter(const CFilter& filter)
+    {
+        if (filter.empty()) {
+            return;
+        }
+        for (auto file_info = _file_infos.begin(); file_info != _file_infos.end(); ) {
+            const auto path = (file_info++)->first;
+            if (!filter.accepts(path)) {
+                removePath(path);
+            }
+        }
+        for (auto error = _errors.begin(); error != _errors.end(); ) {
+            if (filter.accepts(error->first)) {
+                ++error;
+            }
+            else {
+                error = _errors.erase(error);
+            }
+        }
+    }
+
+
+
+    ///////////////////////
+
+    void CCollectionInfo::merge(CCollectionInfo&& rhs)
+    {
+        _digests_valid = false;
+        for (auto& file_info : rhs._file_infos) {
+            _file_infos.emplace_hint(_file_infos.end(), file_info.first, std::move(file_info.second));
+        }
+        for (auto& hash_files : rhs._hash_files) {
+            auto& files_with_hash = _hash_files[hash_files.first];
+            files_with_hash.splice(files_with_hash.end(), hash_files.second);
+        }
+        for (auto& error : rhs._errors) {
+            _errors.emplace_hint(_errors.end(), error.first, std::move(error.second));
+        }
+        rhs._file_infos.clear();
+        rhs._hash_files.clear();
+        rhs._errors.clear();
+        rhs._digests_valid = false;
+    }
+
+
+
+    ///////////////////////
+
+    /// @details The returned map is not modified as long as the collection is not: it can be used out of the lock.
+    const map<string, string>& CCollectionInfo::digests() const
+    {
+        const lock_guard<mutex> lock{ _mutex_digests };
+        if (!_digests_valid) {
+            computeDigests();
+        }
+        return _dir_digests;
+    }
+
+
+    void CCollectionInfo::setDigests(map<string, string>&& digests)
+    {
+        const lock_guard<mutex> lock{ _mutex_digests };
+        _dir_digests = std::move(digests);
+        _digests_valid = true;
+    }
+
+
+    void CCollectionInfo::computeDigests() const
+    {
+        CDigestBuilder builder;
+        for (const auto& file_info : _file_infos) {
+            builder.add(file_info.first, file_info.second.hash);
+        }
+        _dir_digests = builder.finish();
+        _digests_valid = true;
+    }
+
+
+
+    ///////////////////////
+
+    /// @details The fraction of second follows the whole seconds, separated by a dot.
+    string CCollectionInfo::HashSeconds(const string& hash)
+    {
+        return hash.substr(0u, hash.find('.'));
+    }
+
+
+    /// @details The fraction of second follows a dot, on 9 digits, as in the *fast* hashes.
+    ///          The times in whole seconds keep the former layout.
+    string CCollectionInfo::TimeString(const int64_t time_ns)
+    {
+        constexpr int64_t NS_PER_S = 1000000000;
+        auto seconds = time_ns / NS_PER_S;
+        auto fraction = time_ns % NS_PER_S;
+        if (fraction < 0) {
+            --seconds;
+            fraction += NS_PER_S;
+        }
+        auto time = to_string(seconds);
+        if (fraction != 0) {
+            const auto digits = to_string(fraction);
+            time += '.';
+            time.append(9u - digits.size(), '0');
+            time += digits;
+        }
+        return time;
+    }
+
+
+    int64_t CCollectionInfo::ParseTime(const string& time)
+    {
+        constexpr int64_t NS_PER_S = 1000000000;
+        const auto dot = time.find('.');
+        const auto seconds = stoll(time.substr(0u, dot));
+        int64_t fraction = 0;
+        if (dot != string::npos) {
+            const auto digits = time.substr(dot + 1u);
+            if (digits.empty() || digits.size() > 9u || digits.find_first_not_of("0123456789") != string::npos) {
+                throw invalid_argument{ "Invalid fraction of second: " + time };
+            }
+            fraction = stoll(digits + string(9u - digits.size(), '0'));
+        }
+        if (seconds > numeric_limits<int64_t>::max() / NS_PER_S - 1 || seconds < numeric_limits<int64_t>::min() / NS_PER_S) {
+            throw out_of_range{ "Invalid time: " + time };
+        }
+        return seconds * NS_PER_S + fraction;
+    }
+
+
+    /// @details The tag is `sampled:<size above which the files are sampled>x<number of samples>:`.
+    ///          The former versions wrote a bare `sampled:`, returned as is.
+    string CCollectionInfo::HashSampling(const string& hash)
+    {
+        const auto& tag = JSON_CONST_VALUES.HASH_SAMPLED;
+        if (hash.compare(0u, tag.size(), tag) != 0) {
+            return string{};
+        }
+        const auto end = hash.find(':', tag.size());
+        return hash.substr(0u, (end == string::npos) ? tag.size() : end + 1u);
+    }
+
+
+    /// @details Hashes sampled with different parameters never match: all the large files would be reported as different.
+    ///          A file of the same size sampled on a side only is also hashed whole on the other one.
+    ///          A file whose size changed may however cross the threshold.
+    void CCollectionInfo::CheckSampling(const info_t& lhs, const info_t& rhs)
+    {
+        const auto sampling_left = HashSampling(lhs.hash);
+        const auto sampling_right = HashSampling(rhs.hash);
+        if (sampling_left != sampling_right && ((!sampling_left.empty() && !sampling_right.empty()) || lhs.size == rhs.size)) {
+            throw ExceptionFatal{ "The collections to be compared were not sampled the same way: "
+                + (sampling_left.empty() ? string{ "whole" } : sampling_left) + " vs "
+                + (sampling_right.empty() ? string{ "whole" } : sampling_right) };
+        }
+    }
+
+
+    CCollectionInfo CCollectionInfo::toSecondsOnly() const
+    {
+        CCollectionInfo collection{ _root, _algo };
+        for (const auto& file_info : _file_infos) {
+            auto info = file_info.second;
+            info.hash = HashSeconds(info.hash);
+            collection.setInfo(file_info.first, info);
+        }
+        collection._errors = _errors;
+        collection._time_scan_ns = _time_scan_ns;
+        collection.setSecondsOnly();
+        return collection;
+    }
+
+
+
     ///////////////////////
     
-    diff_t CCollectionInfo::compare(CCollectionInfo rhs) const
+    diff_t CCollectionInfo::compare(const CCollectionInfo& rhs) const
     {
+        diff_t diff;
+        diff.root_left = _root;
+        diff.root_right = rhs._root;
+        CDiffCollector collector{ diff };
+        compare(rhs, collector);
+        return diff;
+    }
 
-        list<wstring> identical;
-        list<wstring> different;
-        list<wstring> unique_left;
-        list<wstring> unique_right;
-        list<diff_t::renamed_t> list_renamed;
 
+    void CCollectionInfo::compare(const CCollectionInfo& rhs, IDiffListener& listener) const
+    {
         if (_algo != rhs._algo) {
             throw ExceptionFatal{ "The collection to be compared with is based on another hash algorithm." };
         }
+        if (_algo == eCollectingAlgorithm::FAST && _seconds_only != rhs._seconds_only) {
+            if (_seconds_only) {
+                compare(rhs.toSecondsOnly(), listener);
+            }
+            else {
+                toSecondsOnly().compare(rhs, listener);
+            }
+            return;
+        }
 
-        for (const auto& file_info : _file_infos)
+        // The directories with the same digest on both sides are not visited: their files are identical
+        const auto& digests_left = digests();
+        const auto& digests_right = rhs.digests();
+        vector<string> differing;
+        string directory;
+
+        CTrace::CSpan span_left{ "compare left" };
+        auto it_left = _file_infos.begin();
+        while (it_left != _file_infos.end())
         {
+            if (find_same_directory(it_left->first, differing, digests_left, digests_right, directory)) {
+                for (const auto last = end_directory(_file_infos, directory); it_left != last; ++it_left) {
+                    listener.identical(it_left->first);
+                }
+                continue;
+            }
+            const auto& file_info = *it_left++;
             const auto& file_hash_right = rhs._file_infos.find(file_info.first);
-            if (file_hash_right != rhs._file_infos.end()) // file with the same relative path
+            if (rhs._errors.find(file_info.first) != rhs._errors.end()) { // unreadable on the right: cannot be proven identical
+                listener.different(file_info.first);
+            }
+            else if (file_hash_right != rhs._file_infos.end()) // file with the same relative path
             {
+                CheckSampling(file_info.second, file_hash_right->second);
                 if (file_hash_right->second.isIdentical(file_info.second)) { // identical
-                    identical.push_back(file_info.first.wstring());
+                    listener.identical(file_info.first);
                 }
                 else { // different
-                    different.push_back(file_info.first.wstring());
+                    listener.different(file_info.first);
                 }
             }
             else
@@ -122,7 +532,7 @@ namespace  cf
                 const auto& hash = file_info.second.hash;
                 const auto hash_files_right = rhs._hash_files.find(hash);
                 if (hash_files_right == std::end(rhs._hash_files)) {
-                    unique_left.push_back(file_info.first.wstring()); // Nope: it's unique to the left
+                    listener.uniqueLeft(file_info.first); // Nope: it's unique to the left
                 }
                 else
                 {  // Found some match: same file with a different relative path / filename
@@ -130,66 +540,301 @@ namespace  cf
                     renamed.hash = hash;
                     const auto& hash_files_left = _hash_files.find(hash);
                     for (const auto& file : hash_files_left->second) {
-                        renamed.left.push_back(file.wstring());
+                        renamed.left.push_back(file);
                     }
                     for (const auto& file : hash_files_right->second) {
-                        renamed.right.push_back(file.wstring());
+                        renamed.right.push_back(file);
                     }
-                    list_renamed.push_back(renamed);
+                    listener.renamed(renamed);
                 }
             }
         }
 
-        for (const auto& file_info : rhs._file_infos)
+        span_left.stop();
+        const CTrace::CSpan span_right{ "compare right" };
+        differing.clear();
+        auto it_right = rhs._file_infos.begin();
+        while (it_right != rhs._file_infos.end())
         {
-            const auto& path = file_info.first.wstring();
-            //Is the file in the identical or different lists?
-            const auto isIdentical = (find(begin(identical), end(identical), path) != end(identical));
-            const auto isDifferent = (find(begin(different), end(different), path) != end(different));
-            if (!isIdentical && !isDifferent) // Nope
+            if (find_same_directory(it_right->first, differing, digests_left, digests_right, directory)) {
+                it_right = end_directory(rhs._file_infos, directory);
+                continue;
+            }
+            const auto& file_info = *it_right++;
+            const auto& path = file_info.first;
+            if (_errors.find(path) != _errors.end()) { // unreadable on the left
+                listener.different(path);
+                continue;
+            }
+            // Was the file reported as identical or different? Only if it exists on both sides.
+            if (_file_infos.find(path) == end(_file_infos)) // Nope
             { 
                 // Has this file a twin with the same content here?
                 const auto& hash = file_info.second.hash;
                 const auto hasSomeTwins = (_hash_files.find(hash) != end(_hash_files));
                 if (!hasSomeTwins) {
-                    unique_right.push_back(path);
+                    listener.uniqueRight(path);
                 }
             }
         }
-        
-        
-        return diff_t{
-            _root.wstring(),
-            rhs._root.wstring(),
-            identical,
-            different,
-            unique_left,
-            unique_right,
-            list_renamed
-        };
+
+        // The files unreadable on a side and missing from the other one, or unreadable on both sides
+        for (const auto& error : _errors) {
+            if (rhs._errors.find(error.first) != rhs._errors.end()) {
+                listener.different(error.first);
+            }
+            else if (rhs._file_infos.find(error.first) == rhs._file_infos.end()) {
+                listener.uniqueLeft(error.first);
+            }
+        }
+        for (const auto& error : rhs._errors) {
+            if (_errors.find(error.first) == _errors.end() && _file_infos.find(error.first) == _file_infos.end()) {
+                listener.uniqueRight(error.first);
+            }
+        }
+    }
+
+    /// @brief Appends the members describing a collection, up to the root
+    /// @param time_scan_ns Time when the scan started. Not written if unknown.
+    static void append_header(string& json, const eCollectingAlgorithm algo, const bool seconds_only, const int64_t time_scan_ns, const string& root)
+    {
+        json += "{\n    ";
+        AppendJsonString(json, JSON_KEYS.GENERATOR);
+        json += ": ";
+        AppendJsonString(json, JSON_CONST_VALUES.GENERATOR);
+        json += ",\n    ";
+        AppendJsonString(json, JSON_KEYS.ALGO_HASH);
+        json += ": ";
+        if (algo == eCollectingAlgorithm::FAST) {
+            AppendJsonString(json, seconds_only ? JSON_CONST_VALUES.ALGO_HASH_FAST : JSON_CONST_VALUES.ALGO_HASH_FAST_NS);
+        }
+        else {
+            AppendJsonString(json, JSON_CONST_VALUES.ALGO_HASH_SECURE);
+        }
+        if (time_scan_ns != 0) {
+            json += ",\n    ";
+            AppendJsonString(json, JSON_KEYS.TIME_SCAN);
+            json += ": ";
+            AppendJsonString(json, CCollectionInfo::TimeString(time_scan_ns));
+        }
+        json += ",\n    ";
+        AppendJsonString(json, JSON_KEYS.ROOT);
+        json += ": ";
+        AppendJsonString(json, root);
+    }
+
+    /// @brief Appends the member describing a file
+    static void append_file(string& json, const string& path, const CCollectionInfo::info_t& info)
+    {
+        json += "        ";
+        AppendJsonString(json, path);
+        json += ": {\n            ";
+        AppendJsonString(json, JSON_KEYS.CONTENT.HASH);
+        json += ": ";
+        AppendJsonString(json, info.hash);
+        json += ",\n            ";
+        AppendJsonString(json, JSON_KEYS.CONTENT.TIME);
+        json += ": ";
+        AppendJsonString(json, CCollectionInfo::TimeString(info.time_modified_ns));
+        json += ",\n            ";
+        AppendJsonString(json, JSON_KEYS.CONTENT.SIZE);
+        json += ": ";
+        AppendJsonString(json, to_string(info.size));
+        json += "\n        }";
     }
 
-	/// @details The JSON file is coded in wstring to handle any special character in the filepaths
-	wstring CCollectionInfo::json() const
+    /// @brief Appends an object member holding some files
+    /// @param files The files, as pairs of path and info
+    template<typename T>
+    static void append_files(string& json, const string& key, const T& files)
     {
-        pt::wptree root;
-        root.put(JSON_KEYS.GENERATOR, JSON_CONST_VALUES.GENERATOR);
-        root.put(JSON_KEYS.ALGO_HASH, _algo == eCollectingAlgorithm::FAST ? JSON_CONST_VALUES.ALGO_HASH_FAST : JSON_CONST_VALUES.ALGO_HASH_SECURE);
-        root.put(JSON_KEYS.ROOT, _root.wstring());
-        pt::wptree node_files;
-        for (const auto& entry : _file_infos) {
-            pt::wptree node_info;
-            node_info.put(JSON_KEYS.CONTENT.HASH, wstring{begin(entry.second.hash), end(entry.second.hash)}); // Works because hash is plain 7-bit ASCII!
-            node_info.put(JSON_KEYS.CONTENT.TIME, entry.second.time_modified);
-            node_info.put(JSON_KEYS.CONTENT.SIZE, entry.second.size);
-            node_files.push_back(pt::wptree::value_type(entry.first.wstring(), node_info)); // not using "put()" as '.' is its delimiter
+        json += ",\n    ";
+        AppendJsonString(json, key);
+        json += ": {";
+        auto separator = "\n";
+        for (const auto& entry : files) {
+            json += separator;
+            append_file(json, entry.first, entry.second);
+            separator = ",\n";
         }
-        root.add_child(JSON_KEYS.CONTENT.FILES, node_files);
+        json += files.empty() ? "}" : "\n    }";
+    }
+
+    /// @brief Appends an object member whose values are strings
+    static void append_strings(string& json, const string& key, const map<string, string>& strings)
+    {
+        json += ",\n    ";
+        AppendJsonString(json, key);
+        json += ": {";
+        auto separator = "\n";
+        for (const auto& entry : strings) {
+            json += separator;
+            json += "        ";
+            AppendJsonString(json, entry.first);
+            json += ": ";
+            AppendJsonString(json, entry.second);
+            separator = ",\n";
+        }
+        json += strings.empty() ? "}" : "\n    }";
+    }
+
+
+    /// @details The JSON is written directly in UTF-8, with the layout of the former property_tree output.
+    ///          Numbers are still written as strings for the sake of compatibility.
+    string CCollectionInfo::json(const bool digests) const
+    {
+        string json;
+        json.reserve(256u + _root.size() + _file_infos.size() * 160u);
+        append_header(json, _algo, _seconds_only, _time_scan_ns, _root);
+        append_files(json, JSON_KEYS.CONTENT.FILES, _file_infos);
+        if (digests) {
+            append_strings(json, JSON_KEYS.CONTENT.DIRECTORIES, this->digests());
+        }
+        // Only written if required: the files without errors keep their former layout
+        if (!_errors.empty()) {
+            append_strings(json, JSON_KEYS.CONTENT.ERRORS, _errors);
+        }
+        json += "\n}\n";
+
+        return json;
+    }
 
-        // Get the string and returns
-        wstringstream stream{ ios_base::out };
-        pt::write_json(stream, root);
-        return stream.str();
+
+    ///////////////////////
+
+    CJsonWriter::CJsonWriter(ostream& stream, const string& root, const eCollectingAlgorithm algo, const bool seconds_only,
+                             const int64_t time_scan_ns, const bool digests) :
+        _stream(stream),
+        _digests{ digests ? make_unique<CDigestBuilder>() : nullptr },
+        _empty{ true }
+    {
+        _buffer.reserve(2u * SIZE_BUFFER_JSON);
+        append_header(_buffer, algo, seconds_only, time_scan_ns, root);
+        _buffer += ",\n    ";
+        AppendJsonString(_buffer, JSON_KEYS.CONTENT.FILES);
+        _buffer += ": {";
+    }
+
+
+    CJsonWriter::~CJsonWriter() = default;
+
+
+    void CJsonWriter::write(const string& path, const CCollectionInfo::info_t& info)
+    {
+        _buffer += _empty ? "\n" : ",\n";
+        append_file(_buffer, path, info);
+        if (_digests) {
+            _digests->add(path, info.hash);
+        }
+        _empty = false;
+        if (_buffer.size() >= SIZE_BUFFER_JSON) {
+            flush();
+        }
+    }
+
+
+    void CJsonWriter::close(const map<string, string>& errors)
+    {
+        _buffer += _empty ? "}" : "\n    }";
+        if (_digests) {
+            append_strings(_buffer, JSON_KEYS.CONTENT.DIRECTORIES, _digests->finish());
+        }
+        if (!errors.empty()) {
+            append_strings(_buffer, JSON_KEYS.CONTENT.ERRORS, errors);
+        }
+        _buffer += "\n}\n";
+        flush();
+        if (!_stream.flush()) {
+            throw Exception{ "Cannot write the JSON output." };
+        }
+    }
+
+
+    void CJsonWriter::flush()
+    {
+        _stream.write(_buffer.data(), static_cast<streamsize>(_buffer.size()));
+        _buffer.clear();
+    }
+
+
+
+    ///////////////////////
+
+    /// @details Both collections are walked in order: the delta is built in a single pass.
+    ///          The root digests identify the base and the result, so that a chain of deltas can be checked.
+    string CCollectionInfo::jsonDelta(const CCollectionInfo& base) const
+    {
+        if (_algo != base._algo || _seconds_only != base._seconds_only) {
+            throw ExceptionFatal{ "The base collection is based on another hash algorithm." };
+        }
+
+        list<pair<string, info_t>> added, modified;
+        list<string> removed;
+        auto it_base = base._file_infos.begin();
+        auto it_current = _file_infos.begin();
+        while (it_base != base._file_infos.end() || it_current != _file_infos.end())
+        {
+            if (it_current == _file_infos.end() || (it_base != base._file_infos.end() && it_base->first < it_current->first)) {
+                removed.push_back(it_base->first);
+                ++it_base;
+            }
+            else if (it_base == base._file_infos.end() || it_current->first < it_base->first) {
+                added.emplace_back(*it_current);
+                ++it_current;
+            }
+            else {
+                const auto& info_base = it_base->second;
+                const auto& info_current = it_current->second;
+                if (info_base.hash != info_current.hash || info_base.time_modified_ns != info_current.time_modified_ns || info_base.size != info_current.size) {
+                    modified.emplace_back(*it_current);
+                }
+                ++it_base;
+                ++it_current;
+            }
+        }
+
+        string json;
+        append_header(json, _algo, _seconds_only, _time_scan_ns, _root);
+        json += ",\n    ";
+        AppendJsonString(json, JSON_KEYS.DELTA.BASE);
+        json += ": ";
+        AppendJsonString(json, base.digests().at(string{}));
+        json += ",\n    ";
+        AppendJsonString(json, JSON_KEYS.DELTA.DIGEST);
+        json += ": ";
+        AppendJsonString(json, digests().at(string{}));
+        append_files(json, JSON_KEYS.DELTA.ADDED, added);
+        append_files(json, JSON_KEYS.DELTA.MODIFIED, modified);
+        json += ",\n    ";
+        AppendJsonString(json, JSON_KEYS.DELTA.REMOVED);
+        json += ": [";
+        auto separator = "\n";
+        for (const auto& path : removed) {
+            json += separator;
+            json += "        ";
+            AppendJsonString(json, path);
+            separator = ",\n";
+        }
+        json += removed.empty() ? "]" : "\n    ]";
+        // All the current errors: they replace the base's ones
+        if (!_errors.empty()) {
+            append_strings(json, JSON_KEYS.CONTENT.ERRORS, _errors);
+        }
+        json += "\n}\n";
+
+        return json;
+    }
+
+
+    void CCollectionInfo::applyDelta(const CCollectionInfo& changed, const list<string>& removed)
+    {
+        for (const auto& path : removed) {
+            removePath(path);
+        }
+        for (const auto& file_info : changed._file_infos) {
+            setInfo(file_info.first, file_info.second);
+        }
+        _errors = changed._errors;
     }
     
     
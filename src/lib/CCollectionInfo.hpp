@@ -22,10 +22,13 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <memory>
+#include <iosfwd>
 #include <mutex>
 #include <boost/filesystem.hpp>
 
 #include "CompareFolders.hpp"
+#include "CFilter.hpp"
 
 namespace fs = boost::filesystem;
 
@@ -34,58 +37,217 @@ namespace  cf {
     /// @brief This is a collection of hashes
     /// @details Internally it is built on two symetrical maps that can give the hash of a file or
     /// the files producing a given hash (useful if some files are duplicated).
-    /// All operations are **not** thread safe!
+    /// Paths are UTF-8 strings, relative to the root.
+    /// The const operations can be called concurrently, as long as the collection is not modified.
+    /// The other operations are **not** thread safe!
     class CCollectionInfo
     {
     public:
 
         /// @brief Informations about a file
         struct info_t {
-            bool isIdentical(const info_t& rhs) {
+            bool isIdentical(const info_t& rhs) const {
                 return hash == rhs.hash;
             }
             std::string hash;           ///< Hash of the file's content
-            std::time_t time_modified;  ///< Time of last  modification
+            std::int64_t time_modified_ns;  ///< Time of last modification, in nanoseconds
             std::uintmax_t size;
         };
 
         /// @brief Constructor from a given path
-        /// @param root Root folder containing the hashed files
-        CCollectionInfo(const fs::path& root, const cf::eCollectingAlgorithm algo) noexcept :
-            _root{ root }, _algo{ algo }
+        /// @param root Root folder containing the hashed files, UTF-8 encoded
+        CCollectionInfo(const std::string& root, const cf::eCollectingAlgorithm algo) :
+            _root{ root }, _algo{ algo }, _seconds_only{ false }, _time_scan_ns{ 0 }, _digests_valid{ false }
         {   }
         ~CCollectionInfo() = default;
+        /// @brief The copy computes its digests again, if ever required
+        CCollectionInfo(const CCollectionInfo& rhs);
+        CCollectionInfo(CCollectionInfo&& rhs);
 
         /// @brief Returns the hash algorithm
         inline cf::eCollectingAlgorithm hasher() const {
             return _algo;
         }
+
+        /// @brief Returns the root folder, UTF-8 encoded
+        inline const std::string& root() const {
+            return _root;
+        }
+
+        /// @brief Are the *fast* hashes made of the modification times in whole seconds, as in the former snapshots?
+        inline bool secondsOnly() const {
+            return _seconds_only;
+        }
+
+        /// @brief Records that the *fast* hashes are made of the modification times in whole seconds
+        inline void setSecondsOnly() {
+            _seconds_only = true;
+        }
+
+        /// @brief Returns the time when the scan started, in nanoseconds since the epoch. 0 if unknown.
+        inline std::int64_t timeScan() const {
+            return _time_scan_ns;
+        }
+
+        /// @brief Records the time when the scan started, in nanoseconds since the epoch
+        inline void setTimeScan(const std::int64_t time_ns) {
+            _time_scan_ns = time_ns;
+        }
+
+        /// @brief Returns a *fast* hash without the fraction of second of its modification time
+        static std::string HashSeconds(const std::string& hash);
+
+        /// @brief Returns a modification time as written in the JSON files: the seconds, then the fraction if any
+        static std::string TimeString(const std::int64_t time_ns);
+        /// @brief Reads a modification time written by TimeString(), or in whole seconds by the former versions
+        /// @details Throws **std::invalid_argument** or **std::out_of_range** if it is not a proper time
+        static std::int64_t ParseTime(const std::string& time);
+
+        /// @brief Returns the tag of a sampled hash, with its sampling parameters, or an empty string
+        static std::string HashSampling(const std::string& hash);
+        /// @brief Throws if the hashes of a file on both sides were not sampled the same way
+        static void CheckSampling(const info_t& lhs, const info_t& rhs);
         
         /// @brief Adds a hash corresponding to a given path
-        void setInfo(const fs::path& path, const info_t& info);
+        void setInfo(const std::string& path, const info_t& info);
+
+        /// @brief Records a file that could not be read, replacing its info if any
+        /// @param error Why the file could not be read
+        void setError(const std::string& path, const std::string& error);
+
+        /// @brief Returns the files that could not be read, and why
+        inline const std::map<std::string, std::string>& errors() const {
+            return _errors;
+        }
 
  		
-		/// @brief Exports the info as a JSON string
-        std::wstring json() const;
+		/// @brief Exports the info as an UTF-8 JSON string
+        /// @param digests Also writes the digests of the directories, so that reading the JSON does not compute them again
+        std::string json(const bool digests = false) const;
+
+        /// @brief Exports the changes relative to a base collection as an UTF-8 JSON string
+        /// @details May throw **ExceptionFatal**
+        std::string jsonDelta(const CCollectionInfo& base) const;
+
+        /// @brief Applies the changes described by a delta
+        /// @param changed The files added or modified, and all the files that could not be read
+        /// @param removed The paths of the files removed
+        void applyDelta(const CCollectionInfo& changed, const std::list<std::string>& removed);
         
+        /// @brief Returns the info of a path, or nullptr if not in the collection
+        /// @details Concurrent calls are safe as long as the collection is not modified.
+        const info_t* find(const std::string& path) const;
+
         /// @brief Removes the path from the collection
-        void removePath(const fs::path& path);
+        void removePath(const std::string& path);
+
+        /// @brief Removes all the paths located inside a directory
+        /// @param directory Relative path of the directory. Must not be empty.
+        void removeDirectory(const std::string& directory);
+
+        /// @brief Removes the files, and the errors, whose path the filter does not accept
+        void filter(const CFilter& filter);
+
+        /// @brief Moves all the entries of another collection into this one
+        /// @details The paths of both collections are expected to be distinct.
+        ///          Merging is faster if rhs' paths all come after this collection's.
+        void merge(CCollectionInfo&& rhs);
         
         /// @brief Compares the collection to another one.
+        /// @details A file that could not be read is reported as different if it exists on the other side.
+        ///          If one side is secondsOnly(), the fractions of second are ignored on the other side too.
+        ///          May throw **Exception**
+        diff_t compare(const CCollectionInfo& rhs) const;
+
+        /// @brief Compares the collection to another one, reporting the differences as they are found
         /// @details May throw **Exception**
-        diff_t compare(CCollectionInfo rhs) const;
+        void compare(const CCollectionInfo& rhs, IDiffListener& listener) const;
+
+        /// @brief Returns the aggregate digests of the directories, by relative path. The root's path is empty.
+        /// @details The digest of a directory is computed from the names and digests of its children (Merkle tree):
+        ///          two directories with the same digest have the very same content.
+        ///          The digests are computed on demand, then kept until the collection is modified.
+        ///          Concurrent calls are safe.
+        const std::map<std::string, std::string>& digests() const;
+
+        /// @brief Sets the digests of the directories, as previously returned by digests()
+        void setDigests(std::map<std::string, std::string>&& digests);
 
         /// @brief returns the number of paths
-        inline std::size_t size() {
+        inline std::size_t size() const {
             return _file_infos.size();
         }
         
     private:
+        /// @brief Computes the digests of all the directories in a single pass over the sorted paths
+        void computeDigests() const;
+
+        /// @brief Returns a copy whose *fast* hashes are made of the modification times in whole seconds
+        CCollectionInfo toSecondsOnly() const;
 
-        std::map<fs::path, info_t> _file_infos;                 ///< File pathes and their corresponding info
-        std::map<std::string, std::list<fs::path>> _hash_files; ///< Hash with the corresponding files. Useful for duplicate files.
-        const fs::path _root;                                   ///< Root folder containing all the files hashed
+        std::map<std::string, info_t> _file_infos;                  ///< File pathes and their corresponding info
+        std::map<std::string, std::list<std::string>> _hash_files;  ///< Hash with the corresponding files. Useful for duplicate files.
+        std::map<std::string, std::string> _errors;                 ///< Files that could not be read, and why
+        const std::string _root;                                    ///< Root folder containing all the files hashed
         const cf::eCollectingAlgorithm _algo;                   ///< Algotithm used to compute the hashes
+        bool _seconds_only;                                         ///< Are the fast hashes made of whole seconds?
+        std::int64_t _time_scan_ns;                                 ///< Time when the scan started. 0 if unknown.
+        mutable std::map<std::string, std::string> _dir_digests;    ///< Aggregate digests of the directories
+        mutable bool _digests_valid;                                ///< Are the digests up to date?
+        mutable std::mutex _mutex_digests;                          ///< Guards the digests computed by the const methods
+    };
+
+
+    class CDigestBuilder;
+
+    /// @brief Writes a collection to a stream one file at a time, with the layout of CCollectionInfo::json()
+    /// @details The files shall be written in the order of their paths.
+    ///          Only the digests of the directories are kept in memory.
+    class CJsonWriter
+    {
+    public:
+        /// @param stream Receives the JSON. It must outlive the writer.
+        /// @param seconds_only Are the *fast* hashes made of the modification times in whole seconds?
+        /// @param time_scan_ns Time when the scan started, in nanoseconds since the epoch. Not written if 0.
+        /// @param digests Also writes the digests of the directories
+        CJsonWriter(std::ostream& stream, const std::string& root, const cf::eCollectingAlgorithm algo, const bool seconds_only,
+                    const std::int64_t time_scan_ns, const bool digests = false);
+        ~CJsonWriter();
+        CJsonWriter(const CJsonWriter&) = delete;
+        void operator=(const CJsonWriter&) = delete;
+
+        /// @brief Writes a file, whose path comes after the previous one
+        void write(const std::string& path, const CCollectionInfo::info_t& info);
+
+        /// @brief Writes the digests of the directories, if requested, and the files that could not be read, ending the JSON
+        /// @details May throw **Exception**
+        void close(const std::map<std::string, std::string>& errors);
+
+    private:
+        /// @brief Writes the buffer to the stream
+        void flush();
+
+        std::ostream& _stream;
+        std::string _buffer;                        ///< Pending JSON
+        std::unique_ptr<CDigestBuilder> _digests;   ///< Digests of the directories written. Null if not requested.
+        bool _empty;                                ///< No file written yet?
+    };
+
+
+    /// @brief Listener gathering the differences into a diff_t
+    class CDiffCollector : public IDiffListener
+    {
+    public:
+        explicit CDiffCollector(diff_t& diff) :
+            _diff(diff)
+        {   }
+        void identical(const std::string& path) override { _diff.identical.push_back(path); }
+        void different(const std::string& path) override { _diff.different.push_back(path); }
+        void uniqueLeft(const std::string& path) override { _diff.unique_left.push_back(path); }
+        void uniqueRight(const std::string& path) override { _diff.unique_right.push_back(path); }
+        void renamed(const diff_t::renamed_t& renamed) override { _diff.renamed.push_back(renamed); }
+    private:
+        diff_t& _diff;
     };
     
 }
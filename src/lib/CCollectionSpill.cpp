@@ -0,0 +1,292 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <map>
+#include <utility>
+
+#include "CCollectionSpill.hpp"
+#include "CTrace.hpp"
+
+
+using namespace std;
+
+
+namespace  cf
+{
+
+    static constexpr char KIND_FILE = 'F';      ///< Encoded entry holding the info of a file
+    static constexpr char KIND_ERROR = 'E';     ///< Encoded entry holding an error
+    static constexpr char SIDE_LEFT = 'L';      ///< File of the left collection, sorted by hash
+    static constexpr char SIDE_RIGHT = 'R';     ///< File of the right collection, sorted by hash
+
+    /// @brief Encodes the value of an entry: its kind, then either the time, size and hash, or the error
+    static string encode(const CCollectionInfo::info_t& info)
+    {
+        const auto time_modified = info.time_modified_ns;
+        const auto size = static_cast<uint64_t>(info.size);
+        string value;
+        value.reserve(1u + sizeof(time_modified) + sizeof(size) + info.hash.size());
+        value.push_back(KIND_FILE);
+        value.append(reinterpret_cast<const char*>(&time_modified), sizeof(time_modified));
+        value.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        value.append(info.hash);
+        return value;
+    }
+
+    /// @brief Decodes the value of an entry
+    static void decode(const string& value, CCollectionSpill::entry_t& entry)
+    {
+        constexpr size_t SIZE_FILE = 1u + sizeof(int64_t) + sizeof(uint64_t);
+        if (!value.empty() && value[0] == KIND_ERROR) {
+            entry.info = { string{}, 0, 0u };
+            entry.error.assign(value, 1u, string::npos);
+            return;
+        }
+        if (value.size() < SIZE_FILE || value[0] != KIND_FILE) {
+            throw ExceptionFatal{ "Corrupted temporary file for " + entry.path };
+        }
+        int64_t time_modified;
+        uint64_t size;
+        memcpy(&time_modified, value.data() + 1u, sizeof(time_modified));
+        memcpy(&size, value.data() + 1u + sizeof(time_modified), sizeof(size));
+        entry.info.hash.assign(value, SIZE_FILE, string::npos);
+        entry.info.time_modified_ns = time_modified;
+        entry.info.size = static_cast<uintmax_t>(size);
+        entry.error.clear();
+    }
+
+
+
+    ///////////////////////
+
+    CCollectionSpill::CCollectionSpill(const string& root, const eCollectingAlgorithm algo, const size_t budget, const fs::path& dir_temp) :
+        _root{ root },
+        _algo{ algo },
+        _seconds_only{ false },
+        _time_scan_ns{ 0 },
+        _budget{ budget },
+        _dir_temp{ dir_temp },
+        _entries{ budget, dir_temp },
+        _peak_compare{ 0u }
+    {   }
+
+
+
+    ///////////////////////
+
+    void CCollectionSpill::setInfo(const string& path, const CCollectionInfo::info_t& info)
+    {
+        _entries.add(path, encode(info));
+    }
+
+
+    void CCollectionSpill::setError(const string& path, const string& error)
+    {
+        _entries.add(path, KIND_ERROR + error);
+    }
+
+
+    CCollectionSpill::CReader CCollectionSpill::read()
+    {
+        return CReader{ _entries.read() };
+    }
+
+
+    bool CCollectionSpill::CReader::next(entry_t& entry)
+    {
+        if (!_reader.next(_record)) {
+            return false;
+        }
+        entry.path = std::move(_record.first);
+        decode(_record.second, entry);
+        return true;
+    }
+
+
+    void CCollectionSpill::visit(const function<void(const entry_t&)>& visitor)
+    {
+        auto reader = read();
+        entry_t entry;
+        while (reader.next(entry)) {
+            visitor(entry);
+        }
+    }
+
+
+    void CCollectionSpill::json(ostream& stream, const bool digests)
+    {
+        CJsonWriter writer{ stream, _root, _algo, _seconds_only, _time_scan_ns, digests };
+        map<string, string> errors;
+        visit([&writer, &errors](const entry_t& entry) {
+            if (entry.error.empty()) {
+                writer.write(entry.path, entry.info);
+            }
+            else {
+                errors.emplace_hint(errors.end(), entry.path, entry.error);
+            }
+        });
+        writer.close(errors);
+    }
+
+
+
+    ///////////////////////
+
+    /// @details    The first pass merge-joins the paths. The files present on both sides, and the unreadable ones,
+    ///             are reported at once. Every readable file is also added to a sorter keyed by its hash,
+    ///             flagged as an *orphan* if its path is missing from the other side.
+    ///             The second pass reads the files grouped by hash: an orphan is renamed if the other side
+    ///             has a file with the same hash, unique otherwise.
+    ///             Only the files of a single hash are held in memory, as the renamed_t reported require.
+    ///             The entries sorted by hash are about as large as the entries sorted by path: if the latter
+    ///             take more than half of both budgets, they are written to disk first.
+    void CCollectionSpill::compare(CCollectionSpill& rhs, IDiffListener& listener)
+    {
+        if (_algo != rhs._algo) {
+            throw ExceptionFatal{ "The collection to be compared with is based on another hash algorithm." };
+        }
+
+        // Memory: the sort by hash gets what the entries held in memory leave of both budgets
+        size_t budget = 0u; // unbounded
+        if (_budget != 0u && rhs._budget != 0u) {
+            budget = _budget + rhs._budget;
+            if (2u * (_entries.memory() + rhs._entries.memory()) > budget) {
+                _entries.release();
+                rhs._entries.release();
+            }
+            budget -= _entries.memory() + rhs._entries.memory();
+        }
+
+        // Paths
+        CTrace::CSpan span_paths{ "compare paths" };
+        CSorterExternal hashes{ budget, _dir_temp };
+        const auto add_hash = [&hashes](const entry_t& entry, const char side, const bool isOrphan) {
+            string value;
+            value.reserve(2u + entry.path.size());
+            value.push_back(side);
+            value.push_back(isOrphan ? '1' : '0');
+            value.append(entry.path);
+            hashes.add(entry.info.hash, std::move(value));
+        };
+        // The former fast hashes ignore the fraction of second: so does the other side
+        const auto isFast = _algo == eCollectingAlgorithm::FAST;
+        const auto truncate_left = isFast && rhs._seconds_only && !_seconds_only;
+        const auto truncate_right = isFast && _seconds_only && !rhs._seconds_only;
+        const auto read_next = [](CReader& reader, entry_t& entry, const bool truncate) {
+            if (!reader.next(entry)) {
+                return false;
+            }
+            if (truncate && entry.error.empty()) {
+                entry.info.hash = CCollectionInfo::HashSeconds(entry.info.hash);
+            }
+            return true;
+        };
+        auto reader_left = read();
+        auto reader_right = rhs.read();
+        entry_t left, right;
+        auto has_left = read_next(reader_left, left, truncate_left);
+        auto has_right = read_next(reader_right, right, truncate_right);
+        while (has_left || has_right)
+        {
+            if (has_left && (!has_right || left.path < right.path)) { // missing from the right
+                if (left.error.empty()) {
+                    add_hash(left, SIDE_LEFT, true);
+                }
+                else {
+                    listener.uniqueLeft(left.path);
+                }
+                has_left = read_next(reader_left, left, truncate_left);
+            }
+            else if (!has_left || right.path < left.path) { // missing from the left
+                if (right.error.empty()) {
+                    add_hash(right, SIDE_RIGHT, true);
+                }
+                else {
+                    listener.uniqueRight(right.path);
+                }
+                has_right = read_next(reader_right, right, truncate_right);
+            }
+            else { // same path. An unreadable file cannot be proven identical.
+                if (left.error.empty() && right.error.empty()) {
+                    CCollectionInfo::CheckSampling(left.info, right.info);
+                }
+                if (left.error.empty() && right.error.empty() && left.info.isIdentical(right.info)) {
+                    listener.identical(left.path);
+                }
+                else {
+                    listener.different(left.path);
+                }
+                if (left.error.empty()) {
+                    add_hash(left, SIDE_LEFT, false);
+                }
+                if (right.error.empty()) {
+                    add_hash(right, SIDE_RIGHT, false);
+                }
+                has_left = read_next(reader_left, left, truncate_left);
+                has_right = read_next(reader_right, right, truncate_right);
+            }
+        }
+
+        // Hashes
+        span_paths.stop();
+        const CTrace::CSpan span_hashes{ "compare hashes" };
+        diff_t::renamed_t renamed;
+        vector<string> orphans_left, orphans_right;
+        const auto report = [&listener, &renamed, &orphans_left, &orphans_right] {
+            for (const auto& path : orphans_left) {
+                if (renamed.right.empty()) {
+                    listener.uniqueLeft(path);
+                }
+                else {
+                    listener.renamed(renamed);
+                }
+            }
+            if (renamed.left.empty()) {
+                for (const auto& path : orphans_right) {
+                    listener.uniqueRight(path);
+                }
+            }
+        };
+        auto reader_hashes = hashes.read();
+        CSorterExternal::record_t record;
+        while (reader_hashes.next(record))
+        {
+            if (record.first != renamed.hash) { // new group
+                report();
+                renamed.hash = std::move(record.first);
+                renamed.left.clear();
+                renamed.right.clear();
+                orphans_left.clear();
+                orphans_right.clear();
+            }
+            const auto side = record.second[0];
+            const auto isOrphan = record.second[1] == '1';
+            auto path = record.second.substr(2u);
+            if (isOrphan) {
+                (side == SIDE_LEFT ? orphans_left : orphans_right).push_back(path);
+            }
+            (side == SIDE_LEFT ? renamed.left : renamed.right).push_back(std::move(path));
+        }
+        report();
+        _peak_compare = _entries.memory() + rhs._entries.memory() + hashes.peak();
+    }
+
+}
@@ -0,0 +1,166 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#ifndef _SRC_CCollectionSpill_hpp__
+#define _SRC_CCollectionSpill_hpp__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <iosfwd>
+#include <functional>
+
+#include <boost/filesystem.hpp>
+
+#include "CompareFolders.hpp"
+#include "CCollectionInfo.hpp"
+#include "CSorterExternal.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace  cf {
+
+    /// @brief Collection of files' info whose memory footprint is bounded
+    /// @details The entries are sorted by an external sorter: beyond the budget, they are written to temporary files.
+    ///          Each path shall be added only once. The operations are **not** thread safe.
+    class CCollectionSpill
+    {
+    public:
+        /// @brief Entry of the collection
+        struct entry_t {
+            std::string path;
+            CCollectionInfo::info_t info;   ///< Info of the file, if it could be read
+            std::string error;              ///< Why the file could not be read. Empty on success.
+        };
+
+        /// @brief Reads the entries in the order of their paths
+        class CReader
+        {
+        public:
+            /// @brief Reads the next entry. Returns false once all the entries were read.
+            /// @details May throw **ExceptionFatal** if a temporary file cannot be read
+            bool next(entry_t& entry);
+
+        private:
+            friend class CCollectionSpill;
+            explicit CReader(CSorterExternal::CReader&& reader) :
+                _reader{ std::move(reader) }
+            {   }
+
+            CSorterExternal::CReader _reader;
+            CSorterExternal::record_t _record;
+        };
+
+        /// @param root     Root folder containing the files, UTF-8 encoded
+        /// @param algo     Algorithm used to collect the info
+        /// @param budget   Memory the entries can use, in bytes. Unbounded if 0.
+        /// @param dir_temp Directory receiving the temporary files
+        CCollectionSpill(const std::string& root, const cf::eCollectingAlgorithm algo, const std::size_t budget, const fs::path& dir_temp);
+        ~CCollectionSpill() = default;
+        CCollectionSpill(const CCollectionSpill&) = delete;
+        void operator=(const CCollectionSpill&) = delete;
+
+        /// @brief Returns the hash algorithm
+        inline cf::eCollectingAlgorithm hasher() const {
+            return _algo;
+        }
+
+        /// @brief Returns the root folder, UTF-8 encoded
+        inline const std::string& root() const {
+            return _root;
+        }
+
+        /// @brief Are the *fast* hashes made of the modification times in whole seconds, as in the former snapshots?
+        inline bool secondsOnly() const {
+            return _seconds_only;
+        }
+
+        /// @brief Records that the *fast* hashes are made of the modification times in whole seconds
+        inline void setSecondsOnly() {
+            _seconds_only = true;
+        }
+
+        /// @brief Returns the time when the scan started, in nanoseconds since the epoch. 0 if unknown.
+        inline std::int64_t timeScan() const {
+            return _time_scan_ns;
+        }
+
+        /// @brief Records the time when the scan started, in nanoseconds since the epoch
+        inline void setTimeScan(const std::int64_t time_ns) {
+            _time_scan_ns = time_ns;
+        }
+
+        /// @brief Returns the number of entries
+        inline std::size_t size() const {
+            return _entries.size();
+        }
+
+        /// @brief Returns the number of runs written to disk
+        inline std::size_t runs() const {
+            return _entries.runs();
+        }
+
+        /// @brief Adds the info of a file
+        /// @details May throw **ExceptionFatal** if a run cannot be written
+        void setInfo(const std::string& path, const CCollectionInfo::info_t& info);
+
+        /// @brief Adds a file that could not be read
+        /// @details May throw **ExceptionFatal** if a run cannot be written
+        void setError(const std::string& path, const std::string& error);
+
+        /// @brief Returns a reader of the entries, sorted by path
+        /// @details No entry shall be added while reading. May throw **ExceptionFatal**
+        CReader read();
+
+        /// @brief Visits all the entries in the order of their paths
+        /// @details May throw **ExceptionFatal** if a run cannot be read
+        void visit(const std::function<void(const entry_t&)>& visitor);
+
+        /// @brief Writes the collection as CCollectionInfo::json() would
+        /// @details May throw **ExceptionFatal** or **Exception**
+        void json(std::ostream& stream, const bool digests = false);
+
+        /// @brief Compares with another collection, as CCollectionInfo::compare() would
+        /// @details The paths of both collections are merge-joined. Then the files missing from a side
+        ///          are looked for by hash: all the files are sorted again by hash, then merge-joined.
+        ///          The sort by hash shares the budgets of both collections with their entries held in memory.
+        ///          If one side is secondsOnly(), the fractions of second are ignored on the other side too.
+        ///          May throw **ExceptionFatal**
+        void compare(CCollectionSpill& rhs, IDiffListener& listener);
+
+        /// @brief Returns the peak estimated memory used by the entries of both collections and the sort by hash
+        ///        during the last compare(), in bytes
+        inline std::size_t peakCompare() const {
+            return _peak_compare;
+        }
+
+    private:
+        const std::string _root;
+        const cf::eCollectingAlgorithm _algo;
+        bool _seconds_only;                     ///< Are the fast hashes made of whole seconds?
+        std::int64_t _time_scan_ns;             ///< Time when the scan started. 0 if unknown.
+        const std::size_t _budget;              ///< Maximum memory used by the entries
+        const fs::path _dir_temp;               ///< Directory receiving the temporary files
+        CSorterExternal _entries;               ///< Entries sorted by path
+        std::size_t _peak_compare;              ///< Peak memory used by the last comparison
+    };
+
+}
+
+
+#endif /* _SRC_CCollectionSpill_hpp__ */
@@ -21,47 +21,139 @@
 #include <vector>
 #include <iostream>
 #include <sstream>
+#include <iomanip>
 #include <future>
+#include <atomic>
+#include <mutex>
+#include <functional>
 
 #include <boost/filesystem.hpp>
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
-#include <cryptopp/sha.h>
-#include <cryptopp/hex.h>
-#include <cryptopp/files.h>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/version.hpp>
 
 #include "CompareFolders.hpp"
 #include "CCollectionInfo.hpp"
+#include "CParserJson.hpp"
+#include "CHashCache.hpp"
+#include "CHardLinks.hpp"
+#include "CHasher.hpp"
+#include "CHasherMulti.hpp"
+#include "CTrace.hpp"
+#include "TQueueBounded.hpp"
+#include "Utilities.hpp"
 
 #include "CFactoryInfo.hpp"
 
 
 
 using namespace std;
-namespace pt = boost::property_tree;
 
 namespace cf {
 
+    /// @brief Size of the blocks read from the sampled files
+    static constexpr size_t SIZE_SAMPLE = 64u * 1024u;
 
 
     ///////////////////////
 
-    const std::list<fs::path> AFactoryInfo::listFiles(const fs::path& dir) const
+    /// @details The type of an entry is usually told by the directory itself. Otherwise, as for a symbolic link,
+    ///          the status read to know it is passed along with the path: it is not read again.
+    void AFactoryInfo::listFiles(const fs::path& dir, const function<bool(listed_t&&)>& visitor) const
     {
-        // Collect the files list
-        std::list<fs::path> paths;
+        auto& counters = _progress.counters(0u);
+        CStats::CTimer timer{ _stats, ePhase::ENUMERATING };
+        CTrace::CSpan span{ "walk" };
+        const auto length_root = dir.native().size();
+        const auto relative = [length_root](const fs::path& path) {
+            auto path_relative = RelativeUtf8(path, length_root);
+#ifdef _WIN32
+            replace(path_relative.begin(), path_relative.end(), '\\', '/');
+#endif
+            return path_relative;
+        };
         try
         {
-            for (const auto& entry : fs::recursive_directory_iterator(dir)) {
-                if (fs::is_regular_file(entry.path())) {
-                    paths.push_back(entry.path());
+            for (fs::recursive_directory_iterator it{ dir }, end; it != end; ++it) {
+                checkCancelled();
+                const auto& entry = *it;
+                _stats.addOperations(1u); // the entry: its type is known without a status, but for the symbolic links
+                const auto status = entry.symlink_status();
+                listed_t listed{ entry.path(), false, status_t{} };
+                if (fs::is_symlink(status)) { // Followed: the status of its target is read once and for all
+                    try {
+                        listed.status = readStatus(entry.path());
+                    }
+                    catch (const fs::filesystem_error&) { // Dangling
+                        continue;
+                    }
+                    if (!listed.status.stat.regular) {
+                        continue;
+                    }
+                    listed.hasStatus = true;
+                }
+                if (fs::is_directory(status)) {
+                    if (!_filter.empty() && _filter.isExcluded(relative(entry.path()), true)) {
+#if BOOST_VERSION >= 107200
+                        it.disable_recursion_pending();
+#else
+                        it.no_push();
+#endif
+                    }
+                }
+                else if (listed.hasStatus || fs::is_regular_file(status)) {
+                    if (!_filter.empty()) {
+                        const auto path_relative = relative(entry.path());
+                        if (_filter.isExcluded(path_relative, false) || !_filter.isIncluded(path_relative)) {
+                            continue;
+                        }
+                    }
+                    counters.files_enumerated.fetch_add(1u, memory_order_relaxed);
+                    timer.stop(); // the visitor is not part of the listing
+                    span.stop();
+                    if (!visitor(std::move(listed))) {
+                        return;
+                    }
+                    timer.start();
+                    span.start();
                 }
             }
         }
         catch (const fs::filesystem_error& e) {
             throw(ExceptionFatal{ e.what() });
         }
-        return paths;
+    }
+
+    void AFactoryInfo::checkCancelled() const
+    {
+        if (_options.cancel && _options.cancel->cancelled()) {
+            throw ExceptionCancelled{ "The operation was cancelled." };
+        }
+        if (chrono::steady_clock::now() >= _options.deadline) {
+            throw ExceptionCancelled{ "The deadline of the operation was exceeded." };
+        }
+    }
+
+
+    /// @details A single system call where available. Otherwise, or if it failed, boost reads the status:
+    ///          only the size and the modification time in seconds are known, and a failure is reported as usual.
+    AFactoryInfo::status_t AFactoryInfo::readStatus(const fs::path& path) const
+    {
+        status_t status;
+        _stats.addOperations(1u);
+        status.identified = CHashCache::ReadStat(path, status.stat);
+        if (!status.identified) {
+            status.stat = CHashCache::stat_t{ 0u, 0u, 0u, 0, 0, 1u, true };
+            status.stat.time_modified_ns = static_cast<int64_t>(fs::last_write_time(path)) * 1000000000;
+            status.stat.size = static_cast<uint64_t>(fs::file_size(path)); // throws if not a regular file
+            _stats.addOperations(2u);
+        }
+        return status;
+    }
+
+
+    AFactoryInfo::status_t AFactoryInfo::statusOf(const listed_t& listed) const
+    {
+        return listed.hasStatus ? listed.status : readStatus(listed.path);
     }
 
 
@@ -69,44 +161,28 @@ namespace cf {
     
     ///////////////////////
 
-    CCollectionInfo AFactoryInfo::ReadInfo(const fs::path& json_path)
+    CCollectionInfo AFactoryInfo::ReadInfo(const fs::path& json_path, const unsigned nbThreads)
     {
-        // Prepare the wide string stream
-        if (!fs::is_regular_file(json_path)) {
-            throw ExceptionFatal{ json_path.string() + " is not a file." };
-        }
-        wifstream streamFile{ json_path.string(), ios_base::in };
-        streamFile.imbue(locale(locale{}, new codecvt_utf8<wchar_t>));
-        wstringstream streamStr;
-        streamStr << streamFile.rdbuf();
-        try
-        {
-            // Populates the PTree from the stream
-            wstring_convert<codecvt_utf8_utf16<wchar_t>> codec_utf8;
-            pt::wptree root;
-            pt::read_json(streamStr, root);
-            const auto generator = root.get<wstring>(JSON_KEYS.GENERATOR);
-            if (generator != JSON_CONST_VALUES.GENERATOR) {
-                throw ExceptionFatal{ "This is not a proper file." };
-            }
-            const auto algo_hash = root.get<wstring>(JSON_KEYS.ALGO_HASH);
-            CCollectionInfo collection{ fs::path{ root.get<wstring>(JSON_KEYS.ROOT) },
-                                        algo_hash == JSON_CONST_VALUES.ALGO_HASH_FAST ? eCollectingAlgorithm::FAST  : eCollectingAlgorithm::SECURE };
-
-            for (const auto& file : root.get_child(JSON_KEYS.CONTENT.FILES)) {
-                const auto hash = file.second.get_child(JSON_KEYS.CONTENT.HASH).data();
-                const time_t time = std::stoll(file.second.get_child(JSON_KEYS.CONTENT.TIME).data());
-                const auto size = std::stoull(file.second.get_child(JSON_KEYS.CONTENT.SIZE).data());
-                collection.setInfo(fs::path{ file.first }, { codec_utf8.to_bytes(hash) , time, size });
-            }
-            
-            return collection;
+        const CParserJson parser{ json_path };
+        return parser.parse(nbThreads);
+    }
+
+
+
+    /// @details Each delta records the digests of the roots before and after its changes:
+    ///          a broken chain is detected without computing any digest but the first one.
+    CCollectionInfo AFactoryInfo::ReadInfo(const fs::path& json_path, const list<fs::path>& deltas, const unsigned nbThreads)
+    {
+        auto collection = make_unique<CCollectionInfo>(ReadInfo(json_path, nbThreads));
+        if (deltas.empty()) {
+            return std::move(*collection);
         }
-        catch (const pt::ptree_error& e)
-        {
-            throw ExceptionFatal{ "An error occured while parsing " + json_path.string() + " : " + e.what() };
+        auto digest = collection->digests().at(string{});
+        for (const auto& delta : deltas) {
+            const CParserJson parser{ delta };
+            collection = make_unique<CCollectionInfo>(parser.applyDelta(std::move(*collection), digest));
         }
-
+        return std::move(*collection);
     }
 
 
@@ -118,93 +194,480 @@ namespace cf {
     /// @detailed   All hashes are computed using a cryptographic hasher. 
     ///             Collecting info can take some time. Thus, an external error logger must be provided
     ///             to give the opportunity to report the errors in real time.
-    CCollectionInfo CFactoryInfoSecure::collectInfo(const fs::path& root)
+    CCollectionInfo CFactoryInfoSecure::collectInfo(const fs::path& root, const CCollectionInfo* baseline)
+    {
+        const auto str_root = ToUtf8(root);
+        if (baseline != nullptr && baseline->hasher() != eCollectingAlgorithm::SECURE) {
+            throw ExceptionFatal{ "The baseline of " + str_root + " was not built with the secure algorithm." };
+        }
+        CCollectionInfo info{ str_root, eCollectingAlgorithm::SECURE };
+        collect(root, baseline, info);
+        return info;
+    }
+
+
+    void CFactoryInfoSecure::collectInfo(const fs::path& root, CCollectionSpill& collection)
     {
-        // split work for tasks
-        const auto paths_files = listFiles(root);
-        const auto works = splitPaths(paths_files, _nbThreads);
-        
+        if (collection.hasher() != eCollectingAlgorithm::SECURE) {
+            throw ExceptionFatal{ "The collection of " + collection.root() + " does not use the secure algorithm." };
+        }
+        collect(root, nullptr, collection);
+    }
 
-        const auto str_root = toString(root.c_str());
+
+    /// @details    The calling thread lists the files while the workers hash them: the paths go through a bounded queue.
+    ///             When the workers lag behind, the listing waits for them. Thus, the memory used does not depend
+    ///             on the number of files, but on the collection receiving the results.
+    ///             The workers add their results to the collection by batches, holding a lock.
+    ///             The hashes of the files left unchanged since the baseline are carried forward, unless sampled differently.
+    ///             A file modified shortly before the baseline's scan may have been rewritten since with the same
+    ///             size and timestamp: it is hashed again, as it is when the baseline does not tell its scan time.
+    ///             Otherwise, if a cache is provided in the options, the hashes of the unchanged files are read from it.
+    ///             A file that cannot be read is recorded as an error in the collection and the scan goes on.
+    ///             The workers stop as soon as one of them fails or the operation is cancelled,
+    ///             and are all joined before returning.
+    template<typename TCollection>
+    void CFactoryInfoSecure::collect(const fs::path& root, const CCollectionInfo* baseline, TCollection& collection)
+    {
+        constexpr size_t SIZE_BATCH = 256u;     // results added to the collection at once
+        constexpr size_t SIZE_PATH = 256u;      // estimated memory used by a queued path
+        constexpr size_t SIZE_QUEUE = 4096u;    // maximum number of queued paths
+        const auto str_root = ToUtf8(root);
+        collection.setTimeScan(CHashCache::TimeNow());
         _logger.message("Collecting info (secure algorithm) from: " + str_root + '\n');
-        _logger.message(to_string(paths_files.size()) + " files to process. This may take some time\n");
+        _logger.message("Files are hashed as they are listed. This may take some time\n");
+        const CHasher hasher;
+        const auto tag_sampled = tagSampled();
+        const auto time_baseline = (baseline != nullptr) ? baseline->timeScan() : 0; // 0 if unknown: nothing is carried forward
+        const auto multi = _options.size_multi_buffer != 0u && multiBuffer(hasher.provider());
+        const size_t size_smalls = 4u * CHasherMulti::Lanes();   // small files hashed at once
+        _logger.message("Hashing with " + hasher.name() + " (" + hasher.provider() + ")"
+            + (multi ? ", the small files by " + CHasherMulti::Provider() + " multi-buffer\n" : "\n"));
+        if (_options.size_sampling != 0u) {
+            _logger.message("Files larger than " + to_string(_options.size_sampling) + " bytes are sampled: "
+                + to_string(static_cast<uint64_t>(_options.nb_samples) + 2u) + " blocks of " + to_string(SIZE_SAMPLE) + " bytes\n");
+        }
+
+        if (!_options.path_cache.empty() && !_cache) { // The sampled hashes shall not be mistaken for full ones
+            const auto algo = (_options.size_sampling == 0u) ? JSON_CONST_VALUES.ALGO_HASH_SECURE :
+                JSON_CONST_VALUES.ALGO_HASH_SECURE + '/' + tagSampled();
+            _cache = make_unique<CHashCache>(ToPath(_options.path_cache), algo);
+        }
+        CHashCache* const cache = _cache.get();
+        const auto hits_previous = cache ? cache->hits() : 0u;   // the cache may serve several folders
+        CHardLinks links; // the links to the same inode are read once
+
+        // The queued paths use at most a sixteenth of the memory budget
+        const auto capacity = (_options.memory_budget == 0u) ? SIZE_QUEUE :
+            min(SIZE_QUEUE, max<size_t>(64u, _options.memory_budget / 16u / SIZE_PATH));
+        TQueueBounded<listed_t> queue{ capacity };
             
         // construct the tasks and launch threaded workers
         typedef struct resultWork_t {
-            fs::path path_relative;
+            string path_relative;
             CCollectionInfo::info_t info;
+            string error;   ///< Why the file could not be read. Empty on success.
         } resultWork_t; ///< structure containing a file's info collected
-
+        typedef struct small_t {
+            resultWork_t result;
+            CHashCache::stat_t stat;
+            bool identified;
+            string content;
+        } small_t; ///< small file waiting to be hashed with others
+
+        const auto length_root = root.native().size();
+        mutex mutex_collection;         // protects the collection
+        atomic<size_t> nb_files{ 0u };  // files processed
+        atomic<size_t> nb_errors{ 0u }; // files that could not be read
+        atomic<size_t> nb_carried{ 0u }; // hashes carried forward from the baseline
+        atomic_bool aborted{ false };   // a worker failed: the others shall stop
         vector<thread> workers;
-        vector<future<list<resultWork_t>>> future_results;
-        for(const auto& paths : works)
+        vector<future<void>> future_results;
+        const auto stop_workers = [&queue, &aborted, &workers] {
+            aborted.store(true, memory_order_relaxed);
+            queue.close();
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        };
+
+        for(auto slot = 0u; slot < _nbThreads; ++slot)
         {
-            packaged_task<list<resultWork_t>(const fs::path&, const list<fs::path>&)> task{
-                [this] (const fs::path& root, const list<fs::path>& paths)
+            auto& counters = _progress.counters(slot); // each worker has its own counters
+            packaged_task<void()> task{
+                [this, slot, cache, &links, baseline, time_baseline, &tag_sampled, multi, size_smalls, &queue, &collection, &mutex_collection, length_root, &nb_files, &nb_errors, &nb_carried, &aborted, &counters]
                 {
-                    list<resultWork_t> results;
-                    for(const auto& path : paths)
-                    {
-                        constexpr bool isUpperCase = true;
-                        string hash;
-                        CryptoPP::SHA1 hasher;
-                        CryptoPP::FileSource(path.c_str(), true,
-                            new CryptoPP::HashFilter(hasher, new CryptoPP::HexEncoder(new CryptoPP::StringSink(hash), isUpperCase))
-                        );
-                        this->_logger.message(".");
-                        results.emplace_back<resultWork_t>( {
-                            fs::relative(path, root),
-                            { hash, fs::last_write_time(path), fs::file_size(path) }
-                        });
+                    vector<resultWork_t> results;
+                    results.reserve(SIZE_BATCH);
+                    vector<small_t> smalls;
+                    smalls.reserve(size_smalls);
+                    const auto hash_smalls = [this, &smalls, &results, cache, &counters] {
+                        if (smalls.empty()) {
+                            return;
+                        }
+                        vector<string> contents;
+                        contents.reserve(smalls.size());
+                        for (auto& small : smalls) {
+                            contents.push_back(std::move(small.content));
+                        }
+                        CStats::CTimer hashing{ _stats, ePhase::HASHING };
+                        CTrace::CSpan span_hash{ "hash" };
+                        const auto digests = CHasherMulti::Digests(contents);
+                        hashing.stop();
+                        span_hash.stop();
+                        for (auto i = 0u; i < smalls.size(); ++i) {
+                            auto& small = smalls[i];
+                            if (small.identified && cache) {
+                                cache->add(small.stat, digests[i]);
+                            }
+                            counters.bytes_hashed.fetch_add(small.result.info.size, memory_order_relaxed);
+                            small.result.info.hash = digests[i];
+                            results.push_back(std::move(small.result));
+                        }
+                        smalls.clear();
+                    };
+                    const auto flush = [&results, &collection, &mutex_collection] {
+                        const lock_guard<mutex> lock{ mutex_collection };
+                        for (const auto& result : results) {
+                            if (result.error.empty()) {
+                                collection.setInfo(result.path_relative, result.info);
+                            }
+                            else {
+                                collection.setError(result.path_relative, result.error);
+                            }
+                        }
+                        results.clear();
+                    };
+
+                    if (CTrace::Recording()) {
+                        CTrace::NameThread("hasher " + to_string(slot));
+                    }
+                    try {
+                        listed_t listed;
+                        CTrace::CSpan waiting{ "queue pop" };
+                        while (queue.pop(listed))
+                        {
+                            const auto& path = listed.path;
+                            waiting.stop();
+                            if (aborted.load(memory_order_relaxed)) {
+                                return;
+                            }
+                            checkCancelled();
+                            auto path_relative = RelativeUtf8(path, length_root);
+                            try {
+                                CStats::CTimer statting{ _stats, ePhase::STATTING };
+                                CTrace::CSpan span_stat{ "stat" };
+                                const auto status = statusOf(listed);
+                                statting.stop();
+                                span_stat.stop();
+                                const auto time_modified = status.stat.time_modified_ns;
+                                const auto size = status.stat.size;
+
+                                // Unchanged since the baseline, modified well before its scan, and sampled the same way?
+                                const auto info_previous = (baseline != nullptr) ? baseline->find(path_relative) : nullptr;
+                                if (info_previous != nullptr && info_previous->size == size && info_previous->time_modified_ns == time_modified
+                                    && time_modified + CHashCache::MARGIN_NS < time_baseline
+                                    && CCollectionInfo::HashSampling(info_previous->hash) == (sampled(size) ? tag_sampled : string{})) {
+                                    results.push_back(resultWork_t{ std::move(path_relative), *info_previous, string{} });
+                                    ++nb_carried;
+                                    if (status.identified && cache) { // Its entry is still valid
+                                        cache->touch(status.stat);
+                                    }
+                                }
+                                else {
+                                    const auto& stat = status.stat;
+                                    const auto hasStat = status.identified;
+                                    string hash;
+                                    if (hasStat && cache && cache->find(stat, hash)) {
+                                        results.push_back(resultWork_t{ std::move(path_relative), { hash, time_modified, size }, string{} });
+                                    }
+                                    else if (multi && size <= _options.size_multi_buffer && !sampled(size) && !(hasStat && stat.links > 1u)) {
+                                        auto content = read(path, size);
+                                        smalls.emplace_back();
+                                        auto& small = smalls.back();
+                                        small.result.path_relative = std::move(path_relative);
+                                        small.result.info.time_modified_ns = time_modified;
+                                        small.result.info.size = size;
+                                        small.stat = stat;
+                                        small.identified = hasStat;
+                                        small.content = std::move(content);
+                                        if (smalls.size() >= size_smalls) {
+                                            hash_smalls();
+                                        }
+                                    }
+                                    else
+                                    {
+                                        const auto hasher = [this, &path, &counters, size] {
+                                            auto hash = this->hash(path, size);
+                                            counters.bytes_hashed.fetch_add(sizeRead(size), memory_order_relaxed);
+                                            return hash;
+                                        };
+                                        hash = (hasStat && stat.links > 1u) ? links.hash(stat, hasher) : hasher();
+                                        if (hasStat && cache) {
+                                            cache->add(stat, hash);
+                                        }
+                                        results.push_back(resultWork_t{ std::move(path_relative), { hash, time_modified, size }, string{} });
+                                    }
+                                }
+                            }
+                            catch (const ExceptionCancelled&) {
+                                throw;
+                            }
+                            catch (const exception& e) { // The file is recorded as unreadable
+                                this->_logger.error(e.what());
+                                ++nb_errors;
+                                CCollectionInfo::info_t info_none{ string{}, 0, 0u };
+                                results.push_back(resultWork_t{ std::move(path_relative), std::move(info_none), e.what() });
+                            }
+                            ++nb_files;
+                            counters.files_hashed.fetch_add(1u, memory_order_relaxed);
+                            _stats.addFiles(1u);
+                            if (results.size() >= SIZE_BATCH) {
+                                flush();
+                            }
+                            waiting.start();
+                        }
+                        hash_smalls();
+                        flush();
+                    }
+                    catch (...) {
+                        aborted.store(true, memory_order_relaxed);
+                        queue.close(); // the listing shall not wait for the workers anymore
+                        throw;
                     }
-                    return results;
                 } // lambda
             }; // packaged_task
 
             future_results.emplace_back(task.get_future()); // storing the future for the result
-            workers.emplace_back(std::move(task), root, paths); // creating (and starting) the thread with the task
+            try {
+                workers.emplace_back(std::move(task)); // creating (and starting) the thread with the task
+            }
+            catch (...) {
+                stop_workers();
+                throw;
+            }
         }
 
-        // Detaching the threads avoids terminate() in case of an exception
+        // Feeding the workers. No worker keeps reading the disks once the function returned, even in case of an exception
+        try {
+            listFiles(root, [&queue](listed_t&& listed) {
+                const CTrace::CSpan span{ "queue push" };
+                return queue.push(std::move(listed)); // false if a worker failed
+            });
+        }
+        catch (...) {
+            stop_workers();
+            throw;
+        }
+        queue.close();
         for( auto& worker : workers ) {
-            worker.detach();
+            worker.join();
         }
-
-        // Collect the result
-        CCollectionInfo info{ root, eCollectingAlgorithm::SECURE };
         for(auto& future_result : future_results) {
-            // TODO try catch
-            auto results = future_result.get();
-            for(const auto& result : results) {
-                info.setInfo(result.path_relative, result.info);
+            future_result.get(); // throws the exception of a failed worker
+        }
+
+        _logger.message(to_string(nb_files) + " files processed\n");
+        const auto hits = cache ? cache->hits() - hits_previous : 0u;
+        _stats.addCacheHits(nb_carried + hits);
+        if (baseline != nullptr) {
+            _logger.message(to_string(nb_carried) + " hashes carried forward from the baseline\n");
+        }
+        if (cache) {
+            _logger.message(to_string(hits) + " hashes read from the cache\n");
+        }
+
+        if (links.shared() != 0u) {
+            _logger.message(to_string(links.shared()) + " hard links not read again\n");
+        }
+        if (nb_errors != 0u) {
+            _logger.message(to_string(nb_errors) + " files could not be read\n");
+        }
+        _logger.message("Done collecting info from: " + str_root + '\n');
+    }
+
+    /// @details SHA-NI and the ARMv8 extensions outrun the AVX2 lanes.
+    bool CFactoryInfoSecure::multiBuffer(const string& provider) const
+    {
+        return CHasherMulti::Lanes() > 1u && provider != "SHANI" && provider != "ARMv8";
+    }
+
+
+    /// @details The cache is saved once all the folders of the operation are collected:
+    ///          the entries of none of them are dropped.
+    CFactoryInfoSecure::~CFactoryInfoSecure()
+    {
+        if (_cache) {
+            try {
+                _cache->save();
+            }
+            catch (const Exception& e) {
+                _logger.error(e.what());
             }
         }
+    }
 
-        _logger.message("\nDone collecting info from: " + str_root + '\n');
 
+    CCollectionInfo::info_t CFactoryInfoSecure::collectFile(const fs::path& path) const
+    {
+        CStats::CTimer statting{ _stats, ePhase::STATTING };
+        const auto status = readStatus(path);
+        statting.stop();
+        const auto size = status.stat.size;
+        auto info = CCollectionInfo::info_t{ hash(path, size), status.stat.time_modified_ns, size };
+        _stats.addFiles(1u);
+        auto& counters = _progress.counters(0u);
+        counters.files_hashed.fetch_add(1u, memory_order_relaxed);
+        counters.bytes_hashed.fetch_add(sizeRead(size), memory_order_relaxed);
         return info;
     }
 
 
-     vector<list<fs::path>> CFactoryInfoSecure::splitPaths(const list<fs::path>& paths, const unsigned nb_slices) const
-     {
-        vector<list<fs::path>> splitted;
-        for(auto i = 0u; i < nb_slices; ++i) {
-            splitted.push_back(list<fs::path>{});
+    /// @details The file is read by chunks, checking for a cancellation between each of them.
+    string CFactoryInfoSecure::hash(const fs::path& path, const uintmax_t size) const
+    {
+        constexpr size_t SIZE_CHUNK = 256u * 1024u;
+        if (sampled(size)) {
+            return sample(path, size);
+        }
+        CStats::CTimer reading{ _stats, ePhase::READING };
+        CTrace::CSpan span_open{ "open" };
+        fs::ifstream stream{ path, ios_base::in | ios_base::binary };
+        span_open.stop();
+        _stats.addOperations(2u); // opened, then closed
+        if (!stream) {
+            throw Exception{ "Cannot read " + ToUtf8(path) };
+        }
+
+        CHasher hasher;
+        unique_ptr<char[]> buffer{ new char[SIZE_CHUNK] };
+        CTrace::CSpan span_read{ "read" };
+        while (stream.read(buffer.get(), SIZE_CHUNK) || stream.gcount() > 0) {
+            reading.stop();
+            span_read.stop();
+            _stats.addOperations(1u);
+            _stats.addBytes(static_cast<uint64_t>(stream.gcount()));
+            {
+                CStats::CTimer hashing{ _stats, ePhase::HASHING };
+                const CTrace::CSpan span_hash{ "hash" };
+                hasher.update(buffer.get(), static_cast<size_t>(stream.gcount()));
+            }
+            checkCancelled();
+            reading.start();
+            span_read.start();
         }
+        _stats.addOperations(1u); // the end of the file
+        reading.stop();
+        span_read.stop();
+        if (stream.bad()) {
+            throw Exception{ "Cannot read " + ToUtf8(path) };
+        }
+        CStats::CTimer hashing{ _stats, ePhase::HASHING };
+        const CTrace::CSpan span_hash{ "hash" };
+        return hasher.digest();
+    }
 
-        auto slice = begin(splitted);
-        for(const auto& path : paths)
+
+    /// @details The size, on 8 bytes little endian, is hashed first: a file growing or shrinking always changes its hash.
+    ///          Then come the first block, nb_samples blocks evenly spaced and the last block.
+    ///          The I/O is bounded whatever the size of the file.
+    string CFactoryInfoSecure::sample(const fs::path& path, const uintmax_t size) const
+    {
+        CStats::CTimer reading{ _stats, ePhase::READING };
+        CTrace::CSpan span_open{ "open" };
+        fs::ifstream stream{ path, ios_base::in | ios_base::binary };
+        span_open.stop();
+        _stats.addOperations(2u); // opened, then closed
+        if (!stream) {
+            throw Exception{ "Cannot read " + ToUtf8(path) };
+        }
+
+        CHasher hasher;
+        unsigned char size_le[8];
+        for (auto i = 0u; i < sizeof(size_le); ++i) {
+            size_le[i] = static_cast<unsigned char>(static_cast<uint64_t>(size) >> (8u * i));
+        }
+        hasher.update(size_le, sizeof(size_le));
+
+        unique_ptr<char[]> buffer{ new char[SIZE_SAMPLE] };
+        const uint64_t intervals = static_cast<uint64_t>(_options.nb_samples) + 1u;
+        const uint64_t span = size - SIZE_SAMPLE; // offset of the last block
+        CTrace::CSpan span_read{ "read" };
+        for (uint64_t i = 0u; i <= intervals; ++i)
         {
-            slice->push_back(path);
-            ++slice;
-            if(slice == end(splitted)) {
-                slice = begin(splitted);
+            // span * i / intervals, without overflowing
+            const auto offset = (span / intervals) * i + (span % intervals) * i / intervals;
+            stream.seekg(static_cast<streamoff>(offset));
+            stream.read(buffer.get(), SIZE_SAMPLE);
+            _stats.addOperations(2u); // seeked, then read
+            if (stream.gcount() != static_cast<streamsize>(SIZE_SAMPLE)) { // Truncated since its status was read
+                throw Exception{ "Cannot read " + ToUtf8(path) };
+            }
+            _stats.addBytes(SIZE_SAMPLE);
+            reading.stop();
+            span_read.stop();
+            {
+                CStats::CTimer hashing{ _stats, ePhase::HASHING };
+                const CTrace::CSpan span_hash{ "hash" };
+                hasher.update(buffer.get(), SIZE_SAMPLE);
             }
+            checkCancelled();
+            reading.start();
+            span_read.start();
+        }
+        reading.stop();
+        span_read.stop();
+        CStats::CTimer hashing{ _stats, ePhase::HASHING };
+        const CTrace::CSpan span_hash{ "hash" };
+        return tagSampled() + hasher.digest();
+    }
+
+
+    /// @details The parameters tell apart the snapshots that cannot be compared.
+    string CFactoryInfoSecure::tagSampled() const
+    {
+        return JSON_CONST_VALUES.HASH_SAMPLED + to_string(_options.size_sampling) + 'x' + to_string(_options.nb_samples) + ':';
+    }
+
+
+    /// @details Sampling a file not larger than the samples would not spare anything.
+    bool CFactoryInfoSecure::sampled(const uintmax_t size) const
+    {
+        return _options.size_sampling != 0u && size > _options.size_sampling
+            && size > (static_cast<uintmax_t>(_options.nb_samples) + 2u) * SIZE_SAMPLE;
+    }
+
+
+    uintmax_t CFactoryInfoSecure::sizeRead(const uintmax_t size) const
+    {
+        return sampled(size) ? (static_cast<uintmax_t>(_options.nb_samples) + 2u) * SIZE_SAMPLE : size;
+    }
+
+
+    /// @details A file modified since its status was read is read whole, as when hashed by chunks.
+    string CFactoryInfoSecure::read(const fs::path& path, const uintmax_t size) const
+    {
+        CStats::CTimer reading{ _stats, ePhase::READING };
+        CTrace::CSpan span_open{ "open" };
+        fs::ifstream stream{ path, ios_base::in | ios_base::binary };
+        span_open.stop();
+        const CTrace::CSpan span_read{ "read" };
+        _stats.addOperations(4u); // opened, read, end of file, then closed
+        if (!stream) {
+            throw Exception{ "Cannot read " + ToUtf8(path) };
+        }
+        string content(static_cast<size_t>(size), '\0');
+        stream.read(&content[0], static_cast<streamsize>(content.size()));
+        content.resize(static_cast<size_t>(stream.gcount()));
+        if (stream && stream.peek() != char_traits<char>::eof()) {
+            content.append(istreambuf_iterator<char>{ stream }, istreambuf_iterator<char>{});
+        }
+        if (stream.bad()) {
+            throw Exception{ "Cannot read " + ToUtf8(path) };
         }
-         
-        return splitted;
-     }
+        _stats.addBytes(content.size());
+        return content;
+    }
 
 
     /// @detailed   All *pseudo-hashes* are computed by combining the size of the file and its last modification time. 
@@ -212,45 +675,218 @@ namespace cf {
     ///             Thus, the time consuming *secure* hash is only computed for those duplicates.
     ///             Collecting info can take some time. Thus, an external error logger must be provided
     ///             to give the opportunity to report the errors in real time.
-    CCollectionInfo CFactoryInfoFast::collectInfo(const fs::path& root)
+    ///             As the *pseudo-hashes* only depend on the files' status, a baseline brings nothing and is ignored.
+    CCollectionInfo CFactoryInfoFast::collectInfo(const fs::path& root, const CCollectionInfo*)
+    {
+        CCollectionInfo collection_info{ ToUtf8(root), eCollectingAlgorithm::FAST };
+        collect(root, collection_info);
+        return collection_info;
+    }
+
+
+    void CFactoryInfoFast::collectInfo(const fs::path& root, CCollectionSpill& collection)
     {
-       
-        CCollectionInfo collection_info{ root,  eCollectingAlgorithm::FAST};
-        const auto paths = listFiles(root);
+        if (collection.hasher() != eCollectingAlgorithm::FAST) {
+            throw ExceptionFatal{ "The collection of " + collection.root() + " does not use the fast algorithm." };
+        }
+        collect(root, collection);
+    }
 
-        wstring_convert<codecvt_utf8<wchar_t>, wchar_t> converter;
-        const auto str_root = toString(root.c_str());
+
+    /// @details    The calling thread lists the files while workers read their status: on a network filesystem,
+    ///             where each request is a round trip, options_t::depth_stat requests are in flight at once, up to 256.
+    ///             The paths go through a bounded queue and the workers add their results to the collection
+    ///             by batches, holding a lock. With a depth of 1, the status is read by the listing thread.
+    ///             The workers stop as soon as one of them fails, and are all joined before returning.
+    template<typename TCollection>
+    void CFactoryInfoFast::collect(const fs::path& root, TCollection& collection)
+    {
+        constexpr size_t SIZE_BATCH = 256u;     // results added to the collection at once
+        constexpr size_t SIZE_PATHS = 64u;      // paths queued at once
+        constexpr size_t SIZE_QUEUE = 64u;      // maximum number of queued batches of paths
+        constexpr unsigned MAX_DEPTH = 256u;    // each request in flight is a thread
+        const auto str_root = ToUtf8(root);
+        const auto length_root = root.native().size();
+        const auto depth = min(MAX_DEPTH, max(1u, _options.depth_stat));
+
+        collection.setTimeScan(CHashCache::TimeNow());
         _logger.message("Collecting info (fast algorithm) from: " + str_root +"\n");
-        _logger.message(to_string(paths.size()) + " files to process.\n");
 
-        for (const auto& path : paths)
-        {
+        typedef struct resultStat_t {
+            string path_relative;
+            CCollectionInfo::info_t info;
+            string error;   ///< Why the status could not be read. Empty on success.
+        } resultStat_t; ///< structure containing a file's info collected
+
+        atomic<size_t> nb_files{ 0u };
+        const auto read = [this, length_root, &nb_files](const listed_t& listed, CProgress::counters_t& counters) {
+            resultStat_t result{ RelativeUtf8(listed.path, length_root), { string{}, 0, 0u }, string{} };
             try
             {
-                const auto path_relative = fs::relative(path, root);
-                const auto time_modified = fs::last_write_time(path);
-                const auto size = fs::file_size(path);
-                const auto hash = hasherFast(time_modified, size);
-
-                collection_info.setInfo(path_relative, { hash, time_modified, size });
+                CStats::CTimer statting{ _stats, ePhase::STATTING };
+                CTrace::CSpan span_stat{ "stat" };
+                const auto status = statusOf(listed);
+                statting.stop();
+                span_stat.stop();
+                result.info = { hasherFast(status.stat.time_modified_ns, status.stat.size), status.stat.time_modified_ns, status.stat.size };
             }
             catch (const fs::filesystem_error& e) {
                 const string message = string{ "Filesystem error: " } + e.what();
                 _logger.error(message);
+                result.error = e.what();
+            }
+            ++nb_files;
+            counters.files_hashed.fetch_add(1u, memory_order_relaxed);
+            _stats.addFiles(1u);
+            return result;
+        };
+        const auto add = [&collection](const resultStat_t& result) {
+            if (result.error.empty()) {
+                collection.setInfo(result.path_relative, result.info);
             }
+            else {
+                collection.setError(result.path_relative, result.error);
+            }
+        };
+
+        if (depth == 1u) {
+            auto& counters = _progress.counters(0u);
+            listFiles(root, [&read, &add, &counters](listed_t&& listed) {
+                add(read(listed, counters));
+                return true;
+            });
         }
+        else
+        {
+            TQueueBounded<vector<listed_t>> queue{ SIZE_QUEUE };
+            mutex mutex_collection;         // protects the collection
+            atomic_bool aborted{ false };   // a worker failed: the others shall stop
+            vector<thread> workers;
+            vector<future<void>> future_results;
+            const auto stop_workers = [&queue, &aborted, &workers] {
+                aborted.store(true, memory_order_relaxed);
+                queue.close();
+                for (auto& worker : workers) {
+                    worker.join();
+                }
+            };
 
+            for (auto slot = 0u; slot < depth; ++slot)
+            {
+                auto& counters = _progress.counters(slot);
+                packaged_task<void()> task{
+                    [slot, &read, &add, &queue, &mutex_collection, &aborted, &counters]
+                    {
+                        vector<resultStat_t> results;
+                        results.reserve(SIZE_BATCH);
+                        const auto flush = [&results, &add, &mutex_collection] {
+                            const lock_guard<mutex> lock{ mutex_collection };
+                            for (const auto& result : results) {
+                                add(result);
+                            }
+                            results.clear();
+                        };
+
+                        if (CTrace::Recording()) {
+                            CTrace::NameThread("stat " + to_string(slot));
+                        }
+                        try {
+                            vector<listed_t> paths;
+                            while (queue.pop(paths))
+                            {
+                                if (aborted.load(memory_order_relaxed)) {
+                                    return;
+                                }
+                                for (const auto& listed : paths) {
+                                    results.push_back(read(listed, counters));
+                                }
+                                if (results.size() >= SIZE_BATCH) {
+                                    flush();
+                                }
+                            }
+                            flush();
+                        }
+                        catch (...) {
+                            aborted.store(true, memory_order_relaxed);
+                            queue.close(); // the listing shall not wait for the workers anymore
+                            throw;
+                        }
+                    } // lambda
+                }; // packaged_task
+
+                future_results.emplace_back(task.get_future());
+                try {
+                    workers.emplace_back(std::move(task));
+                }
+                catch (...) {
+                    stop_workers();
+                    throw;
+                }
+            }
+
+            vector<listed_t> paths;
+            paths.reserve(SIZE_PATHS);
+            try {
+                bool pushed = true;
+                listFiles(root, [&queue, &paths, &pushed](listed_t&& listed) {
+                    paths.push_back(std::move(listed));
+                    if (paths.size() >= SIZE_PATHS) {
+                        const CTrace::CSpan span{ "queue push" };
+                        pushed = queue.push(std::move(paths)); // false if a worker failed
+                        paths.clear();
+                        paths.reserve(SIZE_PATHS);
+                    }
+                    return pushed;
+                });
+                if (pushed && !paths.empty()) {
+                    queue.push(std::move(paths));
+                }
+            }
+            catch (...) {
+                stop_workers();
+                throw;
+            }
+            queue.close();
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            for (auto& future_result : future_results) {
+                future_result.get(); // throws the exception of a failed worker
+            }
+        }
+
+        _logger.message(to_string(nb_files) + " files processed.\n");
         _logger.message("Done collecting info from: " + str_root + '\n');
+    }
 
-        return collection_info;
+    CCollectionInfo::info_t CFactoryInfoFast::collectFile(const fs::path& path) const
+    {
+        CStats::CTimer statting{ _stats, ePhase::STATTING };
+        const auto status = readStatus(path);
+        _stats.addFiles(1u);
+        _progress.counters(0u).files_hashed.fetch_add(1u, memory_order_relaxed);
+        return { hasherFast(status.stat.time_modified_ns, status.stat.size), status.stat.time_modified_ns, status.stat.size };
     }
 
 
-    /// @Detailed The resulting *hash* is a concatenation of the file's **last modification time** and **size**.
-    string CFactoryInfoFast::hasherFast(const std::time_t time_modified, const std::uintmax_t size) const
+    /// @Detailed The resulting *hash* is a concatenation of the file's **last modification time** and **size**, in hexadecimal.
+    ///           The fraction of second of the modification time follows, if any: a dot then the nanoseconds in decimal,
+    ///           on 9 digits. Files rewritten within the same second differ, while the hashes of the filesystems with
+    ///           a coarser granularity are unchanged. The snapshots are tagged as such: see CCollectionInfo::secondsOnly().
+    string CFactoryInfoFast::hasherFast(const int64_t time_modified_ns, const std::uintmax_t size) const
     {
+        constexpr int64_t NS_PER_S = 1000000000;
+        auto seconds = time_modified_ns / NS_PER_S;
+        auto fraction = time_modified_ns % NS_PER_S;
+        if (fraction < 0) {
+            --seconds;
+            fraction += NS_PER_S;
+        }
         stringstream stream;
-        stream << std::uppercase << std::hex << time_modified << std::uppercase << std::hex << size;
+        stream << std::uppercase << std::hex << static_cast<time_t>(seconds) << std::uppercase << std::hex << size;
+        if (fraction != 0) {
+            stream << '.' << std::dec << std::setfill('0') << std::setw(9) << fraction;
+        }
         return stream.str();
     }
 
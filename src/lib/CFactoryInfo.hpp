@@ -18,7 +18,14 @@
 #ifndef _SRC_CFactoryInfo_hpp__
 #define _SRC_CFactoryInfo_hpp__
 
+#include "CompareFolders.hpp"
 #include "CProxyLogger.hpp"
+#include "CProgress.hpp"
+#include "CStats.hpp"
+#include "CHashCache.hpp"
+#include "CFilter.hpp"
+#include "CCollectionInfo.hpp"
+#include "CCollectionSpill.hpp"
 
 #include <boost/filesystem.hpp>
 
@@ -27,8 +34,8 @@
 #include <thread>
 #include <algorithm>
 #include <vector>
-#include <locale>
-#include <codecvt>
+#include <list>
+#include <functional>
 
 
 
@@ -37,14 +44,13 @@ namespace fs = boost::filesystem;
 
 namespace  cf {
 
-    class CCollectionInfo;
-    
     /// @brief Abstract class, root of the FactoryInfo class hierarchy
     class AFactoryInfo
     {
     public:
         virtual ~AFactoryInfo()
         {
+          _progress.stop();
           _logger.stop();
         }
         AFactoryInfo(const AFactoryInfo&) = delete;
@@ -52,31 +58,95 @@ namespace  cf {
 
         /// @brief This **static** operation builds a collection from the values stored in a JSON file
         /// @param json_path Pth to the JSON file storing the hashes
-        static CCollectionInfo ReadInfo(const fs::path& json_path);
+        /// @param nbThreads Maximum number of threads used to parse the file
+        static CCollectionInfo ReadInfo(const fs::path& json_path, const unsigned nbThreads = std::max(1u, std::thread::hardware_concurrency()));
+
+        /// @brief This **static** operation builds a collection from a JSON file and a chain of deltas
+        /// @param json_path Path to the JSON file storing the hashes
+        /// @param deltas Paths to the deltas, applied in order
+        /// @param nbThreads Maximum number of threads used to parse the file
+        static CCollectionInfo ReadInfo(const fs::path& json_path, const std::list<fs::path>& deltas, const unsigned nbThreads = std::max(1u, std::thread::hardware_concurrency()));
 
         /// @brief Builds a collection with all the directory's files' hashes
         /// @param root Root folder: all its files will be hashed
-        /// @param loggerErr Will log eventual errors
-        virtual CCollectionInfo collectInfo(const fs::path& root) = 0;
+        /// @param baseline A previous collection of the same folder, or nullptr.
+        ///        The hashes of the files whose size and modification time did not change are carried forward.
+        virtual CCollectionInfo collectInfo(const fs::path& root, const CCollectionInfo* baseline = nullptr) = 0;
 
-    protected:
-        AFactoryInfo(std::unique_ptr<ILogger> logger) :
-            _logger{ std::move(logger) }
-        {   }
+        /// @brief Adds all the directory's files' hashes to a collection bounded in memory
+        /// @param root Root folder: all its files will be hashed
+        /// @param collection Receives the info. Shall be empty and use the factory's algorithm.
+        virtual void collectInfo(const fs::path& root, CCollectionSpill& collection) = 0;
+
+        /// @brief Collects the info of a single file
+        /// @details Throws if the file cannot be read
+        virtual CCollectionInfo::info_t collectFile(const fs::path& path) const = 0;
 
-        inline std::string toString(const wchar_t* const str) const {
-            std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> converter;
-            return std::string{ converter.to_bytes(str) };
+        /// @brief Returns the logger
+        inline CProxyLogger& logger() {
+            return _logger;
         }
 
-        inline std::string toString(const char* const str) const {
-            return std::string{ str };
+        /// @brief Returns the progress of the operations using the factory
+        inline CProgress& progress() {
+            return _progress;
         }
 
-        /// @brief Lists and returns all **files** entries located inside the provided directory
-        const std::list<fs::path> listFiles(const fs::path&) const;
+        /// @brief Returns the filter selecting the files to be collected
+        inline const CFilter& filter() const {
+            return _filter;
+        }
+
+        /// @brief The next operations run to their end, whatever the cancellation token and the deadline of the options
+        /// @details Not to be called while an operation is running.
+        inline void ignoreCancellation() {
+            _options.cancel.reset();
+            _options.deadline = std::chrono::steady_clock::time_point::max();
+        }
+
+    protected:
+        AFactoryInfo(std::unique_ptr<ILogger> logger, const options_t& options) :
+            _logger{ std::move(logger) },
+            _options(options),
+            _progress{ _logger, std::max(1u, std::thread::hardware_concurrency()), std::chrono::milliseconds{ options.period_progress_ms } },
+            _stats{ options.stats },
+            _filter{ options.includes, options.excludes }
+        {   }
+
+        /// @brief Status of a file, read once and reused by every stage of the collection
+        struct status_t {
+            CHashCache::stat_t stat;
+            bool identified;    ///< Are the device, inode and number of links known? Not on Windows.
+        };
+
+        /// @brief File found by listFiles()
+        struct listed_t {
+            fs::path path;
+            bool hasStatus;     ///< Was the status read while listing? Only if the directory did not tell the file's type.
+            status_t status;
+        };
+
+        /// @brief Lists all **files** entries located inside the provided directory
+        /// @details Each entry is passed to the visitor as soon as it is found. The listing stops if it returns false.
+        ///          The entries filtered out are skipped, and the excluded directories are not descended into.
+        void listFiles(const fs::path& dir, const std::function<bool(listed_t&&)>& visitor) const;
+
+        /// @brief Throws **ExceptionCancelled** if the operation was cancelled or its deadline exceeded
+        void checkCancelled() const;
+
+        /// @brief Reads the status of a file
+        /// @details Throws **fs::filesystem_error** if the file cannot be accessed
+        status_t readStatus(const fs::path& path) const;
+
+        /// @brief Returns the status of a listed file, read only if the listing did not
+        /// @details Throws **fs::filesystem_error** if the file cannot be accessed
+        status_t statusOf(const listed_t& listed) const;
 
         CProxyLogger _logger;
+        options_t _options;
+        CProgress _progress;    ///< Counts the files collected
+        mutable CStats _stats;  ///< Measures the collection of the files
+        const CFilter _filter;  ///< Selects the files to be collected
 
     };
 
@@ -86,21 +156,47 @@ namespace  cf {
     class CFactoryInfoSecure : public AFactoryInfo
     {
     public:
-        explicit CFactoryInfoSecure(std::unique_ptr<ILogger> logger) :
-            AFactoryInfo{std::move(logger)},
+        explicit CFactoryInfoSecure(std::unique_ptr<ILogger> logger, const options_t& options = options_t{}) :
+            AFactoryInfo{std::move(logger), options},
             _nbThreads{std::max(1u, std::thread::hardware_concurrency())}
         {   }
-        ~CFactoryInfoSecure() = default;
+        /// @brief Saves the cache, if any
+        ~CFactoryInfoSecure();
     
         /// @brief Builds a collection with all the directory's files' hashes
         /// @param root Root folder: all its files will be hashed
-        /// @param loggerErr Will log eventual errors
-        CCollectionInfo collectInfo(const fs::path& root) override;
+        /// @param baseline A previous collection of the same folder, or nullptr
+        CCollectionInfo collectInfo(const fs::path& root, const CCollectionInfo* baseline = nullptr) override;
+
+        /// @brief Adds all the directory's files' hashes to a collection bounded in memory
+        void collectInfo(const fs::path& root, CCollectionSpill& collection) override;
+
+        /// @brief Collects the info of a single file
+        CCollectionInfo::info_t collectFile(const fs::path& path) const override;
+
+    protected:
+        /// @brief Returns true if the small files shall be hashed several at once, in SIMD lanes
+        /// @param provider Implementation of the single buffer hasher
+        virtual bool multiBuffer(const std::string& provider) const;
 
     private:
-        /// @brief Splits the paths in vectors (*slices*)
-        std::vector<std::list<fs::path>> splitPaths(const std::list<fs::path>& paths, const unsigned nb_slices) const;
+        /// @brief Hashes the files while they are listed, adding their info to the collection
+        template<typename TCollection>
+        void collect(const fs::path& root, const CCollectionInfo* baseline, TCollection& collection);
+        /// @brief Returns the hash of a file's content, or of its samples if the file is large enough
+        std::string hash(const fs::path& path, const std::uintmax_t size) const;
+        /// @brief Returns the digest of some blocks sampled in a large file, tagged as such
+        std::string sample(const fs::path& path, const std::uintmax_t size) const;
+        /// @brief Returns the prefix of the sampled hashes, with the sampling parameters
+        std::string tagSampled() const;
+        /// @brief Returns true if a file of this size is sampled rather than hashed whole
+        bool sampled(const std::uintmax_t size) const;
+        /// @brief Returns the number of bytes read to hash a file of this size
+        std::uintmax_t sizeRead(const std::uintmax_t size) const;
+        /// @brief Returns the content of a small file, whose size is given by its status
+        std::string read(const fs::path& path, const std::uintmax_t size) const;
         const unsigned _nbThreads;
+        std::unique_ptr<CHashCache> _cache; ///< Opened by the first collection, saved by the destructor
     };
 
     /// @brief      *Quickly* collects info about files.
@@ -109,19 +205,28 @@ namespace  cf {
     class CFactoryInfoFast : public AFactoryInfo
     {
     public:
-        explicit CFactoryInfoFast(std::unique_ptr<ILogger> logger) :
-            AFactoryInfo{ std::move(logger) }
+        explicit CFactoryInfoFast(std::unique_ptr<ILogger> logger, const options_t& options = options_t{}) :
+            AFactoryInfo{ std::move(logger), options }
         {   }
         ~CFactoryInfoFast() = default;
 
         /// @brief Builds a collection with all the directory's files' hashes
         /// @param root Root folder: all its files will be hashed
-        /// @param loggerErr Will log eventual errors
-        CCollectionInfo collectInfo(const fs::path& root) override;
+        /// @param baseline A previous collection of the same folder, or nullptr
+        CCollectionInfo collectInfo(const fs::path& root, const CCollectionInfo* baseline = nullptr) override;
+
+        /// @brief Adds all the directory's files' hashes to a collection bounded in memory
+        void collectInfo(const fs::path& root, CCollectionSpill& collection) override;
+
+        /// @brief Collects the info of a single file
+        CCollectionInfo::info_t collectFile(const fs::path& path) const override;
 
     private:
+        /// @brief Adds the info of the files to the collection while they are listed
+        template<typename TCollection>
+        void collect(const fs::path& root, TCollection& collection);
         /// @brief Computes and returns the *fast hash* from the info provided
-        std::string hasherFast(const std::time_t time_modified, const std::uintmax_t size) const;
+        std::string hasherFast(const std::int64_t time_modified_ns, const std::uintmax_t size) const;
     };
     
 }
@@ -0,0 +1,243 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#include <cstring>
+#include <algorithm>
+
+#include "CFilter.hpp"
+
+
+using namespace std;
+
+
+namespace  cf
+{
+
+    /// @brief Returns the path with slashes as separators, as the patterns expect
+    /// @details The paths relative to the root use the native separator. A backslash is a valid name character on POSIX.
+#ifdef _WIN32
+    static string portable(string path)
+    {
+        replace(path.begin(), path.end(), '\\', '/');
+        return path;
+    }
+#else
+    static inline const string& portable(const string& path)
+    {
+        return path;
+    }
+#endif
+
+
+
+    ///////////////////////
+
+    CFilter::CFilter(const list<string>& includes, const list<string>& excludes) :
+        _includes{ Parse(includes) },
+        _excludes{ Parse(excludes) }
+    {   }
+
+
+
+    ///////////////////////
+
+    bool CFilter::isExcluded(const string& path_native, const bool isDirectory) const
+    {
+        const auto& path = portable(path_native);
+        bool excluded = false;
+        Apply(_excludes, path, isDirectory, excluded);
+        return excluded;
+    }
+
+
+    /// @details The parent directories are tested from the root: the deepest match decides.
+    bool CFilter::isIncluded(const string& path_native) const
+    {
+        if (_includes.empty()) {
+            return true;
+        }
+        const auto& path = portable(path_native);
+        bool included = false;
+        for (auto end = path.find('/'); end != string::npos; end = path.find('/', end + 1u)) {
+            Apply(_includes, path.substr(0u, end), true, included);
+        }
+        Apply(_includes, path, false, included);
+        return included;
+    }
+
+
+    bool CFilter::excludesTree(const string& directory_native) const
+    {
+        if (_excludes.empty()) {
+            return false;
+        }
+        const auto& directory = portable(directory_native);
+        for (auto end = directory.find('/'); end != string::npos; end = directory.find('/', end + 1u)) {
+            if (isExcluded(directory.substr(0u, end), true)) {
+                return true;
+            }
+        }
+        return isExcluded(directory, true);
+    }
+
+
+    bool CFilter::accepts(const string& path_native) const
+    {
+        if (empty()) {
+            return true;
+        }
+        const auto& path = portable(path_native);
+        const auto slash = path.rfind('/');
+        if (slash != string::npos && excludesTree(path.substr(0u, slash))) {
+            return false;
+        }
+        return !isExcluded(path, false) && isIncluded(path);
+    }
+
+
+
+    ///////////////////////
+
+    vector<CFilter::pattern_t> CFilter::Parse(const list<string>& patterns)
+    {
+        vector<pattern_t> parsed;
+        for (auto glob : patterns)
+        {
+            if (glob.empty() || glob[0] == '#') {
+                continue;
+            }
+            pattern_t pattern{ string{}, false, false, false };
+            if (glob[0] == '!') {
+                pattern.negated = true;
+                glob.erase(0u, 1u);
+            }
+            if (!glob.empty() && glob.back() == '/') {
+                pattern.directory = true;
+                glob.pop_back();
+            }
+            pattern.anchored = glob.find('/') != string::npos;
+            if (!glob.empty() && glob[0] == '/') {
+                glob.erase(0u, 1u);
+            }
+            if (glob.empty()) {
+                continue;
+            }
+            pattern.glob = std::move(glob);
+            parsed.push_back(std::move(pattern));
+        }
+        return parsed;
+    }
+
+
+    /// @details Backtracks on the stars. A malformed character class is matched literally.
+    bool CFilter::Match(const char* glob, const char* str)
+    {
+        while (*glob != '\0')
+        {
+            if (glob[0] == '*' && glob[1] == '*') {
+                if (glob[2] == '/') { // zero or more directories
+                    if (Match(glob + 3, str)) {
+                        return true;
+                    }
+                    for (auto pos = str; *pos != '\0'; ++pos) {
+                        if (*pos == '/' && Match(glob + 3, pos + 1)) {
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+                for (auto pos = str; ; ++pos) {
+                    if (Match(glob + 2, pos)) {
+                        return true;
+                    }
+                    if (*pos == '\0') {
+                        return false;
+                    }
+                }
+            }
+            if (*glob == '*') {
+                for (auto pos = str; ; ++pos) {
+                    if (Match(glob + 1, pos)) {
+                        return true;
+                    }
+                    if (*pos == '\0' || *pos == '/') {
+                        return false;
+                    }
+                }
+            }
+            if (*str == '\0') {
+                return false;
+            }
+            if (*glob == '?') {
+                if (*str == '/') {
+                    return false;
+                }
+            }
+            else if (*glob == '[' && strchr(glob + 1, ']') != nullptr) {
+                auto pos = glob + 1;
+                const auto negated = (*pos == '!' || *pos == '^');
+                if (negated) {
+                    ++pos;
+                }
+                bool matched = false;
+                do { // a leading ']' is part of the class
+                    if (pos[1] == '-' && pos[2] != ']' && pos[2] != '\0') {
+                        matched = matched || (*pos <= *str && *str <= pos[2]);
+                        pos += 3;
+                    }
+                    else {
+                        matched = matched || (*pos == *str);
+                        ++pos;
+                    }
+                } while (*pos != ']' && *pos != '\0');
+                if (*pos == '\0' || matched == negated || *str == '/') {
+                    return false;
+                }
+                glob = pos;
+            }
+            else {
+                if (*glob == '\\' && glob[1] != '\0') {
+                    ++glob;
+                }
+                if (*glob != *str) {
+                    return false;
+                }
+            }
+            ++glob;
+            ++str;
+        }
+        return *str == '\0';
+    }
+
+
+    void CFilter::Apply(const vector<pattern_t>& patterns, const string& path, const bool isDirectory, bool& matched)
+    {
+        const auto slash = path.rfind('/');
+        const auto name = path.c_str() + ((slash == string::npos) ? 0u : slash + 1u);
+        for (const auto& pattern : patterns)
+        {
+            if (pattern.directory && !isDirectory) {
+                continue;
+            }
+            if (Match(pattern.glob.c_str(), pattern.anchored ? path.c_str() : name)) {
+                matched = !pattern.negated;
+            }
+        }
+    }
+
+}
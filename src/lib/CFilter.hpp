@@ -0,0 +1,87 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#ifndef _SRC_CFilter_hpp__
+#define _SRC_CFilter_hpp__
+
+#include <list>
+#include <string>
+#include <vector>
+
+namespace  cf {
+
+    /// @brief Selects the files to be collected, from *gitignore* style patterns
+    /// @details A pattern without a slash matches the name of a file or directory at any depth.
+    ///          Otherwise, it matches the path relative to the root: a leading slash is ignored.
+    ///          A trailing slash only matches directories.
+    ///          `*` matches anything but a slash, `?` a single character but a slash, `[...]` a character class,
+    ///          and `**` anything including slashes: `**/name`, `dir/**` and `a/**/b` behave as with git.
+    ///          A pattern starting with `!` negates the previous ones: the last pattern matching a path decides.
+    ///          The paths are relative to the root, UTF-8 encoded. Their native separators are matched as slashes.
+    class CFilter
+    {
+    public:
+        /// @param includes Only the files matching these patterns, or inside a directory matching them, are collected.
+        ///                 All the files if empty.
+        /// @param excludes The files and directories matching these patterns are ignored.
+        ///                 The excluded directories are not even listed.
+        CFilter(const std::list<std::string>& includes, const std::list<std::string>& excludes);
+
+        /// @brief Returns true if no file is filtered out
+        inline bool empty() const {
+            return _includes.empty() && _excludes.empty();
+        }
+
+        /// @brief Returns true if the entry is excluded, regardless of its parent directories
+        bool isExcluded(const std::string& path, const bool isDirectory) const;
+
+        /// @brief Returns true if the file is included, or one of its parent directories
+        bool isIncluded(const std::string& path) const;
+
+        /// @brief Returns true if the directory or one of its parent directories is excluded
+        bool excludesTree(const std::string& directory) const;
+
+        /// @brief Returns true if the file is collected: neither it nor its parent directories are excluded, and it is included
+        bool accepts(const std::string& path) const;
+
+    private:
+        struct pattern_t {
+            std::string glob;
+            bool negated;       ///< Starts with `!`
+            bool directory;     ///< Ends with a slash: only matches directories
+            bool anchored;      ///< Contains a slash: matches the whole path
+        };
+
+        /// @brief Parses some patterns. The empty ones and the comments are ignored.
+        static std::vector<pattern_t> Parse(const std::list<std::string>& patterns);
+
+        /// @brief Returns true if the glob matches the whole string
+        static bool Match(const char* glob, const char* str);
+
+        /// @brief Applies the patterns to an entry
+        /// @param matched  Updated if a pattern matches the entry
+        static void Apply(const std::vector<pattern_t>& patterns, const std::string& path, const bool isDirectory, bool& matched);
+
+        const std::vector<pattern_t> _includes;
+        const std::vector<pattern_t> _excludes;
+    };
+
+}
+
+
+#endif /* _SRC_CFilter_hpp__ */
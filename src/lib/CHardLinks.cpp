@@ -0,0 +1,63 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#include "CHardLinks.hpp"
+
+
+using namespace std;
+
+
+namespace  cf
+{
+
+    /// @details The hash is computed outside of the lock: only the links of the same inode wait for it.
+    ///          An inode is forgotten once all its links were found.
+    string CHardLinks::hash(const CHashCache::stat_t& stat, const function<string()>& hasher)
+    {
+        promise<string> computed;
+        shared_future<string> result;
+        bool isFirst;
+        {
+            const lock_guard<mutex> lock{ _mutex };
+            const auto inode = _hashes.emplace(key_t{ stat.device, stat.inode }, inode_t{ shared_future<string>{}, stat.links });
+            auto& hash = inode.first->second.hash;
+            isFirst = !hash.valid();
+            if (isFirst) {
+                hash = computed.get_future().share();
+            }
+            result = hash;
+            if (--inode.first->second.remaining == 0u) { // the last link was found
+                _hashes.erase(inode.first);
+            }
+        }
+
+        if (!isFirst) {
+            _shared.fetch_add(1u, memory_order_relaxed);
+        }
+        else {
+            try {
+                computed.set_value(hasher());
+            }
+            catch (...) {
+                computed.set_exception(current_exception());
+            }
+        }
+        return result.get();
+    }
+
+}
@@ -0,0 +1,75 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#ifndef _SRC_CHardLinks_hpp__
+#define _SRC_CHardLinks_hpp__
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <functional>
+
+#include "CHashCache.hpp"
+
+namespace  cf {
+
+    /// @brief Hashes shared by the hard links to the same inode
+    /// @details The first link of an inode to be hashed computes the hash. The other links get it
+    ///          without reading the file again, waiting for it if it is still being computed.
+    ///          hash() can be called from concurrent threads.
+    class CHardLinks
+    {
+    public:
+        CHardLinks() :
+            _shared{ 0u }
+        {   }
+        ~CHardLinks() = default;
+        CHardLinks(const CHardLinks&) = delete;
+        void operator=(const CHardLinks&) = delete;
+
+        /// @brief Returns the hash of a file having several links
+        /// @param stat   Status of the file, identifying its inode
+        /// @param hasher Computes the hash, if no other link of the inode was hashed
+        /// @details Throws the exception of the hasher, whatever the link that computed it
+        std::string hash(const CHashCache::stat_t& stat, const std::function<std::string()>& hasher);
+
+        /// @brief Returns the number of links whose hash was computed for another link
+        inline std::uint64_t shared() const {
+            return _shared.load(std::memory_order_relaxed);
+        }
+
+    private:
+        typedef std::pair<std::uint64_t, std::uint64_t> key_t;  ///< device, inode
+        struct inode_t {
+            std::shared_future<std::string> hash;   ///< Computed or pending
+            std::uint64_t remaining;                ///< Number of links not found yet
+        };
+
+        std::map<key_t, inode_t> _hashes;                           ///< Hashes of the inodes whose links were not all found
+        std::mutex _mutex;                                          ///< Protects the hashes
+        std::atomic<std::uint64_t> _shared;                         ///< Number of links not hashed
+    };
+
+}
+
+
+#endif /* _SRC_CHardLinks_hpp__ */
@@ -0,0 +1,307 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+#include <array>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+
+#include "CompareFolders.hpp"
+#include "CHashCache.hpp"
+
+
+using namespace std;
+
+
+namespace  cf
+{
+
+    static const array<char, 4u> MAGIC = { 'C', 'F', 'H', 'C' };   ///< Header of the cache files
+    static constexpr uint32_t VERSION = 1u;                         ///< Version of the cache files' format
+
+    /// @brief Reads a plain value from a binary stream
+    template<typename T>
+    static inline bool read(istream& stream, T& value)
+    {
+        return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    /// @brief Writes a plain value to a binary stream
+    template<typename T>
+    static inline void write(ostream& stream, const T& value)
+    {
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+
+
+    ///////////////////////
+
+    constexpr int64_t CHashCache::MARGIN_NS;
+
+
+    int64_t CHashCache::TimeNow()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+
+    /// @details A missing, corrupted or incompatible file is silently ignored: the cache will be rebuilt.
+    CHashCache::CHashCache(const fs::path& path, const string& algo) :
+        _path{ path },
+        _algo{ algo },
+        _time_start_ns{ TimeNow() },
+        _hits{ 0u }
+    {
+        ifstream stream{ path.string(), ios_base::in | ios_base::binary };
+        if (!stream) {
+            return;
+        }
+
+        array<char, 4u> magic;
+        uint32_t version, length_algo;
+        if (!stream.read(magic.data(), magic.size()) || magic != MAGIC
+            || !read(stream, version) || version != VERSION
+            || !read(stream, length_algo) || length_algo != _algo.size()) {
+            return;
+        }
+        string algo_file(length_algo, '\0');
+        uint64_t nb_entries;
+        if (!stream.read(&algo_file[0], length_algo) || algo_file != _algo || !read(stream, nb_entries)) {
+            return;
+        }
+
+        vector<pair<key_t, entry_t>> entries;
+        entries.reserve(static_cast<size_t>(min<uint64_t>(nb_entries, 1u << 20)));
+        for (auto i = 0ull; i < nb_entries; ++i)
+        {
+            key_t key;
+            entry_t entry;
+            uint8_t length_hash;
+            if (!read(stream, key.first) || !read(stream, key.second)
+                || !read(stream, entry.size) || !read(stream, entry.time_modified_ns) || !read(stream, entry.time_changed_ns)
+                || !read(stream, length_hash)) {
+                return;
+            }
+            entry.hash.resize(length_hash);
+            if (!stream.read(&entry.hash[0], length_hash)) {
+                return;
+            }
+            if (!entries.empty() && !(entries.back().first < key)) { // Written sorted
+                return;
+            }
+            entries.emplace_back(key, std::move(entry));
+        }
+        _entries = std::move(entries);
+        _seen.reset(new atomic_bool[_entries.size()]);
+        for (size_t i = 0u; i < _entries.size(); ++i) {
+            _seen[i].store(false, memory_order_relaxed);
+        }
+    }
+
+
+
+    ///////////////////////
+
+    /// @details On Linux, a single *statx* requests only the fields needed.
+    ///          Falls back on *stat* if the kernel does not provide it.
+    bool CHashCache::ReadStat(const fs::path& path, stat_t& stat)
+    {
+#ifdef _WIN32
+        (void)path;
+        (void)stat;
+        return false;
+#else
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+        static atomic_bool hasStatx{ true };
+        if (hasStatx.load(memory_order_relaxed)) {
+            constexpr unsigned MASK = STATX_TYPE | STATX_NLINK | STATX_INO | STATX_SIZE | STATX_MTIME | STATX_CTIME;
+            struct ::statx status;
+            if (::statx(AT_FDCWD, path.c_str(), AT_NO_AUTOMOUNT, MASK, &status) == 0) {
+                if ((status.stx_mask & MASK) != MASK) {
+                    return false;
+                }
+                stat.device = static_cast<uint64_t>(makedev(status.stx_dev_major, status.stx_dev_minor)); // as stat's st_dev
+                stat.inode = status.stx_ino;
+                stat.size = status.stx_size;
+                stat.time_modified_ns = status.stx_mtime.tv_sec * 1000000000 + status.stx_mtime.tv_nsec;
+                stat.time_changed_ns = status.stx_ctime.tv_sec * 1000000000 + status.stx_ctime.tv_nsec;
+                stat.links = status.stx_nlink;
+                stat.regular = S_ISREG(status.stx_mode);
+                return true;
+            }
+            if (errno != ENOSYS) {
+                return false;
+            }
+            hasStatx.store(false, memory_order_relaxed);
+        }
+#endif
+        struct ::stat status;
+        if (::stat(path.c_str(), &status) != 0) {
+            return false;
+        }
+#ifdef __APPLE__
+        const auto& time_modified = status.st_mtimespec;
+        const auto& time_changed = status.st_ctimespec;
+#else
+        const auto& time_modified = status.st_mtim;
+        const auto& time_changed = status.st_ctim;
+#endif
+        stat.device = static_cast<uint64_t>(status.st_dev);
+        stat.inode = static_cast<uint64_t>(status.st_ino);
+        stat.size = static_cast<uint64_t>(status.st_size);
+        stat.time_modified_ns = static_cast<int64_t>(time_modified.tv_sec) * 1000000000 + time_modified.tv_nsec;
+        stat.time_changed_ns = static_cast<int64_t>(time_changed.tv_sec) * 1000000000 + time_changed.tv_nsec;
+        stat.links = static_cast<uint64_t>(status.st_nlink);
+        stat.regular = S_ISREG(status.st_mode);
+        return true;
+#endif
+    }
+
+
+
+    ///////////////////////
+
+    /// @details Lock free: the loaded entries are never modified while scanning.
+    bool CHashCache::find(const stat_t& stat, string& hash) const
+    {
+        const auto position = lookup(stat);
+        if (position < 0) {
+            return false;
+        }
+        _seen[position].store(true, memory_order_relaxed);
+        hash = _entries[position].second.hash;
+        _hits.fetch_add(1u, memory_order_relaxed);
+        return true;
+    }
+
+
+    void CHashCache::touch(const stat_t& stat) const
+    {
+        const auto position = lookup(stat);
+        if (position >= 0) {
+            _seen[position].store(true, memory_order_relaxed);
+        }
+    }
+
+
+    ptrdiff_t CHashCache::lookup(const stat_t& stat) const
+    {
+        const key_t key{ stat.device, stat.inode };
+        const auto entry = lower_bound(_entries.begin(), _entries.end(), key, [](const pair<key_t, entry_t>& lhs, const key_t& rhs) {
+            return lhs.first < rhs;
+        });
+        if (entry == _entries.end() || entry->first != key
+            || entry->second.size != stat.size
+            || entry->second.time_modified_ns != stat.time_modified_ns
+            || entry->second.time_changed_ns != stat.time_changed_ns) {
+            return -1;
+        }
+        return entry - _entries.begin();
+    }
+
+
+    /// @details Files modified around or after the opening of the cache are not stored:
+    ///          they may have been modified again within the timestamps' granularity.
+    void CHashCache::add(const stat_t& stat, const string& hash)
+    {
+        if (max(stat.time_modified_ns, stat.time_changed_ns) + MARGIN_NS >= _time_start_ns || hash.size() > 0xFFu) {
+            return;
+        }
+        const lock_guard<mutex> lock{ _mutex };
+        _entries_new[key_t{ stat.device, stat.inode }] = entry_t{ stat.size, stat.time_modified_ns, stat.time_changed_ns, hash };
+    }
+
+
+    /// @details The file is written next to the destination then renamed,
+    ///          so an interrupted save never corrupts the previous cache.
+    ///          The loaded entries that were neither found nor touched belong to files removed, modified
+    ///          or out of the folders scanned: they are dropped.
+    void CHashCache::save() const
+    {
+        const auto path_tmp = fs::path{ _path.string() + ".tmp" };
+        {
+            ofstream stream{ path_tmp.string(), ios_base::out | ios_base::binary | ios_base::trunc };
+            if (!stream) {
+                throw Exception{ "Cannot write the hash cache " + path_tmp.string() };
+            }
+            stream.write(MAGIC.data(), MAGIC.size());
+            write(stream, VERSION);
+            write(stream, static_cast<uint32_t>(_algo.size()));
+            stream.write(_algo.data(), _algo.size());
+
+            // Counting the merged entries
+            const auto kept = [this](const size_t position) {
+                return _seen[position].load(memory_order_relaxed) && _entries_new.find(_entries[position].first) == _entries_new.end();
+            };
+            uint64_t nb_entries = _entries_new.size();
+            for (size_t i = 0u; i < _entries.size(); ++i) {
+                if (kept(i)) {
+                    ++nb_entries;
+                }
+            }
+            write(stream, nb_entries);
+
+            // Merging the sorted entries. New entries replace the former ones.
+            const auto writeEntry = [&stream](const key_t& key, const entry_t& entry) {
+                write(stream, key.first);
+                write(stream, key.second);
+                write(stream, entry.size);
+                write(stream, entry.time_modified_ns);
+                write(stream, entry.time_changed_ns);
+                write(stream, static_cast<uint8_t>(entry.hash.size()));
+                stream.write(entry.hash.data(), entry.hash.size());
+            };
+            size_t position_old = 0u;
+            auto it_new = _entries_new.begin();
+            while (position_old < _entries.size() || it_new != _entries_new.end())
+            {
+                if (it_new == _entries_new.end() || (position_old < _entries.size() && _entries[position_old].first < it_new->first)) {
+                    if (kept(position_old)) {
+                        writeEntry(_entries[position_old].first, _entries[position_old].second);
+                    }
+                    ++position_old;
+                }
+                else {
+                    if (position_old < _entries.size() && _entries[position_old].first == it_new->first) {
+                        ++position_old;
+                    }
+                    writeEntry(it_new->first, it_new->second);
+                    ++it_new;
+                }
+            }
+
+            if (!stream.flush()) {
+                throw Exception{ "Cannot write the hash cache " + path_tmp.string() };
+            }
+        }
+        boost::system::error_code error;
+        fs::rename(path_tmp, _path, error);
+        if (error) {
+            throw Exception{ "Cannot write the hash cache " + _path.string() + " : " + error.message() };
+        }
+    }
+
+}
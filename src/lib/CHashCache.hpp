@@ -0,0 +1,119 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+#ifndef _SRC_CHashCache_hpp__
+#define _SRC_CHashCache_hpp__
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <memory>
+#include <string>
+#include <utility>
+#include <mutex>
+#include <atomic>
+
+#include <boost/filesystem.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace  cf {
+
+    /// @brief Persistent cache of the files' hashes
+    /// @details A hash is reused as long as the file's inode keeps the same size, modification time
+    ///          and status change time. The ctime cannot be forged by the user and changes with any write.
+    ///          The entries neither found nor touched are dropped when saving: the removed files do not accumulate.
+    ///          A cache shall thus be opened for the same folders from run to run.
+    ///          find(), touch() and add() can be called from concurrent threads.
+    ///          Only available on POSIX systems: elsewhere nothing is ever found in the cache.
+    class CHashCache
+    {
+    public:
+        /// @brief Status of a file, as used to validate a cached hash
+        struct stat_t {
+            std::uint64_t device;
+            std::uint64_t inode;
+            std::uint64_t size;
+            std::int64_t time_modified_ns;  ///< Modification time, in nanoseconds
+            std::int64_t time_changed_ns;   ///< Status change time, in nanoseconds
+            std::uint64_t links;            ///< Number of hard links to the inode
+            bool regular;                   ///< Is it a regular file?
+        };
+
+        /// @brief Loads the cache file if it exists
+        /// @param path Path of the cache file
+        /// @param algo Name of the hashing algorithm. A cache built with another one is discarded.
+        CHashCache(const fs::path& path, const std::string& algo);
+        ~CHashCache() = default;
+        CHashCache(const CHashCache&) = delete;
+        void operator=(const CHashCache&) = delete;
+
+        /// @brief Safety margin for the timestamps' granularity, in nanoseconds
+        /// @details A file modified within this margin before a scan may be modified again with the same timestamp.
+        static constexpr std::int64_t MARGIN_NS = 1000000000;
+
+        /// @brief Returns the current time, in nanoseconds since the epoch, as the modification times
+        static std::int64_t TimeNow();
+
+        /// @brief Reads the status of a file with a single system call. Returns false if not available.
+        static bool ReadStat(const fs::path& path, stat_t& stat);
+
+        /// @brief Looks for the hash of a file. Returns false if not found or outdated.
+        /// @details An entry found is kept when saving.
+        bool find(const stat_t& stat, std::string& hash) const;
+
+        /// @brief Keeps the entry of a file when saving, if it is up to date, without counting a hit
+        void touch(const stat_t& stat) const;
+
+        /// @brief Stores the hash of a file
+        void add(const stat_t& stat, const std::string& hash);
+
+        /// @brief Writes the cache to disk, with the entries added and the ones found or touched
+        /// @details May throw **Exception**
+        void save() const;
+
+        /// @brief Returns the number of hashes found in the cache
+        inline std::uint64_t hits() const {
+            return _hits;
+        }
+
+    private:
+        typedef std::pair<std::uint64_t, std::uint64_t> key_t;  ///< device, inode
+        struct entry_t {
+            std::uint64_t size;
+            std::int64_t time_modified_ns;
+            std::int64_t time_changed_ns;
+            std::string hash;
+        };
+
+        /// @brief Returns the position of an up to date entry loaded from the file, or a negative value
+        std::ptrdiff_t lookup(const stat_t& stat) const;
+
+        const fs::path _path;                       ///< Path of the cache file
+        const std::string _algo;                    ///< Hashing algorithm
+        const std::int64_t _time_start_ns;          ///< Time when the cache was opened
+        std::vector<std::pair<key_t, entry_t>> _entries;    ///< Entries loaded from the file, sorted: read only while scanning
+        std::unique_ptr<std::atomic_bool[]> _seen;  ///< Which loaded entries were found or touched
+        std::map<key_t, entry_t> _entries_new;      ///< Entries added while scanning
+        std::mutex _mutex;                          ///< Protects the new entries
+        mutable std::atomic<std::uint64_t> _hits;   ///< Number of hashes found
+    };
+
+}
+
+
+#endif /* _SRC_CHashCache_hpp__ */
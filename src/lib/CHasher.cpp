@@ -0,0 +1,81 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#include <cryptopp/sha.h>
+
+#include "CHasher.hpp"
+
+
+using namespace std;
+
+
+namespace  cf
+{
+
+    CHasher::CHasher(const eAlgorithm algo)
+    {
+        if (algo == eAlgorithm::SHA256) {
+            _hash = make_unique<CryptoPP::SHA256>();
+        }
+        else {
+            _hash = make_unique<CryptoPP::SHA1>();
+        }
+    }
+
+
+    CHasher::~CHasher() = default;
+    CHasher::CHasher(CHasher&&) = default;
+
+
+
+    ///////////////////////
+
+    void CHasher::update(const void* data, const size_t size)
+    {
+        _hash->Update(static_cast<const CryptoPP::byte*>(data), size);
+    }
+
+
+    /// @details Encoded without a filter chain: no allocation but the string returned.
+    string CHasher::digest()
+    {
+        static constexpr char HEX[] = "0123456789ABCDEF";
+        CryptoPP::byte hash[CryptoPP::SHA256::DIGESTSIZE];
+        const auto size = _hash->DigestSize();
+        _hash->Final(hash);
+        string digest(2u * size, '0');
+        for (auto i = 0u; i < size; ++i) {
+            digest[2u * i] = HEX[hash[i] >> 4];
+            digest[2u * i + 1u] = HEX[hash[i] & 0x0Fu];
+        }
+        return digest;
+    }
+
+
+    string CHasher::name() const
+    {
+        return _hash->AlgorithmName();
+    }
+
+
+    string CHasher::provider() const
+    {
+        return _hash->AlgorithmProvider();
+    }
+
+}
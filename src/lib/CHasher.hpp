@@ -0,0 +1,69 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#ifndef _SRC_CHasher_hpp__
+#define _SRC_CHasher_hpp__
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace CryptoPP {
+    class HashTransformation;
+}
+
+namespace  cf {
+
+    /// @brief Cryptographic hash of a content fed chunk by chunk
+    /// @details Crypto++ selects the fastest implementation available at runtime:
+    ///          SHA-NI on x86, the ARMv8 SHA extensions, SSE, and portable C++ otherwise.
+    ///          Not thread safe: each thread shall use its own hasher.
+    class CHasher
+    {
+    public:
+        enum class eAlgorithm {
+            SHA1,
+            SHA256
+        };
+
+        explicit CHasher(const eAlgorithm algo = eAlgorithm::SHA1);
+        ~CHasher();
+        CHasher(CHasher&&);
+        CHasher(const CHasher&) = delete;
+        void operator=(const CHasher&) = delete;
+
+        /// @brief Hashes some more data
+        void update(const void* data, const std::size_t size);
+
+        /// @brief Returns the digest of the data hashed, as upper case hexadecimal, and restarts the hasher
+        std::string digest();
+
+        /// @brief Returns the name of the algorithm
+        std::string name() const;
+
+        /// @brief Returns the implementation selected at runtime. E.g. "SHANI", "ARMv8", "SSE2" or "C++".
+        std::string provider() const;
+
+    private:
+        std::unique_ptr<CryptoPP::HashTransformation> _hash;
+    };
+
+}
+
+
+#endif /* _SRC_CHasher_hpp__ */
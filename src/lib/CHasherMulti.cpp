@@ -0,0 +1,266 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#include <cstdint>
+#include <cstring>
+#include <array>
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CF_HASHER_AVX2
+#include <immintrin.h>
+#endif
+
+#include "CHasher.hpp"
+#include "CHasherMulti.hpp"
+
+
+using namespace std;
+
+
+namespace  cf
+{
+
+#ifdef CF_HASHER_AVX2
+
+    static constexpr unsigned NB_LANES = 8u;
+    static constexpr size_t SIZE_BLOCK = 64u;
+    static constexpr uint32_t IV[5] = { 0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u };
+
+#define CF_AVX2 __attribute__((target("avx2")))
+
+    CF_AVX2 static inline __m256i Rotate(const __m256i x, const int n)
+    {
+        return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+    }
+
+    CF_AVX2 static inline __m256i Xor(const __m256i a, const __m256i b, const __m256i c)
+    {
+        return _mm256_xor_si256(_mm256_xor_si256(a, b), c);
+    }
+
+    /// @brief Loads eight big endian words of each lane, transposed: words[t] holds the t-th word of every lane
+    CF_AVX2 static inline void Load(const uint8_t* const blocks[NB_LANES], const size_t offset, __m256i words[8])
+    {
+        const auto swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                           3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        __m256i rows[8];
+        for (auto lane = 0u; lane < NB_LANES; ++lane) {
+            rows[lane] = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(blocks[lane] + offset)), swap);
+        }
+        // 8x8 transposition of 32 bits elements
+        __m256i pairs[8];
+        for (auto i = 0u; i < 8u; i += 2u) {
+            pairs[i] = _mm256_unpacklo_epi32(rows[i], rows[i + 1u]);
+            pairs[i + 1u] = _mm256_unpackhi_epi32(rows[i], rows[i + 1u]);
+        }
+        __m256i quads[8];
+        for (auto i = 0u; i < 8u; i += 4u) {
+            quads[i] = _mm256_unpacklo_epi64(pairs[i], pairs[i + 2u]);
+            quads[i + 1u] = _mm256_unpackhi_epi64(pairs[i], pairs[i + 2u]);
+            quads[i + 2u] = _mm256_unpacklo_epi64(pairs[i + 1u], pairs[i + 3u]);
+            quads[i + 3u] = _mm256_unpackhi_epi64(pairs[i + 1u], pairs[i + 3u]);
+        }
+        for (auto i = 0u; i < 4u; ++i) {
+            words[i] = _mm256_permute2x128_si256(quads[i], quads[i + 4u], 0x20);
+            words[i + 4u] = _mm256_permute2x128_si256(quads[i], quads[i + 4u], 0x31);
+        }
+    }
+
+    /// @brief Processes a block of each lane
+    /// @param state    State of each lane: state[i][lane] is the i-th word of the lane
+    /// @param blocks   Block of each lane
+    CF_AVX2 static void Sha1Avx2(uint32_t state[5][NB_LANES], const uint8_t* const blocks[NB_LANES])
+    {
+        __m256i w[16];
+        Load(blocks, 0u, w);
+        Load(blocks, 32u, w + 8);
+
+        auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state[0]));
+        auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state[1]));
+        auto c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state[2]));
+        auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state[3]));
+        auto e = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state[4]));
+
+        for (auto t = 0u; t < 80u; ++t)
+        {
+            if (t >= 16u) {
+                w[t & 15u] = Rotate(_mm256_xor_si256(Xor(w[(t - 3u) & 15u], w[(t - 8u) & 15u], w[(t - 14u) & 15u]), w[t & 15u]), 1);
+            }
+            __m256i f, k;
+            if (t < 20u) {
+                f = _mm256_xor_si256(_mm256_and_si256(b, c), _mm256_andnot_si256(b, d));
+                k = _mm256_set1_epi32(0x5A827999);
+            }
+            else if (t < 40u) {
+                f = Xor(b, c, d);
+                k = _mm256_set1_epi32(0x6ED9EBA1);
+            }
+            else if (t < 60u) {
+                f = _mm256_or_si256(_mm256_and_si256(b, c), _mm256_and_si256(d, _mm256_or_si256(b, c)));
+                k = _mm256_set1_epi32(static_cast<int>(0x8F1BBCDCu));
+            }
+            else {
+                f = Xor(b, c, d);
+                k = _mm256_set1_epi32(static_cast<int>(0xCA62C1D6u));
+            }
+            const auto temp = _mm256_add_epi32(_mm256_add_epi32(Rotate(a, 5), f), _mm256_add_epi32(_mm256_add_epi32(e, k), w[t & 15u]));
+            e = d;
+            d = c;
+            c = Rotate(b, 30);
+            b = a;
+            a = temp;
+        }
+
+        const __m256i words[5] = { a, b, c, d, e };
+        for (auto i = 0u; i < 5u; ++i) {
+            const auto word = reinterpret_cast<__m256i*>(state[i]);
+            _mm256_storeu_si256(word, _mm256_add_epi32(_mm256_loadu_si256(word), words[i]));
+        }
+    }
+
+#undef CF_AVX2
+
+
+    /// @brief A message being hashed in a lane
+    /// @details The message is read in place, but for its last blocks which receive the padding.
+    struct lane_t {
+        /// @brief Starts hashing a message
+        void load(const string& message)
+        {
+            data = reinterpret_cast<const uint8_t*>(message.data());
+            nb_full = message.size() / SIZE_BLOCK;
+            const auto size_tail = message.size() % SIZE_BLOCK;
+            nb_blocks = nb_full + ((size_tail + 9u <= SIZE_BLOCK) ? 1u : 2u);
+            next = 0u;
+            tail.fill(0u);
+            memcpy(tail.data(), data + nb_full * SIZE_BLOCK, size_tail);
+            tail[size_tail] = 0x80u;
+            const auto bits = static_cast<uint64_t>(message.size()) * 8u;
+            const auto end = (nb_blocks - nb_full) * SIZE_BLOCK;
+            for (auto i = 0u; i < 8u; ++i) {
+                tail[end - 1u - i] = static_cast<uint8_t>(bits >> (8u * i));
+            }
+        }
+
+        /// @brief Returns the next block to be hashed
+        inline const uint8_t* block() const {
+            return (next < nb_full) ? data + next * SIZE_BLOCK : tail.data() + (next - nb_full) * SIZE_BLOCK;
+        }
+
+        const uint8_t* data = nullptr;
+        size_t nb_full = 0u;            ///< Blocks read in place
+        size_t nb_blocks = 0u;          ///< Blocks including the padding
+        size_t next = 0u;               ///< Next block to be hashed
+        size_t message = 0u;            ///< Index of the message
+        bool active = false;
+        array<uint8_t, 2u * SIZE_BLOCK> tail;
+    };
+
+
+    static bool HasAvx2()
+    {
+        static const bool hasAvx2 = __builtin_cpu_supports("avx2") != 0;
+        return hasAvx2;
+    }
+
+#endif
+
+
+
+    ///////////////////////
+
+    unsigned CHasherMulti::Lanes()
+    {
+#ifdef CF_HASHER_AVX2
+        if (HasAvx2()) {
+            return NB_LANES;
+        }
+#endif
+        return 1u;
+    }
+
+
+    string CHasherMulti::Provider()
+    {
+        return (Lanes() > 1u) ? "AVX2" : "C++";
+    }
+
+
+    vector<string> CHasherMulti::Digests(const vector<string>& messages)
+    {
+        vector<string> digests(messages.size());
+#ifdef CF_HASHER_AVX2
+        if (HasAvx2() && messages.size() > 1u)
+        {
+            static const uint8_t BLOCK_IDLE[SIZE_BLOCK] = {};
+            uint32_t state[5][NB_LANES];
+            array<lane_t, NB_LANES> lanes;
+            const uint8_t* blocks[NB_LANES];
+            size_t next = 0u;
+
+            while (true)
+            {
+                // Refilling the lanes whose message is over
+                auto nb_active = 0u;
+                for (auto i = 0u; i < NB_LANES; ++i) {
+                    auto& lane = lanes[i];
+                    if (!lane.active && next < messages.size()) {
+                        lane.load(messages[next]);
+                        lane.message = next++;
+                        lane.active = true;
+                        for (auto word = 0u; word < 5u; ++word) {
+                            state[word][i] = IV[word];
+                        }
+                    }
+                    if (lane.active) {
+                        ++nb_active;
+                    }
+                    blocks[i] = lane.active ? lane.block() : BLOCK_IDLE;
+                }
+                if (nb_active == 0u) {
+                    break;
+                }
+
+                Sha1Avx2(state, blocks);
+
+                for (auto i = 0u; i < NB_LANES; ++i) {
+                    auto& lane = lanes[i];
+                    if (lane.active && ++lane.next == lane.nb_blocks) {
+                        static constexpr char HEX[] = "0123456789ABCDEF";
+                        auto& digest = digests[lane.message];
+                        digest.resize(40u);
+                        for (auto word = 0u; word < 5u; ++word) {
+                            for (auto nibble = 0u; nibble < 8u; ++nibble) {
+                                digest[8u * word + nibble] = HEX[(state[word][i] >> (28u - 4u * nibble)) & 0x0Fu];
+                            }
+                        }
+                        lane.active = false;
+                    }
+                }
+            }
+            return digests;
+        }
+#endif
+        CHasher hasher;
+        for (auto i = 0u; i < messages.size(); ++i) {
+            hasher.update(messages[i].data(), messages[i].size());
+            digests[i] = hasher.digest();
+        }
+        return digests;
+    }
+
+}
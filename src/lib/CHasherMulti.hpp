@@ -0,0 +1,48 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#ifndef _SRC_CHasherMulti_hpp__
+#define _SRC_CHasherMulti_hpp__
+
+#include <string>
+#include <vector>
+
+namespace  cf {
+
+    /// @brief SHA-1 of several small messages computed at once
+    /// @details Each message takes a lane of the SIMD registers: with AVX2, eight messages are hashed
+    ///          for the price of one. A lane whose message is over is refilled with the next one.
+    ///          The implementation is selected at runtime. Without AVX2, the messages are hashed one by one.
+    ///          The digests are the same as CHasher's.
+    class CHasherMulti
+    {
+    public:
+        /// @brief Returns the number of messages hashed at once. 1 if no SIMD implementation is available.
+        static unsigned Lanes();
+
+        /// @brief Returns the implementation selected at runtime: "AVX2" or "C++"
+        static std::string Provider();
+
+        /// @brief Returns the SHA-1 digests of the messages, as upper case hexadecimal
+        static std::vector<std::string> Digests(const std::vector<std::string>& messages);
+    };
+
+}
+
+
+#endif /* _SRC_CHasherMulti_hpp__ */
@@ -0,0 +1,780 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <list>
+#include <stdexcept>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "CompareFolders.hpp"
+#include "CParserJson.hpp"
+#include "CTrace.hpp"
+
+
+using namespace std;
+
+
+namespace  cf
+{
+
+    /// @brief Files smaller than this are not worth splitting
+    static constexpr size_t SIZE_MIN_SLICE = 1u << 20;
+
+    /// @brief Appends the UTF-8 encoding of a code point
+    static inline void appendUtf8(string& str, const uint32_t code_point)
+    {
+        if (code_point < 0x80) {
+            str.push_back(static_cast<char>(code_point));
+        }
+        else if (code_point < 0x800) {
+            str.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+            str.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        }
+        else if (code_point < 0x10000) {
+            str.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+            str.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            str.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        }
+        else {
+            str.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+            str.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+            str.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+            str.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+        }
+    }
+
+
+    /// @brief Returns the algorithm named in a JSON file
+    /// @param seconds_only Receives true if the fast hashes are made of the modification times in whole seconds
+    static eCollectingAlgorithm algorithm(const string& algo_hash, bool& seconds_only)
+    {
+        seconds_only = algo_hash == JSON_CONST_VALUES.ALGO_HASH_FAST;
+        return (seconds_only || algo_hash == JSON_CONST_VALUES.ALGO_HASH_FAST_NS) ? eCollectingAlgorithm::FAST : eCollectingAlgorithm::SECURE;
+    }
+
+
+    /// @brief Adds to a collection only the files accepted by a filter
+    class CCollectionFiltered
+    {
+    public:
+        CCollectionFiltered(CCollectionSpill& collection, const CFilter& filter) :
+            _collection(collection),
+            _filter(filter)
+        {   }
+        void setInfo(const string& path, const CCollectionInfo::info_t& info) {
+            if (_filter.accepts(path)) {
+                _collection.setInfo(path, info);
+            }
+        }
+    private:
+        CCollectionSpill& _collection;
+        const CFilter& _filter;
+    };
+
+
+    ///////////////////////
+
+    /// @details On POSIX systems the file is mapped rather than read: its pages are loaded on demand
+    ///          and can be reclaimed by the system. Thus, huge files can be parsed sequentially.
+    CParserJson::CParserJson(const fs::path& json_path) :
+        _path{ json_path },
+        _data{ nullptr },
+        _size{ 0u },
+        _mapping{ nullptr }
+    {
+        if (!fs::is_regular_file(json_path)) {
+            throw ExceptionFatal{ json_path.string() + " is not a file." };
+        }
+#ifndef _WIN32
+        const auto fd = open(json_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw ExceptionFatal{ "Cannot read " + json_path.string() };
+        }
+        struct stat status;
+        if (fstat(fd, &status) == 0 && status.st_size > 0) {
+            const auto mapping = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                madvise(mapping, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+                _mapping = mapping;
+                _data = static_cast<const char*>(mapping);
+                _size = static_cast<size_t>(status.st_size);
+            }
+        }
+        close(fd);
+        if (_mapping != nullptr) {
+            return;
+        }
+#endif
+        // Not mapped: loaded in memory
+        ifstream stream{ json_path.string(), ios_base::in | ios_base::binary };
+        if (!stream) {
+            throw ExceptionFatal{ "Cannot read " + json_path.string() };
+        }
+        _buffer.resize(static_cast<size_t>(fs::file_size(json_path)));
+        stream.read(&_buffer[0], static_cast<streamsize>(_buffer.size()));
+        _buffer.resize(static_cast<size_t>(stream.gcount()));
+        _data = _buffer.data();
+        _size = _buffer.size();
+    }
+
+
+    CParserJson::~CParserJson()
+    {
+#ifndef _WIN32
+        if (_mapping != nullptr) {
+            munmap(_mapping, _size);
+        }
+#endif
+    }
+
+
+
+    ///////////////////////
+
+    /// @details The "files" object is only *skipped*, recording the positions of the record boundaries
+    ///          where it can be split.
+    CParserJson::header_t CParserJson::parseHeader(const unsigned nb_slices, vector<range_t>& slices) const
+    {
+        const auto& KEY_GENERATOR = JSON_KEYS.GENERATOR;
+        const auto& KEY_ALGO_HASH = JSON_KEYS.ALGO_HASH;
+        const auto& KEY_ROOT = JSON_KEYS.ROOT;
+        const auto& KEY_TIME_SCAN = JSON_KEYS.TIME_SCAN;
+        const auto& KEY_FILES = JSON_KEYS.CONTENT.FILES;
+        const auto& KEY_DIRECTORIES = JSON_KEYS.CONTENT.DIRECTORIES;
+        const auto& KEY_ERRORS = JSON_KEYS.CONTENT.ERRORS;
+
+        header_t header;
+        string generator, algo_hash;
+        bool has_generator = false, has_algo_hash = false, has_root = false, has_files = false;
+        header.has_directories = false;
+        header.time_scan_ns = 0;
+
+        auto pos = expect(skipBlanks(0u), '{');
+        pos = skipBlanks(pos);
+        if (pos < _size && _data[pos] == '}') {
+            ++pos;
+        }
+        else {
+            while (true)
+            {
+                string key;
+                pos = parseString(skipBlanks(pos), key);
+                pos = skipBlanks(expect(skipBlanks(pos), ':'));
+                if (key == KEY_GENERATOR) {
+                    pos = parseScalar(pos, generator);
+                    has_generator = true;
+                }
+                else if (key == KEY_ALGO_HASH) {
+                    pos = parseScalar(pos, algo_hash);
+                    has_algo_hash = true;
+                }
+                else if (key == KEY_ROOT) {
+                    pos = parseScalar(pos, header.root);
+                    has_root = true;
+                }
+                else if (key == KEY_TIME_SCAN) {
+                    pos = parseTime(pos, header.time_scan_ns);
+                }
+                else if (key == KEY_FILES) {
+                    pos = splitFiles(pos, nb_slices, slices);
+                    has_files = true;
+                }
+                else if (key == KEY_DIRECTORIES) {
+                    pos = parseStrings(pos, header.digests);
+                    header.has_directories = true;
+                }
+                else if (key == KEY_ERRORS) {
+                    pos = parseStrings(pos, header.errors);
+                }
+                else {
+                    pos = skipValue(pos);
+                }
+                pos = skipBlanks(pos);
+                if (pos < _size && _data[pos] == ',') {
+                    ++pos;
+                    continue;
+                }
+                pos = expect(pos, '}');
+                break;
+            }
+        }
+
+        if (!has_generator) {
+            fail(pos, "No such node (" + KEY_GENERATOR + ")");
+        }
+        if (generator != JSON_CONST_VALUES.GENERATOR) {
+            throw ExceptionFatal{ "This is not a proper file." };
+        }
+        if (!has_algo_hash) {
+            fail(pos, "No such node (" + KEY_ALGO_HASH + ")");
+        }
+        if (!has_root) {
+            fail(pos, "No such node (" + KEY_ROOT + ")");
+        }
+        if (!has_files) {
+            fail(pos, "No such node (" + KEY_FILES + ")");
+        }
+
+        header.algo = algorithm(algo_hash, header.seconds_only);
+        return header;
+    }
+
+
+    /// @details The header is parsed in the calling thread. Each slice of the "files" object is then parsed by its own thread.
+    CCollectionInfo CParserJson::parse(const unsigned nbThreads) const
+    {
+        const auto nb_slices = max(1u, min(nbThreads, static_cast<unsigned>(_size / SIZE_MIN_SLICE) + 1u));
+        vector<range_t> slices;
+        CTrace::CSpan span_header{ "parse header" };
+        auto header = parseHeader(nb_slices, slices);
+        span_header.stop();
+        const auto& root = header.root;
+        const auto algo = header.algo;
+
+        // Parse the slices concurrently, then merge the partial collections in order
+        vector<future<CCollectionInfo>> partials;
+        for (const auto& slice : slices) {
+            partials.emplace_back(async(launch::async, [this, &slice, &root, algo] {
+                const CTrace::CSpan span{ "parse slice" };
+                CCollectionInfo partial{ root, algo };
+                parseFiles(slice, partial);
+                return partial;
+            }));
+        }
+        CCollectionInfo collection{ root, algo };
+        for (auto& partial : partials) {
+            collection.merge(partial.get());
+        }
+        if (header.seconds_only) {
+            collection.setSecondsOnly();
+        }
+        collection.setTimeScan(header.time_scan_ns);
+        for (const auto& error : header.errors) {
+            collection.setError(error.first, error.second);
+        }
+        // Digests are missing from the files written by former versions: they will be computed if required
+        if (header.has_directories) {
+            collection.setDigests(std::move(header.digests));
+        }
+
+        return collection;
+    }
+
+
+    /// @details The files are parsed sequentially, in the calling thread.
+    unique_ptr<CCollectionSpill> CParserJson::parse(const size_t budget, const fs::path& dir_temp, const CFilter& filter) const
+    {
+        vector<range_t> slices;
+        const auto header = parseHeader(1u, slices);
+        auto collection = make_unique<CCollectionSpill>(header.root, header.algo, budget, dir_temp);
+        if (header.seconds_only) {
+            collection->setSecondsOnly();
+        }
+        collection->setTimeScan(header.time_scan_ns);
+        CCollectionFiltered filtered{ *collection, filter };
+        for (const auto& slice : slices) {
+            const CTrace::CSpan span{ "parse slice" };
+            parseFiles(slice, filtered);
+        }
+        for (const auto& error : header.errors) {
+            if (filter.accepts(error.first)) {
+                collection->setError(error.first, error.second);
+            }
+        }
+        return collection;
+    }
+
+
+
+    ///////////////////////
+
+    /// @details The delta is small compared to the collection: it is parsed in the calling thread.
+    CCollectionInfo CParserJson::applyDelta(CCollectionInfo&& base, string& digest) const
+    {
+        const auto& KEY_GENERATOR = JSON_KEYS.GENERATOR;
+        const auto& KEY_ALGO_HASH = JSON_KEYS.ALGO_HASH;
+        const auto& KEY_ROOT = JSON_KEYS.ROOT;
+        const auto& KEY_TIME_SCAN = JSON_KEYS.TIME_SCAN;
+        const auto& KEY_BASE = JSON_KEYS.DELTA.BASE;
+        const auto& KEY_DIGEST = JSON_KEYS.DELTA.DIGEST;
+        const auto& KEY_ADDED = JSON_KEYS.DELTA.ADDED;
+        const auto& KEY_MODIFIED = JSON_KEYS.DELTA.MODIFIED;
+        const auto& KEY_REMOVED = JSON_KEYS.DELTA.REMOVED;
+        const auto& KEY_ERRORS = JSON_KEYS.CONTENT.ERRORS;
+
+        string generator, algo_hash, root, digest_base, digest_result;
+        bool has_generator = false, has_algo_hash = false, has_root = false, has_base = false, has_digest = false;
+        int64_t time_scan_ns = 0;
+        vector<range_t> slices;
+        list<string> removed;
+        map<string, string> errors;
+
+        auto pos = expect(skipBlanks(0u), '{');
+        while (true)
+        {
+            string key;
+            pos = parseString(skipBlanks(pos), key);
+            pos = skipBlanks(expect(skipBlanks(pos), ':'));
+            if (key == KEY_GENERATOR) {
+                pos = parseScalar(pos, generator);
+                has_generator = true;
+            }
+            else if (key == KEY_ALGO_HASH) {
+                pos = parseScalar(pos, algo_hash);
+                has_algo_hash = true;
+            }
+            else if (key == KEY_ROOT) {
+                pos = parseScalar(pos, root);
+                has_root = true;
+            }
+            else if (key == KEY_TIME_SCAN) {
+                pos = parseTime(pos, time_scan_ns);
+            }
+            else if (key == KEY_BASE) {
+                pos = parseString(pos, digest_base);
+                has_base = true;
+            }
+            else if (key == KEY_DIGEST) {
+                pos = parseString(pos, digest_result);
+                has_digest = true;
+            }
+            else if (key == KEY_ADDED || key == KEY_MODIFIED) {
+                pos = splitFiles(pos, 1u, slices);
+            }
+            else if (key == KEY_REMOVED) {
+                pos = skipBlanks(expect(pos, '['));
+                if (pos < _size && _data[pos] == ']') {
+                    ++pos;
+                }
+                else {
+                    while (true) {
+                        string path;
+                        pos = skipBlanks(parseString(skipBlanks(pos), path));
+                        removed.push_back(std::move(path));
+                        if (pos < _size && _data[pos] == ',') {
+                            ++pos;
+                            continue;
+                        }
+                        pos = expect(pos, ']');
+                        break;
+                    }
+                }
+            }
+            else if (key == KEY_ERRORS) {
+                pos = parseStrings(pos, errors);
+            }
+            else {
+                pos = skipValue(pos);
+            }
+            pos = skipBlanks(pos);
+            if (pos < _size && _data[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            pos = expect(pos, '}');
+            break;
+        }
+
+        if (!has_generator) {
+            fail(pos, "No such node (" + KEY_GENERATOR + ")");
+        }
+        if (generator != JSON_CONST_VALUES.GENERATOR) {
+            throw ExceptionFatal{ "This is not a proper file." };
+        }
+        if (!has_algo_hash) {
+            fail(pos, "No such node (" + KEY_ALGO_HASH + ")");
+        }
+        if (!has_root) {
+            fail(pos, "No such node (" + KEY_ROOT + ")");
+        }
+        if (!has_base) {
+            fail(pos, "No such node (" + KEY_BASE + ")");
+        }
+        if (!has_digest) {
+            fail(pos, "No such node (" + KEY_DIGEST + ")");
+        }
+
+        bool seconds_only;
+        const auto algo = algorithm(algo_hash, seconds_only);
+        if (algo != base.hasher() || seconds_only != base.secondsOnly()) {
+            throw ExceptionFatal{ "The delta " + _path.string() + " is based on another hash algorithm." };
+        }
+        if (digest_base != digest) {
+            throw ExceptionFatal{ "The delta " + _path.string() + " does not apply to this snapshot." };
+        }
+
+        CCollectionInfo changed{ root, algo };
+        for (const auto& slice : slices) {
+            parseFiles(slice, changed);
+        }
+        for (const auto& error : errors) {
+            changed.setError(error.first, error.second);
+        }
+        CCollectionInfo collection{ root, algo };
+        collection.merge(std::move(base));
+        collection.applyDelta(changed, removed);
+        if (seconds_only) {
+            collection.setSecondsOnly();
+        }
+        collection.setTimeScan(time_scan_ns); // the scan producing the delta
+
+        digest = std::move(digest_result);
+        return collection;
+    }
+
+
+
+    ///////////////////////
+
+    size_t CParserJson::skipBlanks(size_t pos) const
+    {
+        const auto size = _size;
+        while (pos < size && (_data[pos] == ' ' || _data[pos] == '\n' || _data[pos] == '\r' || _data[pos] == '\t')) {
+            ++pos;
+        }
+        return pos;
+    }
+
+
+    size_t CParserJson::expect(const size_t pos, const char c) const
+    {
+        if (pos >= _size || _data[pos] != c) {
+            fail(pos, string{ "expected '" } + c + '\'');
+        }
+        return pos + 1u;
+    }
+
+
+    /// @details Jumps from quote to quote: a quote preceded by an odd number of backslashes is escaped.
+    size_t CParserJson::skipString(size_t pos) const
+    {
+        pos = expect(pos, '"');
+        const auto data = _data;
+        const auto size = _size;
+        while (true)
+        {
+            const auto quote = static_cast<const char*>(memchr(data + pos, '"', size - pos));
+            if (quote == nullptr) {
+                fail(size, "unterminated string");
+            }
+            const auto idx_quote = static_cast<size_t>(quote - data);
+            auto idx = idx_quote;
+            while (idx > pos && data[idx - 1] == '\\') {
+                --idx;
+            }
+            if (((idx_quote - idx) & 1u) == 0u) {
+                return idx_quote + 1u;
+            }
+            pos = idx_quote + 1u;
+        }
+    }
+
+
+    size_t CParserJson::skipValue(size_t pos) const
+    {
+        const auto size = _size;
+        if (pos >= size) {
+            fail(pos, "expected a value");
+        }
+        if (_data[pos] == '"') {
+            return skipString(pos);
+        }
+        if (_data[pos] == '{' || _data[pos] == '[')
+        {
+            auto depth = 0u;
+            while (pos < size)
+            {
+                const auto c = _data[pos];
+                if (c == '"') {
+                    pos = skipString(pos);
+                    continue;
+                }
+                if (c == '{' || c == '[') {
+                    ++depth;
+                }
+                else if (c == '}' || c == ']') {
+                    if (--depth == 0u) {
+                        return pos + 1u;
+                    }
+                }
+                ++pos;
+            }
+            fail(pos, "unterminated object");
+        }
+        const auto begin = pos;
+        while (pos < size && strchr(",}] \t\r\n", _data[pos]) == nullptr) {
+            ++pos;
+        }
+        if (pos == begin) {
+            fail(pos, "expected a value");
+        }
+        return pos;
+    }
+
+
+    size_t CParserJson::parseString(size_t pos, string& str) const
+    {
+        pos = expect(pos, '"');
+        const auto size = _size;
+        str.clear();
+        while (pos < size)
+        {
+            // copy everything up to the next special character at once
+            auto end = pos;
+            while (end < size && _data[end] != '"' && _data[end] != '\\') {
+                ++end;
+            }
+            str.append(_data + pos, end - pos);
+            pos = end;
+            if (pos >= size) {
+                break;
+            }
+            if (_data[pos] == '"') {
+                return pos + 1u;
+            }
+            // escape sequence
+            if (++pos >= size) {
+                break;
+            }
+            const auto c = _data[pos++];
+            switch (c)
+            {
+            case '"':   str.push_back('"'); break;
+            case '\\':  str.push_back('\\'); break;
+            case '/':   str.push_back('/'); break;
+            case 'b':   str.push_back('\b'); break;
+            case 'f':   str.push_back('\f'); break;
+            case 'n':   str.push_back('\n'); break;
+            case 'r':   str.push_back('\r'); break;
+            case 't':   str.push_back('\t'); break;
+            case 'u':
+            {
+                const auto readHex = [this, size](const size_t idx) {
+                    if (idx + 4u > size) {
+                        fail(idx, "truncated unicode escape");
+                    }
+                    uint32_t value = 0u;
+                    for (auto i = idx; i < idx + 4u; ++i) {
+                        const auto h = _data[i];
+                        value <<= 4;
+                        if (h >= '0' && h <= '9') { value |= static_cast<uint32_t>(h - '0'); }
+                        else if (h >= 'a' && h <= 'f') { value |= static_cast<uint32_t>(h - 'a' + 10); }
+                        else if (h >= 'A' && h <= 'F') { value |= static_cast<uint32_t>(h - 'A' + 10); }
+                        else { fail(i, "invalid unicode escape"); }
+                    }
+                    return value;
+                };
+                auto code_point = readHex(pos);
+                pos += 4u;
+                if (code_point >= 0xD800 && code_point < 0xDC00) { // high surrogate: expecting the low one
+                    if (pos + 6u <= size && _data[pos] == '\\' && _data[pos + 1u] == 'u') {
+                        const auto low = readHex(pos + 2u);
+                        if (low >= 0xDC00 && low < 0xE000) {
+                            code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                            pos += 6u;
+                        }
+                    }
+                }
+                if (code_point >= 0xD800 && code_point < 0xE000) { // lone surrogate
+                    code_point = 0xFFFD;
+                }
+                appendUtf8(str, code_point);
+                break;
+            }
+            default:
+                fail(pos - 1u, "invalid escape sequence");
+            }
+        }
+        fail(size, "unterminated string");
+    }
+
+
+    size_t CParserJson::parseScalar(size_t pos, string& str) const
+    {
+        if (pos < _size && _data[pos] == '"') {
+            return parseString(pos, str);
+        }
+        const auto end = skipValue(pos);
+        str.assign(_data + pos, end - pos);
+        return end;
+    }
+
+
+    size_t CParserJson::parseTime(size_t pos, int64_t& time_ns) const
+    {
+        string time;
+        const auto end = parseScalar(pos, time);
+        try {
+            time_ns = CCollectionInfo::ParseTime(time);
+        }
+        catch (const logic_error&) { // from ParseTime
+            fail(pos, "invalid time " + time);
+        }
+        return end;
+    }
+
+
+
+    ///////////////////////
+
+    size_t CParserJson::parseStrings(size_t pos, map<string, string>& strings) const
+    {
+        pos = skipBlanks(expect(pos, '{'));
+        if (pos < _size && _data[pos] == '}') {
+            return pos + 1u;
+        }
+        while (true)
+        {
+            string key, value;
+            pos = parseString(skipBlanks(pos), key);
+            pos = skipBlanks(expect(skipBlanks(pos), ':'));
+            pos = skipBlanks(parseString(pos, value));
+            strings.emplace_hint(strings.end(), std::move(key), std::move(value));
+            if (pos < _size && _data[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            return expect(pos, '}');
+        }
+    }
+
+
+    /// @details Empty "files" are written as an empty string by the former property_tree based writer.
+    ///          The slices are cut at the first comma separating two members past each *target* position.
+    size_t CParserJson::splitFiles(size_t pos, const unsigned nb_slices, vector<range_t>& slices) const
+    {
+        if (pos < _size && _data[pos] == '"') {
+            return skipString(pos);
+        }
+
+        pos = expect(pos, '{');
+        auto begin = pos;
+        const auto step = max(size_t{ 1u }, (_size - begin) / nb_slices);
+        auto next_cut = begin + step;
+
+        pos = skipBlanks(pos);
+        if (pos < _size && _data[pos] == '}') {
+            return pos + 1u;
+        }
+        while (true)
+        {
+            pos = skipString(skipBlanks(pos));
+            pos = expect(skipBlanks(pos), ':');
+            pos = skipBlanks(skipValue(skipBlanks(pos)));
+            if (pos < _size && _data[pos] == ',')
+            {
+                if (pos >= next_cut && slices.size() + 1u < nb_slices) {
+                    slices.emplace_back(begin, pos);
+                    begin = pos + 1u;
+                    next_cut = pos + step;
+                }
+                ++pos;
+                continue;
+            }
+            if (pos >= _size || _data[pos] != '}') {
+                fail(pos, "expected ',' or '}'");
+            }
+            slices.emplace_back(begin, pos);
+            return pos + 1u;
+        }
+    }
+
+
+    template<typename TCollection>
+    void CParserJson::parseFiles(const range_t& slice, TCollection& collection) const
+    {
+        const auto& KEY_HASH = JSON_KEYS.CONTENT.HASH;
+        const auto& KEY_TIME = JSON_KEYS.CONTENT.TIME;
+        const auto& KEY_SIZE = JSON_KEYS.CONTENT.SIZE;
+
+        string path, key, hash, time, size;
+
+        auto pos = skipBlanks(slice.first);
+        while (pos < slice.second)
+        {
+            pos = parseString(pos, path);
+            pos = expect(skipBlanks(pos), ':');
+            pos = skipBlanks(expect(skipBlanks(pos), '{'));
+            bool has_hash = false, has_time = false, has_size = false;
+            if (pos < slice.second && _data[pos] != '}')
+            {
+                while (true)
+                {
+                    pos = parseString(pos, key);
+                    pos = skipBlanks(expect(skipBlanks(pos), ':'));
+                    if (key == KEY_HASH) {
+                        pos = parseScalar(pos, hash);
+                        has_hash = true;
+                    }
+                    else if (key == KEY_TIME) {
+                        pos = parseScalar(pos, time);
+                        has_time = true;
+                    }
+                    else if (key == KEY_SIZE) {
+                        pos = parseScalar(pos, size);
+                        has_size = true;
+                    }
+                    else {
+                        pos = skipValue(pos);
+                    }
+                    pos = skipBlanks(pos);
+                    if (pos < slice.second && _data[pos] == ',') {
+                        pos = skipBlanks(pos + 1u);
+                        continue;
+                    }
+                    break;
+                }
+            }
+            pos = expect(pos, '}');
+
+            if (!has_hash) { fail(pos, "No such node (" + KEY_HASH + ")"); }
+            if (!has_time) { fail(pos, "No such node (" + KEY_TIME + ")"); }
+            if (!has_size) { fail(pos, "No such node (" + KEY_SIZE + ")"); }
+            try {
+                collection.setInfo(path, { hash, CCollectionInfo::ParseTime(time), static_cast<uintmax_t>(stoull(size)) });
+            }
+            catch (const logic_error&) { // from ParseTime / stoull
+                fail(pos, "invalid number for " + path);
+            }
+
+            pos = skipBlanks(pos);
+            if (pos < slice.second) {
+                pos = skipBlanks(expect(pos, ','));
+            }
+        }
+    }
+
+
+
+    ///////////////////////
+
+    void CParserJson::fail(const size_t pos, const string& what) const
+    {
+        const auto line = 1 + count(_data, _data + min(pos, _size), '\n');
+        throw ExceptionFatal{ "An error occured while parsing " + _path.string() + " : " + what + " (line " + to_string(line) + ")" };
+    }
+
+}
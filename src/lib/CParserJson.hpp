@@ -0,0 +1,124 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+#ifndef _SRC_CParserJson_hpp__
+#define _SRC_CParserJson_hpp__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <memory>
+
+#include <boost/filesystem.hpp>
+
+#include "CCollectionInfo.hpp"
+#include "CCollectionSpill.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace  cf {
+
+    /// @brief Parser of the JSON files produced by ScanFolder
+    /// @details The whole file is mapped, or loaded, in memory. The "files" object is split into *slices*
+    ///          at record boundaries, which are parsed concurrently into partial collections
+    ///          then merged in order.
+    class CParserJson
+    {
+    public:
+        /// @brief Loads the content of the provided JSON file
+        /// @details May throw **ExceptionFatal**
+        explicit CParserJson(const fs::path& json_path);
+        ~CParserJson();
+        CParserJson(const CParserJson&) = delete;
+        void operator=(const CParserJson&) = delete;
+
+        /// @brief Parses the content and returns the resulting collection
+        /// @param nbThreads Maximum number of threads used to parse the files' entries
+        /// @details May throw **ExceptionFatal**
+        CCollectionInfo parse(const unsigned nbThreads) const;
+
+        /// @brief Parses the content into a collection bounded in memory
+        /// @param budget   Memory the entries can use, in bytes
+        /// @param dir_temp Directory receiving the temporary files
+        /// @param filter   Only the files it accepts are added
+        /// @details The digests of the directories are not read. May throw **ExceptionFatal**
+        std::unique_ptr<CCollectionSpill> parse(const std::size_t budget, const fs::path& dir_temp, const CFilter& filter) const;
+
+        /// @brief Parses the content as a delta and applies it to a collection
+        /// @param base   The collection the delta is relative to
+        /// @param digest Digest of the base's root. Receives the digest of the resulting root.
+        /// @details May throw **ExceptionFatal**
+        CCollectionInfo applyDelta(CCollectionInfo&& base, std::string& digest) const;
+
+    private:
+        typedef std::pair<std::size_t, std::size_t> range_t; ///< [begin, end) positions in the buffer
+        /// @brief Members of a collection, besides its files
+        struct header_t {
+            std::string root;
+            eCollectingAlgorithm algo;
+            bool seconds_only;                              ///< Are the fast hashes made of whole seconds?
+            std::int64_t time_scan_ns;                      ///< Time when the scan started. Missing from the former files: 0.
+            bool has_directories;                           ///< Missing from the files written by former versions
+            std::map<std::string, std::string> digests;     ///< Digests of the directories
+            std::map<std::string, std::string> errors;      ///< Files that could not be read
+        };
+
+        /// @brief Parses the members of the collection, splitting the "files" object into slices
+        /// @details Throws if a mandatory member is missing
+        header_t parseHeader(const unsigned nb_slices, std::vector<range_t>& slices) const;
+
+        /// @brief Returns the position of the first non blank character from pos
+        std::size_t skipBlanks(std::size_t pos) const;
+        /// @brief Throws if the character at pos is not the expected one. Returns the following position.
+        std::size_t expect(std::size_t pos, const char c) const;
+        /// @brief Returns the position following the string starting at pos
+        std::size_t skipString(std::size_t pos) const;
+        /// @brief Returns the position following the value starting at pos
+        std::size_t skipValue(std::size_t pos) const;
+        /// @brief Decodes the string starting at pos into UTF-8. Returns the following position.
+        std::size_t parseString(std::size_t pos, std::string& str) const;
+        /// @brief Reads a string or a number starting at pos. Returns the following position.
+        std::size_t parseScalar(std::size_t pos, std::string& str) const;
+        /// @brief Reads a time written by CCollectionInfo::TimeString() starting at pos. Returns the following position.
+        std::size_t parseTime(std::size_t pos, std::int64_t& time_ns) const;
+        /// @brief Skips the "files" object starting at pos, splitting its members into slices
+        /// @returns The position following the object
+        std::size_t splitFiles(std::size_t pos, const unsigned nb_slices, std::vector<range_t>& slices) const;
+        /// @brief Reads an object whose members are strings, such as the directories' digests, starting at pos.
+        /// @returns The position following the object
+        std::size_t parseStrings(std::size_t pos, std::map<std::string, std::string>& strings) const;
+        /// @brief Parses the files' entries contained in a slice, adding them to a collection
+        template<typename TCollection>
+        void parseFiles(const range_t& slice, TCollection& collection) const;
+
+        /// @brief Throws an ExceptionFatal describing a syntax error at pos
+        [[noreturn]] void fail(const std::size_t pos, const std::string& what) const;
+
+        const fs::path _path;   ///< Path of the JSON file
+        const char* _data;      ///< Content of the JSON file
+        std::size_t _size;      ///< Size of the content
+        std::string _buffer;    ///< Content of the JSON file, if it is not mapped
+        void* _mapping;         ///< Mapping of the JSON file, or nullptr
+    };
+
+}
+
+
+#endif /* _SRC_CParserJson_hpp__ */
@@ -0,0 +1,94 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#include <algorithm>
+
+#include "CProgress.hpp"
+
+
+using namespace std;
+
+
+namespace  cf
+{
+
+    CProgress::CProgress(CProxyLogger& logger, const unsigned nbSlots, const chrono::milliseconds period) :
+        _logger(logger),
+        _nbSlots{ max(1u, nbSlots) },
+        _slots{ new counters_t[_nbSlots] },
+        _time_start{ chrono::steady_clock::now() },
+        _period{ period },
+        _stopRequested{ false }
+    {
+        for (auto i = 0u; i < _nbSlots; ++i) {
+            _slots[i].files_enumerated.store(0u, memory_order_relaxed);
+            _slots[i].files_hashed.store(0u, memory_order_relaxed);
+            _slots[i].bytes_hashed.store(0u, memory_order_relaxed);
+            _slots[i].files_compared.store(0u, memory_order_relaxed);
+        }
+
+        if (_period.count() > 0) {
+            _reporter = thread{ [this]
+            {
+                unique_lock<mutex> lock{ _mutex };
+                while (!_condStop.wait_for(lock, _period, [this] { return _stopRequested; })) {
+                    _logger.progress(sample());
+                }
+            } };
+        }
+    }
+
+
+    CProgress::~CProgress()
+    {
+        stop();
+    }
+
+
+
+    ///////////////////////
+
+    progress_t CProgress::sample() const
+    {
+        progress_t progress{ 0u, 0u, 0u, 0u, 0.0 };
+        for (auto i = 0u; i < _nbSlots; ++i) {
+            progress.files_enumerated += _slots[i].files_enumerated.load(memory_order_relaxed);
+            progress.files_hashed += _slots[i].files_hashed.load(memory_order_relaxed);
+            progress.bytes_hashed += _slots[i].bytes_hashed.load(memory_order_relaxed);
+            progress.files_compared += _slots[i].files_compared.load(memory_order_relaxed);
+        }
+        progress.seconds = chrono::duration<double>{ chrono::steady_clock::now() - _time_start }.count();
+        return progress;
+    }
+
+
+    void CProgress::stop()
+    {
+        if (!_reporter.joinable()) {
+            return;
+        }
+        {
+            const lock_guard<mutex> lock{ _mutex };
+            _stopRequested = true;
+        }
+        _condStop.notify_one();
+        _reporter.join();
+        _logger.progress(sample());
+    }
+
+}
@@ -0,0 +1,124 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#ifndef _SRC_CProgress_hpp__
+#define _SRC_CProgress_hpp__
+
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+#include "CompareFolders.hpp"
+#include "CProxyLogger.hpp"
+
+namespace  cf {
+
+    /// @brief Counts the progress of an operation and periodically reports it to a logger
+    /// @details Each thread increments its own counters, never contended:
+    ///          they are only summed by the reporter thread, when sampled.
+    class CProgress
+    {
+    public:
+        /// @brief Counters of a single thread
+        struct counters_t {
+            std::atomic<std::uint64_t> files_enumerated;
+            std::atomic<std::uint64_t> files_hashed;
+            std::atomic<std::uint64_t> bytes_hashed;
+            std::atomic<std::uint64_t> files_compared;
+            char padding[64];   ///< Keeps the counters of different threads on different cache lines
+        };
+
+        /// @brief Starts reporting the progress
+        /// @param logger   Logger receiving the reports
+        /// @param nbSlots  Number of threads that can count concurrently
+        /// @param period   Period of the reports. No report if zero.
+        CProgress(CProxyLogger& logger, const unsigned nbSlots, const std::chrono::milliseconds period);
+        ~CProgress();
+        CProgress(const CProgress&) = delete;
+        void operator=(const CProgress&) = delete;
+
+        /// @brief Returns the counters of a thread
+        /// @param slot Index of the thread, lesser than the number of slots
+        inline counters_t& counters(const unsigned slot) const {
+            return _slots[slot % _nbSlots];
+        }
+
+        /// @brief Sums the counters of all the threads
+        progress_t sample() const;
+
+        /// @brief Stops the reporter thread, after a last report
+        void stop();
+
+    private:
+        CProxyLogger& _logger;
+        const unsigned _nbSlots;
+        const std::unique_ptr<counters_t[]> _slots;                 ///< Counters of each thread
+        const std::chrono::steady_clock::time_point _time_start;    ///< Beginning of the operation
+        const std::chrono::milliseconds _period;                    ///< Period of the reports
+        std::mutex _mutex;
+        std::condition_variable _condStop;                          ///< Wakes the reporter up to be stopped
+        bool _stopRequested;
+        std::thread _reporter;                                      ///< Samples and reports the progress
+    };
+
+
+    /// @brief Counts the files compared, forwarding the differences to another listener
+    class CDiffProgress : public IDiffListener
+    {
+    public:
+        /// @param listener Receives the differences
+        /// @param counters Counters of the thread comparing the files
+        CDiffProgress(IDiffListener& listener, CProgress::counters_t& counters) :
+            _listener(listener),
+            _counters(counters)
+        {   }
+        void identical(const std::string& path) override {
+            _counters.files_compared.fetch_add(1u, std::memory_order_relaxed);
+            _listener.identical(path);
+        }
+        void different(const std::string& path) override {
+            _counters.files_compared.fetch_add(1u, std::memory_order_relaxed);
+            _listener.different(path);
+        }
+        void uniqueLeft(const std::string& path) override {
+            _counters.files_compared.fetch_add(1u, std::memory_order_relaxed);
+            _listener.uniqueLeft(path);
+        }
+        void uniqueRight(const std::string& path) override {
+            _counters.files_compared.fetch_add(1u, std::memory_order_relaxed);
+            _listener.uniqueRight(path);
+        }
+        /// @details Reported once per file renamed on the left: the other files of the group are counted elsewhere, or not at all
+        void renamed(const diff_t::renamed_t& renamed) override {
+            _counters.files_compared.fetch_add(1u, std::memory_order_relaxed);
+            _listener.renamed(renamed);
+        }
+
+    private:
+        IDiffListener& _listener;
+        CProgress::counters_t& _counters;
+    };
+
+}
+
+
+#endif /* _SRC_CProgress_hpp__ */
@@ -2,74 +2,81 @@
 #define _SRC_LOGGERCONCURRENT_HPP__
 
 #include "CompareFolders.hpp"
-#include "TDequeConcurrent.hpp"
+#include "TQueueMpsc.hpp"
 
 #include <string>
+#include <mutex>
 #include <thread>
 
 namespace cf {
 
     /// @brief This class accepts Messages and Error from threads threads and forwards them safely to the concrete logger
+    /// @details The messages are piled in lock free queues: the hashing threads never wait for the logger,
+    ///          unless the queues are full.
     class CProxyLogger
     {
     public:
         /// @details Takes exclusive ownership of loggers
         CProxyLogger(std::unique_ptr<ILogger> loggers) :
             _ptr_loggers{ std::move(loggers) }
-          , _stopRequested{ false }
+        {   }
+        ~CProxyLogger()
         {
-            //_task_messages.detach();
-            //_task_errors.detach();
+            stop();
         }
-        ~CProxyLogger() = default;
 
         /// @brief Sends a message
         inline void message(const std::string& msg) {
-            _queue_messages.emplace_back(msg);
+            _queue_messages.push(std::string{ msg });
         }
         /// @brief Sends an error
         inline void error(const std::string& err) {
-            _queue_errors.emplace_back(err);
+            _queue_errors.push(std::string{ err });
         }
 
+        /// @brief Reports the progress, from the calling thread
+        inline void progress(const progress_t& progress) {
+            const std::lock_guard<std::mutex> lock{ _mutex_logger };
+            _ptr_loggers->progress(progress);
+        }
+
+        /// @brief Forwards the pending messages and errors, then stops the threads
         inline void stop() {
-          _stopRequested.store(true, std::memory_order_release);
-          _queue_messages.stop();
-          _queue_errors.stop();
-          _task_messages.join();          
-          _task_errors.join();
+            _queue_messages.stop();
+            _queue_errors.stop();
+            if (_task_messages.joinable()) {
+                _task_messages.join();
+            }
+            if (_task_errors.joinable()) {
+                _task_errors.join();
+            }
         }
 
     private:
-        TDequeConcurrent<std::string> _queue_messages;  ///< thread safe dequeue used to pile messages to be sent
-        TDequeConcurrent<std::string> _queue_errors;    ///< thread safe dequeue used to pile  errors to be sent
+        TQueueMpsc<std::string> _queue_messages;        ///< lock free queue used to pile messages to be sent
+        TQueueMpsc<std::string> _queue_errors;          ///< lock free queue used to pile errors to be sent
         std::unique_ptr<ILogger> _ptr_loggers;
         std::mutex _mutex_logger;                       ///< the logger may be called from two threads: it needs to be guarded
-        std::atomic_bool _stopRequested;
 
         /// @brief Messages are logged in this thread, to avoid blocking main
         std::thread _task_messages = std::thread{ [this]
         {
-            while (!_stopRequested.load(std::memory_order_relaxed)) {
-                auto message = this->_queue_messages.pop_front(); //blocks until a message is in the list
-                {
-                  if (!message.empty()) {
+            std::string message;
+            while (this->_queue_messages.pop(message)) { //blocks until a message is in the queue
+                if (!message.empty()) {
                     const std::lock_guard<std::mutex> lock{ this->_mutex_logger };
                     _ptr_loggers->message(message);
-                  }
                 }
             }
         } };
         /// @brief Errors are logged in this thread, to avoid blocking main
         std::thread _task_errors = std::thread{ [this]
         {
-            while (!_stopRequested.load(std::memory_order_relaxed)) {
-                auto message = this->_queue_errors.pop_front(); //blocks until a message is in the list
-                {
-                  if (!message.empty()) {
+            std::string message;
+            while (this->_queue_errors.pop(message)) { //blocks until an error is in the queue
+                if (!message.empty()) {
                     const std::lock_guard<std::mutex> lock{ this->_mutex_logger };
                     _ptr_loggers->error(message);
-                  }
                 }
             }
         } };
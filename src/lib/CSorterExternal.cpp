@@ -0,0 +1,254 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#include <cstdint>
+#include <algorithm>
+
+#include "CompareFolders.hpp"
+#include "CSorterExternal.hpp"
+#include "CTrace.hpp"
+
+
+using namespace std;
+
+
+namespace  cf
+{
+
+    static constexpr size_t SIZE_OVERHEAD_RECORD = 96u;  ///< Estimated memory used by a record, besides its strings
+
+    constexpr size_t CSorterExternal::MAX_RUNS_MERGED;
+
+    /// @brief Writes a string to a binary stream, preceded by its length
+    static inline void write(ostream& stream, const string& str)
+    {
+        const auto length = static_cast<uint32_t>(str.size());
+        stream.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        stream.write(str.data(), static_cast<streamsize>(str.size()));
+    }
+
+    /// @brief Reads a string preceded by its length from a binary stream
+    static inline bool read(istream& stream, string& str)
+    {
+        uint32_t length;
+        if (!stream.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+            return false;
+        }
+        str.resize(length);
+        return length == 0u || static_cast<bool>(stream.read(&str[0], length));
+    }
+
+    /// @brief Reads the next record of a run. Returns false at the end of the run.
+    static bool read_record(istream& stream, CSorterExternal::record_t& record, const fs::path& path_run)
+    {
+        if (!read(stream, record.first)) {
+            if (stream.eof() && stream.gcount() == 0) {
+                return false;
+            }
+            throw ExceptionFatal{ "Cannot read the temporary file " + path_run.string() };
+        }
+        if (!read(stream, record.second)) {
+            throw ExceptionFatal{ "Cannot read the temporary file " + path_run.string() };
+        }
+        return true;
+    }
+
+
+
+    ///////////////////////
+
+    CSorterExternal::CSorterExternal(const size_t budget, const fs::path& dir_temp) :
+        _budget{ budget },
+        _dir_temp{ dir_temp },
+        _sorted{ true },
+        _size_records{ 0u },
+        _peak{ 0u },
+        _size{ 0u }
+    {   }
+
+
+    CSorterExternal::~CSorterExternal()
+    {
+        for (const auto& run : _runs) {
+            boost::system::error_code error;
+            fs::remove(run, error);
+        }
+    }
+
+
+
+    ///////////////////////
+
+    void CSorterExternal::add(string key, string value)
+    {
+        _size_records += SIZE_OVERHEAD_RECORD + key.size() + value.size();
+        _records.emplace_back(std::move(key), std::move(value));
+        _sorted = false;
+        ++_size;
+        if (_budget != 0u && _size_records > _budget) {
+            spill();
+        }
+        _peak = max(_peak, _size_records);
+    }
+
+
+    void CSorterExternal::release()
+    {
+        if (!_records.empty()) {
+            spill();
+        }
+    }
+
+
+    void CSorterExternal::spill()
+    {
+        const CTrace::CSpan span{ "sort run" };
+        stable_sort(_records.begin(), _records.end(), [](const record_t& lhs, const record_t& rhs) {
+            return lhs.first < rhs.first;
+        });
+        const auto path_run = fs::unique_path(_dir_temp / "compare_folders-%%%%-%%%%-%%%%-%%%%.run");
+        _runs.push_back(path_run); // removed by the destructor, even if partially written
+        {
+            fs::ofstream stream{ path_run, ios_base::out | ios_base::binary | ios_base::trunc };
+            for (const auto& record : _records) {
+                write(stream, record.first);
+                write(stream, record.second);
+            }
+            if (!stream.flush()) {
+                throw ExceptionFatal{ "Cannot write the temporary file " + path_run.string() };
+            }
+        }
+        vector<record_t>{}.swap(_records); // releases the memory
+        _sorted = true;
+        _size_records = 0u;
+    }
+
+
+    /// @details If some records were spilled, the remaining ones are spilled too:
+    ///          the reader only merges runs.
+    CSorterExternal::CReader CSorterExternal::read()
+    {
+        if (_runs.empty()) {
+            if (!_sorted) {
+                stable_sort(_records.begin(), _records.end(), [](const record_t& lhs, const record_t& rhs) {
+                    return lhs.first < rhs.first;
+                });
+                _sorted = true;
+            }
+            return CReader{ &_records };
+        }
+        if (!_records.empty()) {
+            spill();
+        }
+        merge();
+        return CReader{ _runs.cbegin(), _runs.cend() };
+    }
+
+
+    void CSorterExternal::merge()
+    {
+        while (_runs.size() > MAX_RUNS_MERGED)
+        {
+            const CTrace::CSpan span{ "merge runs" };
+            auto first = _runs.begin();
+            while (first != _runs.end())
+            {
+                auto last = first;
+                for (auto i = 0u; i < MAX_RUNS_MERGED && last != _runs.end(); ++i) {
+                    ++last;
+                }
+                if (next(first) == last) { // a single run is left
+                    break;
+                }
+                const auto path_run = fs::unique_path(_dir_temp / "compare_folders-%%%%-%%%%-%%%%-%%%%.run");
+                _runs.insert(first, path_run); // removed by the destructor, even if partially written
+                {
+                    CReader reader{ first, last };
+                    fs::ofstream stream{ path_run, ios_base::out | ios_base::binary | ios_base::trunc };
+                    record_t record;
+                    while (reader.next(record)) {
+                        write(stream, record.first);
+                        write(stream, record.second);
+                    }
+                    if (!stream.flush()) {
+                        throw ExceptionFatal{ "Cannot write the temporary file " + path_run.string() };
+                    }
+                }
+                while (first != last) {
+                    boost::system::error_code error;
+                    fs::remove(*first, error);
+                    first = _runs.erase(first);
+                }
+            }
+        }
+    }
+
+
+
+    ///////////////////////
+
+    CSorterExternal::CReader::CReader(const vector<record_t>* records) :
+        _records{ records },
+        _idx{ 0u }
+    {   }
+
+
+    CSorterExternal::CReader::CReader(list<fs::path>::const_iterator first, const list<fs::path>::const_iterator last) :
+        _records{ nullptr },
+        _idx{ 0u }
+    {
+        for (; first != last; ++first)
+        {
+            const auto& run = *first;
+            _streams.emplace_back(make_unique<fs::ifstream>(run, ios_base::in | ios_base::binary));
+            _paths.push_back(run);
+            if (!*_streams.back()) {
+                throw ExceptionFatal{ "Cannot read the temporary file " + run.string() };
+            }
+            record_t record;
+            if (read_record(*_streams.back(), record, run)) {
+                _heads.emplace(std::move(record), _streams.size() - 1u);
+            }
+        }
+    }
+
+
+    bool CSorterExternal::CReader::next(record_t& record)
+    {
+        if (_records != nullptr) {
+            if (_idx >= _records->size()) {
+                return false;
+            }
+            record = (*_records)[_idx++];
+            return true;
+        }
+
+        if (_heads.empty()) {
+            return false;
+        }
+        auto head = _heads.top();
+        _heads.pop();
+        record = head.first;
+        const auto idx = head.second;
+        if (read_record(*_streams[idx], head.first, _paths[idx])) {
+            _heads.push(std::move(head));
+        }
+        return true;
+    }
+
+}
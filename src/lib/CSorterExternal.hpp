@@ -0,0 +1,145 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#ifndef _SRC_CSorterExternal_hpp__
+#define _SRC_CSorterExternal_hpp__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <list>
+#include <queue>
+#include <memory>
+#include <utility>
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+namespace fs = boost::filesystem;
+
+namespace  cf {
+
+    /// @brief Sorts records by key, using temporary files when they do not fit in memory
+    /// @details The records are kept in memory until they exceed the budget.
+    ///          They are then sorted and written to a temporary file (a *run*), and the memory is released.
+    ///          The runs are merged while the records are read. Beyond MAX_RUNS_MERGED runs, they are first merged
+    ///          by groups into longer runs, so that the files opened at once stay bounded.
+    ///          The sort is stable: records with the same key are read in the order they were added.
+    ///          The operations are **not** thread safe.
+    class CSorterExternal
+    {
+    public:
+        typedef std::pair<std::string, std::string> record_t;   ///< key and value
+
+        static constexpr std::size_t MAX_RUNS_MERGED = 64u;     ///< Maximum number of runs merged at once
+
+        /// @brief Reads the sorted records
+        /// @details Only the current record of each run is held in memory
+        class CReader
+        {
+        public:
+            CReader(CReader&&) = default;
+            CReader& operator=(CReader&&) = default;
+
+            /// @brief Reads the next record. Returns false once all the records were read.
+            /// @details May throw **ExceptionFatal** if a run cannot be read
+            bool next(record_t& record);
+
+        private:
+            friend class CSorterExternal;
+            /// @brief Reads the records held in memory
+            explicit CReader(const std::vector<record_t>* records);
+            /// @brief Merges the runs in [first, last)
+            CReader(std::list<fs::path>::const_iterator first, const std::list<fs::path>::const_iterator last);
+
+            typedef std::pair<record_t, std::size_t> head_t;    ///< Current record of a run, and the run's index
+            /// @brief Orders the heads for a min-heap, the first run first for equal keys
+            struct isAfter_t {
+                bool operator()(const head_t& lhs, const head_t& rhs) const {
+                    return lhs.first.first != rhs.first.first ? lhs.first.first > rhs.first.first : lhs.second > rhs.second;
+                }
+            };
+
+            const std::vector<record_t>* _records;  ///< Records held in memory, if there is no run
+            std::size_t _idx;                       ///< Next record held in memory
+            std::vector<std::unique_ptr<fs::ifstream>> _streams;
+            std::vector<fs::path> _paths;
+            std::priority_queue<head_t, std::vector<head_t>, isAfter_t> _heads;
+        };
+
+        /// @param budget   Memory the records can use, in bytes. Unbounded if 0.
+        /// @param dir_temp Directory receiving the runs
+        CSorterExternal(const std::size_t budget, const fs::path& dir_temp);
+        ~CSorterExternal();
+        CSorterExternal(const CSorterExternal&) = delete;
+        void operator=(const CSorterExternal&) = delete;
+
+        /// @brief Returns the number of records
+        inline std::size_t size() const {
+            return _size;
+        }
+
+        /// @brief Returns the number of runs written to disk
+        inline std::size_t runs() const {
+            return _runs.size();
+        }
+
+        /// @brief Returns the estimated memory used by the records held in memory, in bytes
+        inline std::size_t memory() const {
+            return _size_records;
+        }
+
+        /// @brief Returns the peak of memory(), once each record added was possibly spilled
+        inline std::size_t peak() const {
+            return _peak;
+        }
+
+        /// @brief Adds a record
+        /// @details May throw **ExceptionFatal** if a run cannot be written
+        void add(std::string key, std::string value);
+
+        /// @brief Writes the records held in memory to a run, releasing their memory
+        /// @details May throw **ExceptionFatal** if the run cannot be written
+        void release();
+
+        /// @brief Returns a reader of the records sorted by key
+        /// @details No record shall be added while reading. May throw **ExceptionFatal**
+        CReader read();
+
+    private:
+        /// @brief Writes the records held in memory to a new run
+        void spill();
+
+        /// @brief Merges consecutive runs by groups of MAX_RUNS_MERGED, until they are few enough to be merged at once
+        /// @details The merged run takes the place of its group: the sort remains stable.
+        void merge();
+
+        const std::size_t _budget;              ///< Maximum memory used by the records
+        const fs::path _dir_temp;               ///< Directory receiving the runs
+        std::vector<record_t> _records;         ///< Records not spilled yet
+        bool _sorted;                           ///< Are the records held in memory sorted?
+        std::size_t _size_records;              ///< Estimated memory used by the records
+        std::size_t _peak;                      ///< Peak of _size_records
+        std::size_t _size;                      ///< Number of records, spilled or not
+        std::list<fs::path> _runs;              ///< Temporary files holding the spilled records, each one sorted
+    };
+
+}
+
+
+#endif /* _SRC_CSorterExternal_hpp__ */
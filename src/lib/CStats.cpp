@@ -0,0 +1,181 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#include <chrono>
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+#include "CStats.hpp"
+
+
+using namespace std;
+
+
+namespace  cf
+{
+
+    /// @brief Returns the CPU time consumed by the calling thread or by the whole process, in nanoseconds
+    static int64_t cpu_ns(const bool thread)
+    {
+#ifdef _WIN32
+        FILETIME creation, exit, kernel, user;
+        const auto ok = thread ?
+            GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user) :
+            GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+        if (!ok) {
+            return 0;
+        }
+        const auto ticks = [](const FILETIME& time) { // 100 ns
+            return (static_cast<int64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+        };
+        return (ticks(kernel) + ticks(user)) * 100;
+#else
+        timespec time;
+        if (clock_gettime(thread ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID, &time) != 0) {
+            return 0;
+        }
+        return static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+#endif
+    }
+
+
+    /// @brief Returns the elapsed time on a monotonic clock, in nanoseconds
+    static inline int64_t wall_ns()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+
+    /// @brief Returns the peak resident memory of the process, in bytes. 0 if unknown.
+    static uint64_t memory_peak()
+    {
+#ifdef _WIN32
+        return 0u;
+#else
+        rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0u;
+        }
+#ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss);          // bytes
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024u;  // kilobytes
+#endif
+#endif
+    }
+
+
+    /// @brief The phases run by the hashing threads measure the CPU of the calling thread
+    static inline bool is_threaded(const ePhase phase)
+    {
+        return phase == ePhase::ENUMERATING || phase == ePhase::STATTING || phase == ePhase::READING || phase == ePhase::HASHING;
+    }
+
+
+
+    ///////////////////////
+
+    CStats::CStats(shared_ptr<stats_t> stats) :
+        _stats{ std::move(stats) },
+        _files_hashed{ 0u },
+        _bytes_hashed{ 0u },
+        _files_compared{ 0u },
+        _operations{ 0u },
+        _cache_hits{ 0u }
+    {
+        for (auto i = 0u; i < static_cast<unsigned>(ePhase::NB_PHASES); ++i) {
+            _wall_ns[i].store(0, memory_order_relaxed);
+            _cpu_ns[i].store(0, memory_order_relaxed);
+        }
+    }
+
+
+    CStats::~CStats()
+    {
+        if (!enabled()) {
+            return;
+        }
+        time_phase_t* const phases[] = {
+            &_stats->enumerating, &_stats->statting, &_stats->reading, &_stats->hashing,
+            &_stats->parsing, &_stats->comparing, &_stats->serializing, &_stats->total
+        };
+        for (auto i = 0u; i < static_cast<unsigned>(ePhase::NB_PHASES); ++i) {
+            phases[i]->wall += static_cast<double>(_wall_ns[i].load(memory_order_relaxed)) * 1e-9;
+            phases[i]->cpu += static_cast<double>(_cpu_ns[i].load(memory_order_relaxed)) * 1e-9;
+        }
+        _stats->files_hashed += _files_hashed.load(memory_order_relaxed);
+        _stats->bytes_hashed += _bytes_hashed.load(memory_order_relaxed);
+        _stats->files_compared += _files_compared.load(memory_order_relaxed);
+        _stats->operations += _operations.load(memory_order_relaxed);
+        _stats->cache_hits += _cache_hits.load(memory_order_relaxed);
+        _stats->memory_peak = max(_stats->memory_peak, memory_peak());
+    }
+
+
+    void CStats::add(const ePhase phase, const int64_t wall_ns, const int64_t cpu_ns)
+    {
+        const auto i = static_cast<unsigned>(phase);
+        _wall_ns[i].fetch_add(wall_ns, memory_order_relaxed);
+        _cpu_ns[i].fetch_add(cpu_ns, memory_order_relaxed);
+    }
+
+
+
+    ///////////////////////
+
+    CStats::CTimer::CTimer(CStats& stats, const ePhase phase) :
+        _stats(stats),
+        _phase{ phase },
+        _running{ false },
+        _start_wall_ns{ 0 },
+        _start_cpu_ns{ 0 }
+    {
+        start();
+    }
+
+
+    CStats::CTimer::~CTimer()
+    {
+        stop();
+    }
+
+
+    void CStats::CTimer::start()
+    {
+        if (_stats.enabled() && !_running) {
+            _running = true;
+            _start_wall_ns = wall_ns();
+            _start_cpu_ns = cpu_ns(is_threaded(_phase));
+        }
+    }
+
+
+    void CStats::CTimer::stop()
+    {
+        if (_running) {
+            _running = false;
+            _stats.add(_phase, wall_ns() - _start_wall_ns, cpu_ns(is_threaded(_phase)) - _start_cpu_ns);
+        }
+    }
+
+}
@@ -0,0 +1,169 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#ifndef _SRC_CStats_hpp__
+#define _SRC_CStats_hpp__
+
+#include <cstdint>
+#include <memory>
+#include <atomic>
+
+#include "CompareFolders.hpp"
+
+namespace  cf {
+
+    /// @brief Phases of an operation, as reported in stats_t
+    enum class ePhase {
+        ENUMERATING,
+        STATTING,
+        READING,
+        HASHING,
+        PARSING,
+        COMPARING,
+        SERIALIZING,
+        TOTAL,
+        NB_PHASES
+    };
+
+
+    /// @brief Measures the statistics of an operation
+    /// @details The measures are accumulated from any thread, then added to the stats_t when destroyed.
+    ///          Nothing is measured if no stats_t is provided: the clocks are not even read.
+    class CStats
+    {
+    public:
+        /// @param stats Receives the statistics. May be null.
+        explicit CStats(std::shared_ptr<stats_t> stats);
+        ~CStats();
+        CStats(const CStats&) = delete;
+        void operator=(const CStats&) = delete;
+
+        /// @brief Returns true if the statistics are measured
+        inline bool enabled() const {
+            return _stats != nullptr;
+        }
+
+        /// @brief Counts some files collected
+        inline void addFiles(const std::uint64_t files) {
+            if (enabled()) {
+                _files_hashed.fetch_add(files, std::memory_order_relaxed);
+            }
+        }
+        /// @brief Counts some bytes read to hash the files
+        inline void addBytes(const std::uint64_t bytes) {
+            if (enabled()) {
+                _bytes_hashed.fetch_add(bytes, std::memory_order_relaxed);
+            }
+        }
+        /// @brief Counts some files compared
+        inline void addCompared(const std::uint64_t files) {
+            if (enabled()) {
+                _files_compared.fetch_add(files, std::memory_order_relaxed);
+            }
+        }
+        /// @brief Counts some estimated operations on the filesystem
+        inline void addOperations(const std::uint64_t operations) {
+            if (enabled()) {
+                _operations.fetch_add(operations, std::memory_order_relaxed);
+            }
+        }
+        /// @brief Counts some hashes that were not computed
+        inline void addCacheHits(const std::uint64_t hits) {
+            if (enabled()) {
+                _cache_hits.fetch_add(hits, std::memory_order_relaxed);
+            }
+        }
+
+
+        /// @brief Measures the time spent in a phase, from the calling thread, until stopped or destroyed
+        /// @details Can be paused and resumed: all the periods are added.
+        class CTimer
+        {
+        public:
+            CTimer(CStats& stats, const ePhase phase);
+            ~CTimer();
+            CTimer(const CTimer&) = delete;
+            void operator=(const CTimer&) = delete;
+
+            /// @brief Starts a new period
+            void start();
+            /// @brief Ends the current period, if any
+            void stop();
+
+        private:
+            CStats& _stats;
+            const ePhase _phase;
+            bool _running;
+            std::int64_t _start_wall_ns;
+            std::int64_t _start_cpu_ns;
+        };
+
+    private:
+        /// @brief Adds a period to a phase
+        void add(const ePhase phase, const std::int64_t wall_ns, const std::int64_t cpu_ns);
+
+        const std::shared_ptr<stats_t> _stats;
+        std::atomic<std::int64_t> _wall_ns[static_cast<unsigned>(ePhase::NB_PHASES)];
+        std::atomic<std::int64_t> _cpu_ns[static_cast<unsigned>(ePhase::NB_PHASES)];
+        std::atomic<std::uint64_t> _files_hashed;
+        std::atomic<std::uint64_t> _bytes_hashed;
+        std::atomic<std::uint64_t> _files_compared;
+        std::atomic<std::uint64_t> _operations;
+        std::atomic<std::uint64_t> _cache_hits;
+    };
+
+
+    /// @brief Counts the files compared in the statistics, forwarding the differences to another listener
+    class CDiffStats : public IDiffListener
+    {
+    public:
+        CDiffStats(IDiffListener& listener, CStats& stats) :
+            _listener(listener),
+            _stats(stats)
+        {   }
+        void identical(const std::string& path) override {
+            _stats.addCompared(1u);
+            _listener.identical(path);
+        }
+        void different(const std::string& path) override {
+            _stats.addCompared(1u);
+            _listener.different(path);
+        }
+        void uniqueLeft(const std::string& path) override {
+            _stats.addCompared(1u);
+            _listener.uniqueLeft(path);
+        }
+        void uniqueRight(const std::string& path) override {
+            _stats.addCompared(1u);
+            _listener.uniqueRight(path);
+        }
+        /// @details Reported once per file renamed on the left: the other files of the group are counted elsewhere, or not at all
+        void renamed(const diff_t::renamed_t& renamed) override {
+            _stats.addCompared(1u);
+            _listener.renamed(renamed);
+        }
+
+    private:
+        IDiffListener& _listener;
+        CStats& _stats;
+    };
+
+}
+
+
+#endif /* _SRC_CStats_hpp__ */
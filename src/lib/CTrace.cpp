@@ -0,0 +1,225 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdio>
+
+#include <boost/filesystem/fstream.hpp>
+
+#include "Utilities.hpp"
+#include "CTrace.hpp"
+
+
+using namespace std;
+
+
+namespace  cf
+{
+
+    /// @brief A span recorded
+    struct event_t {
+        const char* name;
+        int64_t start_ns;
+        int64_t end_ns;
+    };
+
+    /// @brief Spans recorded by a thread
+    struct buffer_t {
+        mutex mutex_events;     ///< Only contended when the trace is written
+        vector<event_t> events;
+        string name;            ///< Name of the thread
+        unsigned tid;           ///< Id of the thread in the trace
+        bool closed;            ///< Was the trace written?
+    };
+
+    /// @brief State of the recording, shared by all the threads
+    struct recorder_t {
+        mutex mutex_buffers;                    ///< Protects the buffers and the beginning of the recording
+        vector<shared_ptr<buffer_t>> buffers;   ///< Buffers of the threads recording
+        atomic<uint64_t> generation{ 0u };      ///< Incremented by each recording: outdated buffers are replaced
+        int64_t start_ns = 0;                   ///< Beginning of the recording
+    };
+
+    static recorder_t& recorder()
+    {
+        static recorder_t recorder;
+        return recorder;
+    }
+
+    /// @brief Buffer of the calling thread and the recording it belongs to
+    static thread_local shared_ptr<buffer_t> Buffer;
+    static thread_local uint64_t Generation = 0u;
+
+
+    /// @brief Returns the buffer of the calling thread for the current recording
+    static buffer_t& buffer_thread()
+    {
+        auto& rec = recorder();
+        const auto generation = rec.generation.load(memory_order_acquire);
+        if (!Buffer || Generation != generation) {
+            auto buffer = make_shared<buffer_t>();
+            buffer->closed = false;
+            const lock_guard<mutex> lock{ rec.mutex_buffers };
+            buffer->tid = static_cast<unsigned>(rec.buffers.size()) + 1u;
+            rec.buffers.push_back(buffer);
+            Buffer = std::move(buffer);
+            Generation = generation;
+        }
+        return *Buffer;
+    }
+
+
+    /// @brief Appends a time in microseconds, as expected by the format
+    static void append_us(string& json, const int64_t ns)
+    {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%lld.%03lld", static_cast<long long>(ns / 1000), static_cast<long long>(ns % 1000));
+        json += buffer;
+    }
+
+
+
+    ///////////////////////
+
+    atomic_bool CTrace::_recording{ false };
+
+
+    CTrace::CTrace(const string& path) :
+        _path{ path },
+        _owner{ false }
+    {
+        if (_path.empty()) {
+            return;
+        }
+        {
+            auto& rec = recorder();
+            const lock_guard<mutex> lock{ rec.mutex_buffers };
+            if (_recording.load(memory_order_relaxed)) { // another trace is recording
+                return;
+            }
+            rec.buffers.clear();
+            rec.generation.fetch_add(1u, memory_order_release);
+            rec.start_ns = Now();
+            _recording.store(true, memory_order_release);
+            _owner = true;
+        }
+        NameThread("caller");
+    }
+
+
+    CTrace::~CTrace()
+    {
+        if (!_owner) {
+            return;
+        }
+        try {
+            write();
+        }
+        catch (...) {
+        }
+    }
+
+
+
+    ///////////////////////
+
+    int64_t CTrace::Now()
+    {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+
+    void CTrace::NameThread(const string& name)
+    {
+        if (!Recording()) {
+            return;
+        }
+        auto& buffer = buffer_thread();
+        const lock_guard<mutex> lock{ buffer.mutex_events };
+        buffer.name = name;
+    }
+
+
+    /// @details A span ending after the trace was written is dropped.
+    void CTrace::Record(const char* name, const int64_t start_ns, const int64_t end_ns)
+    {
+        if (!Recording()) {
+            return;
+        }
+        auto& buffer = buffer_thread();
+        const lock_guard<mutex> lock{ buffer.mutex_events };
+        if (!buffer.closed) {
+            buffer.events.push_back({ name, start_ns, end_ns });
+        }
+    }
+
+
+
+    ///////////////////////
+
+    /// @details Stops the recording. The buffers are closed then released: the threads still holding them stop recording into them.
+    void CTrace::write() const
+    {
+        auto& rec = recorder();
+        vector<shared_ptr<buffer_t>> buffers;
+        int64_t start_ns;
+        {
+            const lock_guard<mutex> lock{ rec.mutex_buffers };
+            _recording.store(false, memory_order_release);
+            buffers.swap(rec.buffers);
+            start_ns = rec.start_ns;
+        }
+
+        string json{ "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" };
+        auto first = true;
+        for (const auto& buffer : buffers)
+        {
+            const lock_guard<mutex> lock{ buffer->mutex_events };
+            buffer->closed = true;
+            const auto tid = to_string(buffer->tid);
+            if (!buffer->name.empty()) {
+                json += first ? "\n" : ",\n";
+                first = false;
+                json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid + ",\"args\":{\"name\":";
+                AppendJsonString(json, buffer->name);
+                json += "}}";
+            }
+            for (const auto& event : buffer->events) {
+                json += first ? "\n" : ",\n";
+                first = false;
+                json += "{\"name\":\"";
+                json += event.name;
+                json += "\",\"cat\":\"compare_folders\",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid + ",\"ts\":";
+                append_us(json, event.start_ns - start_ns);
+                json += ",\"dur\":";
+                append_us(json, event.end_ns - event.start_ns);
+                json += '}';
+            }
+            buffer->events.clear();
+            buffer->events.shrink_to_fit();
+        }
+        json += "\n]}\n";
+
+        fs::ofstream stream{ ToPath(_path), ios::out | ios::binary };
+        stream << json;
+    }
+
+}
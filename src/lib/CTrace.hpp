@@ -0,0 +1,107 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#ifndef _SRC_CTrace_hpp__
+#define _SRC_CTrace_hpp__
+
+#include <cstdint>
+#include <string>
+#include <atomic>
+
+namespace  cf {
+
+    /// @brief Records what each thread is doing over time, as a Chrome trace
+    /// @details Recording starts when a CTrace is built with a path and stops when it is destroyed:
+    ///          the spans recorded meanwhile by all the threads are then written as *Trace Event* JSON,
+    ///          to be opened in chrome://tracing or Perfetto.
+    ///          Each thread records into its own buffer, never contended but by the final write.
+    ///          Only one trace is recorded at a time: the traces built while another one is recording are ignored.
+    ///          When no trace is recording, a span costs a relaxed atomic load.
+    class CTrace
+    {
+    public:
+        /// @param path Path of the JSON file to write. Nothing is recorded if empty.
+        explicit CTrace(const std::string& path);
+        /// @details Writes the file. A trace that cannot be written is lost.
+        ~CTrace();
+        CTrace(const CTrace&) = delete;
+        void operator=(const CTrace&) = delete;
+
+        /// @brief Returns true if a trace is recording
+        static inline bool Recording() {
+            return _recording.load(std::memory_order_relaxed);
+        }
+
+        /// @brief Names the calling thread in the trace
+        static void NameThread(const std::string& name);
+
+
+        /// @brief A span of time of the calling thread, recorded until stopped or destroyed
+        /// @details Can be stopped and started again: each period is a span of its own.
+        class CSpan
+        {
+        public:
+            /// @param name Name of the span. Shall outlive the trace: a string literal.
+            explicit CSpan(const char* name) :
+                _name{ name },
+                _start_ns{ -1 }
+            {
+                start();
+            }
+            ~CSpan() {
+                stop();
+            }
+            CSpan(const CSpan&) = delete;
+            void operator=(const CSpan&) = delete;
+
+            /// @brief Starts a new period
+            inline void start() {
+                if (Recording() && _start_ns < 0) {
+                    _start_ns = Now();
+                }
+            }
+            /// @brief Records the current period, if any
+            inline void stop() {
+                if (_start_ns >= 0) {
+                    Record(_name, _start_ns, Now());
+                    _start_ns = -1;
+                }
+            }
+
+        private:
+            const char* const _name;
+            std::int64_t _start_ns;     ///< Beginning of the current period. Negative if none.
+        };
+
+    private:
+        /// @brief Returns the time elapsed on a monotonic clock, in nanoseconds
+        static std::int64_t Now();
+        /// @brief Adds a span to the buffer of the calling thread
+        static void Record(const char* name, const std::int64_t start_ns, const std::int64_t end_ns);
+        /// @brief Stops the recording and writes the spans recorded
+        void write() const;
+
+        static std::atomic_bool _recording;     ///< Is a trace recording?
+        const std::string _path;
+        bool _owner;                            ///< Did this instance start the recording?
+    };
+
+}
+
+
+#endif /* _SRC_CTrace_hpp__ */
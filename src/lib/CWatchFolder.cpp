@@ -0,0 +1,384 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+#include <cerrno>
+#include <cstring>
+#include <set>
+#include <list>
+#include <utility>
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+#include <boost/version.hpp>
+
+#include "Utilities.hpp"
+#include "CWatchFolder.hpp"
+
+
+using namespace std;
+
+
+namespace  cf
+{
+
+#ifdef __linux__
+
+    /// @brief Events watched in every directory
+    static constexpr uint32_t MASK_EVENTS = IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+    /// @brief Returns true if nothing exists anymore at this path. False if its status cannot be read either.
+    static bool is_removed(const fs::path& path)
+    {
+        boost::system::error_code error;
+        return !fs::exists(path, error) && !error;
+    }
+
+
+    ///////////////////////
+
+    CWatchFolder::CWatchFolder(const fs::path& root, unique_ptr<AFactoryInfo> factory) :
+        _root{ root },
+        _length_root{ root.native().size() },
+        _factory{ std::move(factory) },
+        _changes{ 0u }
+    {
+        _fd_events = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_fd_events < 0) {
+            throw ExceptionFatal{ string{ "Cannot watch the filesystem: " } + strerror(errno) };
+        }
+        if (pipe2(_fd_stop, O_CLOEXEC) != 0) {
+            close(_fd_events);
+            throw ExceptionFatal{ string{ "Cannot watch the filesystem: " } + strerror(errno) };
+        }
+
+        // Watching before scanning: no modification can be missed
+        try {
+            watch(_root);
+            _collection = make_unique<CCollectionInfo>(_factory->collectInfo(_root));
+            _factory->ignoreCancellation(); // Only the first scan is bounded: the events are applied as long as the watcher lives
+        }
+        catch (...) {
+            close(_fd_events);
+            close(_fd_stop[0]);
+            close(_fd_stop[1]);
+            throw;
+        }
+
+        _thread = thread{ [this]
+        {
+            while (true)
+            {
+                pollfd fds[2] = { { _fd_events, POLLIN, 0 }, { _fd_stop[0], POLLIN, 0 } };
+                if (poll(fds, 2, -1) < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    _factory->logger().error(string{ "Cannot watch the filesystem: " } + strerror(errno));
+                    return;
+                }
+                if (fds[1].revents != 0) {
+                    return;
+                }
+                try {
+                    process();
+                }
+                catch (const exception& e) {
+                    _factory->logger().error(e.what());
+                }
+            }
+        } };
+    }
+
+
+    CWatchFolder::~CWatchFolder()
+    {
+        const char stop = 0;
+        while (write(_fd_stop[1], &stop, 1u) < 0 && errno == EINTR) {}
+        _thread.join();
+        close(_fd_events);
+        close(_fd_stop[0]);
+        close(_fd_stop[1]);
+    }
+
+
+
+    ///////////////////////
+
+    void CWatchFolder::watch(const fs::path& directory)
+    {
+        const auto add = [this](const fs::path& path) {
+            const auto wd = inotify_add_watch(_fd_events, path.c_str(), MASK_EVENTS);
+            if (wd < 0) {
+                _factory->logger().error("Cannot watch " + ToUtf8(path) + ": " + strerror(errno));
+                return;
+            }
+            _directories[wd] = RelativeUtf8(path, _length_root);
+        };
+
+        const auto& filter = _factory->filter();
+        try {
+            add(directory);
+            // Symbolic links are not followed and the excluded directories are skipped, as when listing the files
+            for (fs::recursive_directory_iterator it{ directory }, end; it != end; ++it) {
+                if (fs::is_directory(it->symlink_status())) {
+                    if (filter.isExcluded(RelativeUtf8(it->path(), _length_root), true)) {
+#if BOOST_VERSION >= 107200
+                        it.disable_recursion_pending();
+#else
+                        it.no_push();
+#endif
+                        continue;
+                    }
+                    add(it->path());
+                }
+            }
+        }
+        catch (const fs::filesystem_error& e) {
+            _factory->logger().error(string{ "Filesystem error: " } + e.what());
+        }
+    }
+
+
+    void CWatchFolder::unwatch(const string& directory)
+    {
+        for (auto watched = _directories.begin(); watched != _directories.end(); )
+        {
+            const auto& path = watched->second;
+            const auto isInside = directory.empty() || path == directory ||
+                (path.size() > directory.size() && path[directory.size()] == '/' && path.compare(0u, directory.size(), directory) == 0);
+            if (isInside) {
+                inotify_rm_watch(_fd_events, watched->first);
+                watched = _directories.erase(watched);
+            }
+            else {
+                ++watched;
+            }
+        }
+    }
+
+
+
+    ///////////////////////
+
+    /// @details Some events were lost: nothing can be trusted anymore.
+    void CWatchFolder::rescan()
+    {
+        _factory->logger().message("Too many changes: scanning " + ToUtf8(_root) + " again\n");
+        unwatch(string{});
+        watch(_root);
+        auto collection = make_unique<CCollectionInfo>(_factory->collectInfo(_root));
+        const lock_guard<mutex> lock{ _mutex };
+        _collection = std::move(collection);
+        _changes.fetch_add(1u, memory_order_acq_rel);
+    }
+
+
+    /// @details A file modified several times is hashed only once per batch of events:
+    ///          all the events of a batch occured before the file is hashed.
+    void CWatchFolder::process()
+    {
+        alignas(inotify_event) char buffer[64u * 1024u];
+        while (true)
+        {
+            const auto length = read(_fd_events, buffer, sizeof(buffer));
+            if (length < 0 && errno == EINTR) {
+                continue;
+            }
+            if (length <= 0) { // EAGAIN: no more events
+                return;
+            }
+
+            set<string> updated;
+            for (auto ptr = buffer; ptr < buffer + length; )
+            {
+                const auto event = reinterpret_cast<const inotify_event*>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+
+                if ((event->mask & IN_Q_OVERFLOW) != 0u) {
+                    rescan();
+                    break;
+                }
+                const auto watched = _directories.find(event->wd);
+                if (watched == _directories.end()) {
+                    continue;
+                }
+                if ((event->mask & IN_IGNORED) != 0u) { // The directory was removed
+                    _directories.erase(watched);
+                    continue;
+                }
+                if (event->len == 0u) { // Event concerning the watched directory itself
+                    continue;
+                }
+
+                const string name{ event->name };
+                auto path = watched->second.empty() ? name : watched->second + '/' + name;
+                if ((event->mask & IN_ISDIR) != 0u) {
+                    if ((event->mask & (IN_CREATE | IN_MOVED_TO)) != 0u) {
+                        addDirectory(path);
+                    }
+                    else if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0u) {
+                        removeDirectory(path);
+                    }
+                }
+                else if ((event->mask & (IN_DELETE | IN_MOVED_FROM)) != 0u) {
+                    updated.erase(path);
+                    const lock_guard<mutex> lock{ _mutex };
+                    _collection->removePath(path);
+                    _changes.fetch_add(1u, memory_order_acq_rel);
+                }
+                else if (updated.insert(path).second) {
+                    updateFile(path);
+                }
+            }
+        }
+    }
+
+
+
+    ///////////////////////
+
+    void CWatchFolder::updateFile(const string& path)
+    {
+        if (!_factory->filter().accepts(path)) {
+            return;
+        }
+        const auto path_file = _root / ToPath(path);
+        try
+        {
+            if (fs::is_regular_file(path_file)) {
+                const auto info = _factory->collectFile(path_file);
+                const lock_guard<mutex> lock{ _mutex };
+                _collection->setInfo(path, info);
+                _changes.fetch_add(1u, memory_order_acq_rel);
+                return;
+            }
+        }
+        catch (const ExceptionCancelled&) {
+            throw;
+        }
+        catch (const exception& e) {
+            if (!is_removed(path_file)) { // Unreadable: recorded as when scanning
+                const lock_guard<mutex> lock{ _mutex };
+                _collection->setError(path, e.what());
+                _changes.fetch_add(1u, memory_order_acq_rel);
+                return;
+            }
+            // Already removed: the event is pending
+        }
+        const lock_guard<mutex> lock{ _mutex };
+        _collection->removePath(path);
+        _changes.fetch_add(1u, memory_order_acq_rel);
+    }
+
+
+    /// @details The directory may have been filled before being watched: all its content is collected.
+    void CWatchFolder::addDirectory(const string& directory)
+    {
+        const auto& filter = _factory->filter();
+        if (filter.excludesTree(directory)) {
+            return;
+        }
+        const auto path_directory = _root / ToPath(directory);
+        watch(path_directory);
+
+        list<pair<string, CCollectionInfo::info_t>> infos;
+        list<pair<string, string>> errors;
+        try {
+            for (const auto& entry : fs::recursive_directory_iterator(path_directory)) {
+                if (fs::is_regular_file(entry.path()) && filter.accepts(RelativeUtf8(entry.path(), _length_root))) {
+                    try {
+                        infos.emplace_back(RelativeUtf8(entry.path(), _length_root), _factory->collectFile(entry.path()));
+                    }
+                    catch (const ExceptionCancelled&) {
+                        throw;
+                    }
+                    catch (const exception& e) {
+                        if (!is_removed(entry.path())) { // Unreadable
+                            errors.emplace_back(RelativeUtf8(entry.path(), _length_root), e.what());
+                        }
+                    }
+                }
+            }
+        }
+        catch (const fs::filesystem_error&) { // Already removed: the event is pending
+        }
+
+        const lock_guard<mutex> lock{ _mutex };
+        for (const auto& info : infos) {
+            _collection->setInfo(info.first, info.second);
+        }
+        for (const auto& error : errors) {
+            _collection->setError(error.first, error.second);
+        }
+        _changes.fetch_add(1u, memory_order_acq_rel);
+    }
+
+
+    void CWatchFolder::removeDirectory(const string& directory)
+    {
+        unwatch(directory);
+        const lock_guard<mutex> lock{ _mutex };
+        _collection->removeDirectory(directory);
+        _changes.fetch_add(1u, memory_order_acq_rel);
+    }
+
+#else
+
+    CWatchFolder::CWatchFolder(const fs::path& root, unique_ptr<AFactoryInfo> factory) :
+        _root{ root },
+        _length_root{ root.native().size() },
+        _factory{ std::move(factory) },
+        _changes{ 0u },
+        _fd_events{ -1 }
+    {
+        throw ExceptionFatal{ "Watching a folder is only supported on Linux." };
+    }
+
+
+    CWatchFolder::~CWatchFolder() = default;
+
+#endif
+
+
+
+    ///////////////////////
+
+    string CWatchFolder::json(const bool digests) const
+    {
+        const lock_guard<mutex> lock{ _mutex };
+        return _collection->json(digests);
+    }
+
+
+    diff_t CWatchFolder::compare(const CCollectionInfo& rhs) const
+    {
+        const lock_guard<mutex> lock{ _mutex };
+        return _collection->compare(rhs);
+    }
+
+
+    eCollectingAlgorithm CWatchFolder::hasher() const
+    {
+        const lock_guard<mutex> lock{ _mutex };
+        return _collection->hasher();
+    }
+
+}
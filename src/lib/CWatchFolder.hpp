@@ -0,0 +1,104 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+#ifndef _SRC_CWatchFolder_hpp__
+#define _SRC_CWatchFolder_hpp__
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+#include <boost/filesystem.hpp>
+
+#include "CompareFolders.hpp"
+#include "CCollectionInfo.hpp"
+#include "CFactoryInfo.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace  cf {
+
+    /// @brief Keeps the collection of a folder up to date by watching the changes of its files
+    /// @details The collection is built once, then a thread applies the filesystem events as they come:
+    ///          only the modified files are hashed again.
+    ///          The public operations can be called from any thread.
+    ///          Only available on Linux, using *inotify*.
+    class CWatchFolder
+    {
+    public:
+        /// @brief Starts watching a folder
+        /// @param root     The folder to watch
+        /// @param factory  Factory used to collect the info. The watcher will handle its lifetime.
+        /// @details May throw **ExceptionFatal**
+        CWatchFolder(const fs::path& root, std::unique_ptr<AFactoryInfo> factory);
+        ~CWatchFolder();
+        CWatchFolder(const CWatchFolder&) = delete;
+        void operator=(const CWatchFolder&) = delete;
+
+        /// @brief Exports the current state of the folder as an UTF-8 JSON string
+        /// @param digests Also writes the digests of the directories
+        std::string json(const bool digests = false) const;
+
+        /// @brief Compares the current state of the folder to another collection
+        /// @details May throw **Exception**
+        diff_t compare(const CCollectionInfo& rhs) const;
+
+        /// @brief Returns the hashing algorithm
+        eCollectingAlgorithm hasher() const;
+
+        /// @brief Returns the number of changes applied since the folder was first scanned
+        inline std::uint64_t changes() const {
+            return _changes.load(std::memory_order_acquire);
+        }
+
+    private:
+        /// @brief Watches a directory and all its subdirectories
+        void watch(const fs::path& directory);
+        /// @brief Stops watching a directory and all its subdirectories
+        void unwatch(const std::string& directory);
+        /// @brief Scans the whole folder again
+        void rescan();
+        /// @brief Processes the pending events
+        void process();
+        /// @brief Hashes a file again, or removes it if it is not available anymore
+        /// @details A file that exists but cannot be read is recorded as an error
+        void updateFile(const std::string& path);
+        /// @brief Adds all the files of a new directory
+        void addDirectory(const std::string& directory);
+        /// @brief Removes all the files of a directory
+        void removeDirectory(const std::string& directory);
+
+        const fs::path _root;                           ///< Watched folder
+        const std::size_t _length_root;                 ///< Length of the root's native representation
+        const std::unique_ptr<AFactoryInfo> _factory;   ///< Collects the files' info
+        std::unique_ptr<CCollectionInfo> _collection;   ///< Current state of the folder
+        mutable std::mutex _mutex;                      ///< Protects the collection
+        std::map<int, std::string> _directories;        ///< Watch descriptors and the relative paths of their directories
+        std::atomic<std::uint64_t> _changes;            ///< Number of changes applied
+        int _fd_events;                                 ///< inotify file descriptor
+        int _fd_stop[2];                                ///< Pipe waking up the thread to be stopped
+        std::thread _thread;                            ///< Processes the events
+    };
+
+}
+
+
+#endif /* _SRC_CWatchFolder_hpp__ */
@@ -16,12 +16,22 @@
 17 */
 
 #include <memory>
+#include <future>
+#include <thread>
+#include <algorithm>
 
 #include <boost/filesystem.hpp>
 
 #include "CCollectionInfo.hpp"
+#include "CCollectionSpill.hpp"
 #include "CFactoryInfo.hpp"
+#include "CFilter.hpp"
+#include "CParserJson.hpp"
 #include "CProxyLogger.hpp"
+#include "CStats.hpp"
+#include "CTrace.hpp"
+#include "CWatchFolder.hpp"
+#include "Utilities.hpp"
 
 #include "CompareFolders.hpp"
 
@@ -37,6 +47,10 @@ ExceptionFatal::ExceptionFatal(const std::string& msg) :
     runtime_error{ "Fatal error: " + msg }
 {   }
 
+ExceptionCancelled::ExceptionCancelled(const std::string& msg) :
+    ExceptionFatal{ msg }
+{   }
+
 Exception::Exception(const std::string& msg) :
     runtime_error{ "Error: " + msg }
 {   }
@@ -120,35 +134,242 @@ inline const fs::path path_folder(const string str_path)
     return path;
 }
 
-// ===== PUBLIC FUNCTIONS
+/// @brief Returns the directory receiving the temporary files
+static fs::path path_temp(const options_t& options)
+{
+    if (!options.path_temp.empty()) {
+        return path_folder(options.path_temp);
+    }
+    try {
+        return fs::temp_directory_path();
+    }
+    catch (const fs::filesystem_error& e) {
+        throw ExceptionFatal{ e.what() };
+    }
+}
 
+/// @brief Returns the options without their cancellation token and deadline, which only bound a single operation
+static options_t uncancellable(options_t options)
+{
+    options.cancel.reset();
+    options.deadline = chrono::steady_clock::time_point::max();
+    return options;
+}
 
-diff_t cf::CompareFolders(const std::string& root_left, const std::string& root_right, const eHashingAlgorithm algo, unique_ptr<ILogger> logger)
+/// @brief Constructs the factory corresponding to the provided algorithm
+inline unique_ptr<AFactoryInfo> make_factory(const eHashingAlgorithm algo, unique_ptr<ILogger> logger, const options_t& options)
+{
+    return (algo == eCollectingAlgorithm::SECURE) ?
+        unique_ptr<AFactoryInfo>(dynamic_cast<AFactoryInfo*>(new CFactoryInfoSecure{ std::move(logger), options })) :
+        unique_ptr<AFactoryInfo>(dynamic_cast<AFactoryInfo*>(new CFactoryInfoFast{ std::move(logger), options }));
+}
+
+/// @brief Collects the info of two folders
+static pair<CCollectionInfo, CCollectionInfo> collect_folders(const string& root_left, const string& root_right, AFactoryInfo& factoryInfo)
 {
     const auto path_folder_1 = path_folder(root_left);
     const auto path_folder_2 = path_folder(root_right);
 
     // Compute the hashes
-    unique_ptr<AFactoryInfo> factoryInfo = (algo == eCollectingAlgorithm::SECURE) ?
-        unique_ptr<AFactoryInfo>(dynamic_cast<AFactoryInfo*>(new CFactoryInfoSecure{ std::move(logger) })) :
-        unique_ptr<AFactoryInfo>(dynamic_cast<AFactoryInfo*>(new CFactoryInfoFast{ std::move(logger) }));
+    auto infoDir1 = factoryInfo.collectInfo(path_folder_1);
+    auto infoDir2 = factoryInfo.collectInfo(path_folder_2);
+
+    return { std::move(infoDir1), std::move(infoDir2) };
+}
+
+/// @brief Reads the info of a JSON file, applying its deltas
+/// @param filter Only the files it accepts are kept, as when a folder is collected
+static CCollectionInfo read_json(const json_t& json, const CFilter& filter, const unsigned nbThreads = max(1u, thread::hardware_concurrency()))
+{
+    list<fs::path> deltas;
+    for (const auto& delta : json.deltas) {
+        deltas.emplace_back(delta);
+    }
+    auto collection = AFactoryInfo::ReadInfo(json.path, deltas, nbThreads);
+    collection.filter(filter);
+    return collection;
+}
+
+/// @brief Reads the info of two JSON files
+static pair<CCollectionInfo, CCollectionInfo> read_jsons(const json_t& left, const json_t& right, const options_t& options, CStats& stats)
+{
+    const CStats::CTimer timer{ stats, ePhase::PARSING };
+    const CFilter filter{ options.includes, options.excludes };
+    // Both files are loaded concurrently, sharing the available threads
+    const auto nbThreads = max(1u, thread::hardware_concurrency() / 2u);
+    auto future_left = async(launch::async, [&left, &filter, nbThreads] {
+        return read_json(left, filter, nbThreads);
+    });
+    auto infoDir2 = read_json(right, filter, nbThreads);
+    auto infoDir1 = future_left.get();
+
+    return { std::move(infoDir1), std::move(infoDir2) };
+}
+
+/// @brief Collects the info of a folder, using the algorithm of the JSON file it will be compared to
+/// @param factoryInfo Receives the factory used to collect the info
+static pair<CCollectionInfo, CCollectionInfo> collect_folder_json(const string& folder, const json_t& json, unique_ptr<ILogger> logger, const options_t& options, unique_ptr<AFactoryInfo>& factoryInfo, CStats& stats)
+{
+    const auto path_folder_1 = path_folder(folder);
+
+    CStats::CTimer timer{ stats, ePhase::PARSING };
+    auto infoDir1 = read_json(json, CFilter{ options.includes, options.excludes });
+    timer.stop();
+    factoryInfo = make_factory(infoDir1.hasher(), std::move(logger), options);
+    auto infoDir2 = factoryInfo->collectInfo(path_folder_1);
+
+    return { std::move(infoDir2), std::move(infoDir1) };
+}
+
+/// @brief Compares two collections, counting the files compared in the progress of the factory
+static void compare_infos(const pair<CCollectionInfo, CCollectionInfo>& infos, IDiffListener& listener, AFactoryInfo& factoryInfo, CStats& stats)
+{
+    const CStats::CTimer timer{ stats, ePhase::COMPARING };
+    CDiffStats counter_stats{ listener, stats };
+    CDiffProgress counter{ counter_stats, factoryInfo.progress().counters(0u) };
+    infos.first.compare(infos.second, counter);
+}
+
+/// @brief Compares two collections, counting the files compared in the progress of the factory
+static diff_t compare_infos(const pair<CCollectionInfo, CCollectionInfo>& infos, AFactoryInfo& factoryInfo, CStats& stats)
+{
+    diff_t diff;
+    diff.root_left = infos.first.root();
+    diff.root_right = infos.second.root();
+    CDiffCollector collector{ diff };
+    compare_infos(infos, collector, factoryInfo, stats);
+    return diff;
+}
+
+/// @brief Collections of two folders, bounded in memory
+typedef pair<unique_ptr<CCollectionSpill>, unique_ptr<CCollectionSpill>> spills_t;
+
+/// @brief Returns true if the JSON files can be compared out of core
+/// @details The deltas can only be applied in memory
+static bool is_bounded(const options_t& options, const json_t& json)
+{
+    return options.memory_budget != 0u && json.deltas.empty();
+}
 
-    const auto infoDir1 = factoryInfo->collectInfo(path_folder_1);
-    const auto infoDir2 = factoryInfo->collectInfo(path_folder_2);
+/// @brief Collects the info of a folder into a collection bounded in memory
+/// @details Each of the two collections compared gets half of the budget
+static unique_ptr<CCollectionSpill> spill_folder(const string& root, const eHashingAlgorithm algo, AFactoryInfo& factoryInfo, const options_t& options)
+{
+    const auto folder = path_folder(root);
+    auto collection = make_unique<CCollectionSpill>(ToUtf8(folder), algo, options.memory_budget / 2u, path_temp(options));
+    factoryInfo.collectInfo(folder, *collection);
+    return collection;
+}
+
+/// @brief Reads the info of a JSON file into a collection bounded in memory, keeping only the files selected by the options
+static unique_ptr<CCollectionSpill> spill_json(const json_t& json, const options_t& options, CStats& stats)
+{
+    const CStats::CTimer timer{ stats, ePhase::PARSING };
+    const CParserJson parser{ json.path };
+    return parser.parse(options.memory_budget / 2u, path_temp(options), CFilter{ options.includes, options.excludes });
+}
+
+/// @brief Collects the info of a folder into a collection bounded in memory, using the algorithm of the JSON file it will be compared to
+/// @param factoryInfo Receives the factory used to collect the info
+static spills_t spill_folder_json(const string& folder, const json_t& json, unique_ptr<ILogger> logger, const options_t& options, unique_ptr<AFactoryInfo>& factoryInfo, CStats& stats)
+{
+    path_folder(folder);
+
+    auto infoDir1 = spill_json(json, options, stats);
+    factoryInfo = make_factory(infoDir1->hasher(), std::move(logger), options);
+    auto infoDir2 = spill_folder(folder, infoDir1->hasher(), *factoryInfo, options);
+
+    return { std::move(infoDir2), std::move(infoDir1) };
+}
+
+/// @brief Compares two collections bounded in memory, counting the files compared in the progress of the factory
+static void compare_infos(const spills_t& spills, IDiffListener& listener, AFactoryInfo& factoryInfo, CStats& stats)
+{
+    const CStats::CTimer timer{ stats, ePhase::COMPARING };
+    CDiffStats counter_stats{ listener, stats };
+    CDiffProgress counter{ counter_stats, factoryInfo.progress().counters(0u) };
+    spills.first->compare(*spills.second, counter);
+}
+
+/// @brief Compares two collections bounded in memory, counting the files compared in the progress of the factory
+static diff_t compare_infos(const spills_t& spills, AFactoryInfo& factoryInfo, CStats& stats)
+{
+    diff_t diff;
+    diff.root_left = spills.first->root();
+    diff.root_right = spills.second->root();
+    CDiffCollector collector{ diff };
+    compare_infos(spills, collector, factoryInfo, stats);
+    return diff;
+}
+
+// ===== PUBLIC FUNCTIONS
+
+
+diff_t cf::CompareFolders(const std::string& root_left, const std::string& root_right, const eHashingAlgorithm algo, unique_ptr<ILogger> logger, const options_t& options)
+{
+    const CTrace trace{ options.path_trace };
+    CStats stats{ options.stats };
+    const CStats::CTimer timer{ stats, ePhase::TOTAL };
+    const auto factoryInfo = make_factory(algo, std::move(logger), options);
+    if (options.memory_budget != 0u) {
+        spills_t spills;
+        spills.first = spill_folder(root_left, algo, *factoryInfo, options);
+        spills.second = spill_folder(root_right, algo, *factoryInfo, options);
+        return compare_infos(spills, *factoryInfo, stats);
+    }
+    const auto infos = collect_folders(root_left, root_right, *factoryInfo);
         
-    const auto diff = infoDir1.compare(infoDir2);
+    const auto diff = compare_infos(infos, *factoryInfo, stats);
 
     return diff;
 }
 
 
-diff_t cf::CompareFolders(const json_t left, const json_t right)
+void cf::CompareFolders(const std::string& root_left, const std::string& root_right, const eHashingAlgorithm algo, IDiffListener& listener, unique_ptr<ILogger> logger, const options_t& options)
+{
+    const CTrace trace{ options.path_trace };
+    CStats stats{ options.stats };
+    const CStats::CTimer timer{ stats, ePhase::TOTAL };
+    const auto factoryInfo = make_factory(algo, std::move(logger), options);
+    if (options.memory_budget != 0u) {
+        spills_t spills;
+        spills.first = spill_folder(root_left, algo, *factoryInfo, options);
+        spills.second = spill_folder(root_right, algo, *factoryInfo, options);
+        compare_infos(spills, listener, *factoryInfo, stats);
+        return;
+    }
+    const auto infos = collect_folders(root_left, root_right, *factoryInfo);
+
+    compare_infos(infos, listener, *factoryInfo, stats);
+}
+
+
+diff_t cf::CompareFolders(const json_t left, const json_t right, const options_t& options)
 {
-    const auto infoDir1 = AFactoryInfo::ReadInfo(left.path);
-    const auto infoDir2 = AFactoryInfo::ReadInfo(right.path);
+    const CTrace trace{ options.path_trace };
+    CStats stats{ options.stats };
+    const CStats::CTimer timer{ stats, ePhase::TOTAL };
+    if (is_bounded(options, left) && is_bounded(options, right)) {
+        const spills_t spills{ spill_json(left, options, stats), spill_json(right, options, stats) };
+        diff_t diff;
+        diff.root_left = spills.first->root();
+        diff.root_right = spills.second->root();
+        CDiffCollector collector{ diff };
+        CDiffStats counter{ collector, stats };
+        const CStats::CTimer comparing{ stats, ePhase::COMPARING };
+        spills.first->compare(*spills.second, counter);
+        return diff;
+    }
+    const auto infos = read_jsons(left, right, options, stats);
 
     try {
-        const auto diff = infoDir1.compare(infoDir2);
+        diff_t diff;
+        diff.root_left = infos.first.root();
+        diff.root_right = infos.second.root();
+        CDiffCollector collector{ diff };
+        CDiffStats counter{ collector, stats };
+        const CStats::CTimer comparing{ stats, ePhase::COMPARING };
+        infos.first.compare(infos.second, counter);
         return diff;
     }
     catch (const Exception& e) {
@@ -158,29 +379,237 @@ diff_t cf::CompareFolders(const json_t left, const json_t right)
 }
 
 
-
-diff_t cf::CompareFolders(const std::string& folder, const json_t json, unique_ptr<ILogger> logger)
+void cf::CompareFolders(const json_t left, const json_t right, IDiffListener& listener, const options_t& options)
 {
-    const auto path_folder_1 = path_folder(folder);
+    const CTrace trace{ options.path_trace };
+    CStats stats{ options.stats };
+    const CStats::CTimer timer{ stats, ePhase::TOTAL };
+    CDiffStats counter{ listener, stats };
+    if (is_bounded(options, left) && is_bounded(options, right)) {
+        const spills_t spills{ spill_json(left, options, stats), spill_json(right, options, stats) };
+        const CStats::CTimer comparing{ stats, ePhase::COMPARING };
+        spills.first->compare(*spills.second, counter);
+        return;
+    }
+    const auto infos = read_jsons(left, right, options, stats);
+
+    try {
+        const CStats::CTimer comparing{ stats, ePhase::COMPARING };
+        infos.first.compare(infos.second, counter);
+    }
+    catch (const Exception& e) {
+        throw ExceptionFatal{ e.what() };
+    }
+}
 
-    const auto infoDir1 = AFactoryInfo::ReadInfo(json.path);
-    unique_ptr<AFactoryInfo> factoryInfo = (infoDir1.hasher() == eCollectingAlgorithm::SECURE) ?
-        unique_ptr<AFactoryInfo>(dynamic_cast<AFactoryInfo*>(new CFactoryInfoSecure{ std::move(logger) })) :
-        unique_ptr<AFactoryInfo>(dynamic_cast<AFactoryInfo*>(new CFactoryInfoFast{ std::move(logger) }));
-    const auto infoDir2 = factoryInfo->collectInfo(path_folder_1);
+
+
+diff_t cf::CompareFolders(const std::string& folder, const json_t json, unique_ptr<ILogger> logger, const options_t& options)
+{
+    const CTrace trace{ options.path_trace };
+    CStats stats{ options.stats };
+    const CStats::CTimer timer{ stats, ePhase::TOTAL };
+    unique_ptr<AFactoryInfo> factoryInfo;
+    if (is_bounded(options, json)) {
+        const auto spills = spill_folder_json(folder, json, std::move(logger), options, factoryInfo, stats);
+        return compare_infos(spills, *factoryInfo, stats);
+    }
+    const auto infos = collect_folder_json(folder, json, std::move(logger), options, factoryInfo, stats);
     
-    const auto diff = infoDir2.compare(infoDir1);
+    const auto diff = compare_infos(infos, *factoryInfo, stats);
 
     return diff;
 }
 
 
-wstring cf::ScanFolder(const string& path, const cf::eCollectingAlgorithm algo, unique_ptr<ILogger> logger)
+void cf::CompareFolders(const std::string& folder, const json_t json, IDiffListener& listener, unique_ptr<ILogger> logger, const options_t& options)
 {
+    const CTrace trace{ options.path_trace };
+    CStats stats{ options.stats };
+    const CStats::CTimer timer{ stats, ePhase::TOTAL };
+    unique_ptr<AFactoryInfo> factoryInfo;
+    if (is_bounded(options, json)) {
+        const auto spills = spill_folder_json(folder, json, std::move(logger), options, factoryInfo, stats);
+        compare_infos(spills, listener, *factoryInfo, stats);
+        return;
+    }
+    const auto infos = collect_folder_json(folder, json, std::move(logger), options, factoryInfo, stats);
+
+    compare_infos(infos, listener, *factoryInfo, stats);
+}
+
+
+string cf::ScanFolder(const string& path, const cf::eCollectingAlgorithm algo, unique_ptr<ILogger> logger, const options_t& options)
+{
+    const CTrace trace{ options.path_trace };
+    CStats stats{ options.stats };
+    const CStats::CTimer timer{ stats, ePhase::TOTAL };
     const auto folder = path_folder(path);
-    unique_ptr<AFactoryInfo> factoryInfo = (algo == eCollectingAlgorithm::SECURE) ?
-        unique_ptr<AFactoryInfo>(dynamic_cast<AFactoryInfo*>(new CFactoryInfoSecure{ std::move(logger) })) :
-        unique_ptr<AFactoryInfo>(dynamic_cast<AFactoryInfo*>(new CFactoryInfoFast{ std::move(logger) }));
+    const auto factoryInfo = make_factory(algo, std::move(logger), options);
     const auto properties = factoryInfo->collectInfo(folder);
-    return properties.json();
+    const CStats::CTimer serializing{ stats, ePhase::SERIALIZING };
+    const CTrace::CSpan span{ "serialize" };
+    return properties.json(options.digests);
+}
+
+
+void cf::ScanFolder(const string& path, const cf::eCollectingAlgorithm algo, ostream& output, unique_ptr<ILogger> logger, const options_t& options)
+{
+    const CTrace trace{ options.path_trace };
+    CStats stats{ options.stats };
+    const CStats::CTimer timer{ stats, ePhase::TOTAL };
+    const auto folder = path_folder(path);
+    const auto factoryInfo = make_factory(algo, std::move(logger), options);
+    CCollectionSpill properties{ ToUtf8(folder), algo, options.memory_budget, path_temp(options) };
+    factoryInfo->collectInfo(folder, properties);
+    const CStats::CTimer serializing{ stats, ePhase::SERIALIZING };
+    const CTrace::CSpan span{ "serialize" };
+    properties.json(output, options.digests);
+}
+
+
+string cf::ScanFolder(const string& path, const json_t baseline, unique_ptr<ILogger> logger, const options_t& options)
+{
+    const CTrace trace{ options.path_trace };
+    CStats stats{ options.stats };
+    const CStats::CTimer timer{ stats, ePhase::TOTAL };
+    const auto folder = path_folder(path);
+    CStats::CTimer parsing{ stats, ePhase::PARSING };
+    const auto info_baseline = read_json(baseline, CFilter{ options.includes, options.excludes });
+    parsing.stop();
+    const auto factoryInfo = make_factory(info_baseline.hasher(), std::move(logger), options);
+    const auto properties = factoryInfo->collectInfo(folder, &info_baseline);
+    const CStats::CTimer serializing{ stats, ePhase::SERIALIZING };
+    const CTrace::CSpan span{ "serialize" };
+    return properties.json(options.digests);
+}
+
+
+string cf::ScanFolderDelta(const string& path, const json_t base, unique_ptr<ILogger> logger, const options_t& options)
+{
+    const CTrace trace{ options.path_trace };
+    CStats stats{ options.stats };
+    const CStats::CTimer timer{ stats, ePhase::TOTAL };
+    const auto folder = path_folder(path);
+    CStats::CTimer parsing{ stats, ePhase::PARSING };
+    // Not filtered: the digest of its root identifies the base. The files excluded since are recorded as removed.
+    const auto info_base = read_json(base, CFilter{ {}, {} });
+    parsing.stop();
+    const auto factoryInfo = make_factory(info_base.hasher(), std::move(logger), options);
+    const auto properties = factoryInfo->collectInfo(folder, &info_base);
+    const CStats::CTimer serializing{ stats, ePhase::SERIALIZING };
+    const CTrace::CSpan span{ "serialize" };
+    return properties.jsonDelta(info_base);
+}
+
+
+
+// ===== WATCHER
+
+
+cf::CWatcher::CWatcher(const string& path, const eHashingAlgorithm algo, unique_ptr<ILogger> logger, const options_t& options) :
+    _watch{ make_unique<CWatchFolder>(path_folder(path), make_factory(algo, std::move(logger), options)) },
+    _options(uncancellable(options))
+{   }
+
+
+cf::CWatcher::~CWatcher() = default;
+
+
+string cf::CWatcher::json() const
+{
+    return _watch->json(_options.digests);
+}
+
+
+diff_t cf::CWatcher::compare(const string& folder) const
+{
+    const auto factoryInfo = make_factory(_watch->hasher(), make_unique<CLoggerNull>(), _options);
+    const auto info = factoryInfo->collectInfo(path_folder(folder));
+    return _watch->compare(info);
+}
+
+
+diff_t cf::CWatcher::compare(const json_t json) const
+{
+    const auto info = read_json(json, CFilter{ _options.includes, _options.excludes });
+    return _watch->compare(info);
+}
+
+
+uint64_t cf::CWatcher::changes() const
+{
+    return _watch->changes();
+}
+
+
+
+// ===== WIDE STRINGS
+
+
+cf::wdiff_t::wdiff_t(const diff_t& diff) :
+    root_left{ ToWString(diff.root_left) },
+    root_right{ ToWString(diff.root_right) }
+{
+    const auto convert = [](const list<string>& paths) {
+        list<wstring> converted;
+        for (const auto& path : paths) {
+            converted.push_back(ToWString(path));
+        }
+        return converted;
+    };
+    identical = convert(diff.identical);
+    different = convert(diff.different);
+    unique_left = convert(diff.unique_left);
+    unique_right = convert(diff.unique_right);
+    for (const auto& entry : diff.renamed) {
+        renamed.push_back(renamed_t{ entry.hash, convert(entry.left), convert(entry.right) });
+    }
+}
+
+
+diff_t cf::wdiff_t::utf8() const
+{
+    const auto convert = [](const list<wstring>& paths) {
+        list<string> converted;
+        for (const auto& path : paths) {
+            converted.push_back(ToUtf8(path));
+        }
+        return converted;
+    };
+    diff_t diff;
+    diff.root_left = ToUtf8(root_left);
+    diff.root_right = ToUtf8(root_right);
+    diff.identical = convert(identical);
+    diff.different = convert(different);
+    diff.unique_left = convert(unique_left);
+    diff.unique_right = convert(unique_right);
+    for (const auto& entry : renamed) {
+        diff.renamed.push_back(diff_t::renamed_t{ entry.hash, convert(entry.left), convert(entry.right) });
+    }
+    return diff;
+}
+
+
+wdiff_t cf::CompareFolders(const wstring& left, const wstring& right, const eHashingAlgorithm algo, unique_ptr<ILogger> logger, const options_t& options)
+{
+    return CompareFolders(ToUtf8(left), ToUtf8(right), algo, std::move(logger), options);
+}
+
+
+wdiff_t cf::CompareFolders(const wstring& folder, const json_t json, unique_ptr<ILogger> logger, const options_t& options)
+{
+    return CompareFolders(ToUtf8(folder), json, std::move(logger), options);
+}
+
+
+wstring cf::Json(const wdiff_t& diff)
+{
+    return ToWString(Json(diff.utf8()));
+}
+
+
+wstring cf::ScanFolder(const wstring& path, const eHashingAlgorithm algo, unique_ptr<ILogger> logger, const options_t& options)
+{
+    return ToWString(ScanFolder(ToUtf8(path), algo, std::move(logger), options));
 }
@@ -0,0 +1,98 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+
+#ifndef _SRC_TQueueBounded_hpp__
+#define _SRC_TQueueBounded_hpp__
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+
+namespace cf {
+
+    /// @brief A bounded *multiple producers, multiple consumers* blocking queue
+    /// @details Producers wait while the queue is full, so that they cannot get ahead of the consumers
+    ///          and fill the memory (*backpressure*). Consumers wait while it is empty.
+    template< typename T >
+    class TQueueBounded {
+
+    public:
+        /// @param capacity Maximum number of elements in the queue
+        explicit TQueueBounded(const std::size_t capacity) :
+            _capacity{ capacity == 0u ? 1u : capacity },
+            _closed{ false }
+        {   }
+        TQueueBounded(const TQueueBounded&) = delete;
+        void operator=(const TQueueBounded&) = delete;
+
+        /// @brief Pushes a new element, waiting for some room if the queue is full
+        /// @returns false if the queue was closed: the element was not pushed
+        bool push(T&& value)
+        {
+            std::unique_lock<std::mutex> lock{ _mutex };
+            _condNotFull.wait(lock, [this] { return _elements.size() < _capacity || _closed; });
+            if (_closed) {
+                return false;
+            }
+            _elements.push_back(std::move(value));
+            lock.unlock();
+            _condNotEmpty.notify_one();
+            return true;
+        }
+
+        /// @brief Pops the oldest element, waiting for one if the queue is empty
+        /// @returns false once the queue is closed and empty
+        bool pop(T& value)
+        {
+            std::unique_lock<std::mutex> lock{ _mutex };
+            _condNotEmpty.wait(lock, [this] { return !_elements.empty() || _closed; });
+            if (_elements.empty()) {
+                return false;
+            }
+            value = std::move(_elements.front());
+            _elements.pop_front();
+            lock.unlock();
+            _condNotFull.notify_one();
+            return true;
+        }
+
+        /// @brief No more element can be pushed. The elements already pushed can still be popped.
+        void close()
+        {
+            {
+                const std::lock_guard<std::mutex> lock{ _mutex };
+                _closed = true;
+            }
+            _condNotEmpty.notify_all();
+            _condNotFull.notify_all();
+        }
+
+    private:
+        const std::size_t _capacity;
+        std::deque<T> _elements;
+        bool _closed;
+        std::mutex _mutex;
+        std::condition_variable _condNotEmpty;  ///< Notified when an element is pushed
+        std::condition_variable _condNotFull;   ///< Notified when an element is popped
+    };
+
+}
+
+#endif /* _SRC_TQueueBounded_hpp__ */
@@ -0,0 +1,163 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+#ifndef _SRC_TQueueMpsc_hpp__
+#define _SRC_TQueueMpsc_hpp__
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
+
+namespace cf {
+
+    /// @brief A bounded *multiple producers, single consumer* queue
+    /// @details Lock free ring buffer: each cell holds a sequence number telling whether it is ready
+    ///          to be written or read for a given lap (D. Vyukov's algorithm).
+    ///          Producers only contend on an atomic increment. When the queue is full, they yield until a cell is freed.
+    ///          The consumer blocks on a condition variable only when the queue is empty:
+    ///          producers take the mutex only to wake it up.
+    template< typename T >
+    class TQueueMpsc {
+
+    public:
+        /// @param capacity Number of cells. Rounded up to a power of two.
+        explicit TQueueMpsc(const std::size_t capacity = 4096u) :
+            _mask{ roundCapacity(capacity) - 1u },
+            _cells{ new cell_t[_mask + 1u] },
+            _pos_push{ 0u },
+            _pos_pop{ 0u },
+            _waiting{ false },
+            _stopRequested{ false }
+        {
+            for (std::size_t i = 0u; i <= _mask; ++i) {
+                _cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+        TQueueMpsc(const TQueueMpsc&) = delete;
+        void operator=(const TQueueMpsc&) = delete;
+
+        /// @brief Pushes a new element. Can be called from concurrent threads.
+        void push(T&& value)
+        {
+            cell_t* cell;
+            auto pos = _pos_push.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell = &_cells[pos & _mask];
+                const auto sequence = cell->sequence.load(std::memory_order_acquire);
+                const auto lap = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+                if (lap == 0) { // Free cell: try to reserve it
+                    if (_pos_push.compare_exchange_weak(pos, pos + 1u, std::memory_order_relaxed)) {
+                        break;
+                    }
+                }
+                else if (lap < 0) { // Full: waiting for the consumer
+                    std::this_thread::yield();
+                    pos = _pos_push.load(std::memory_order_relaxed);
+                }
+                else { // Reserved by another producer
+                    pos = _pos_push.load(std::memory_order_relaxed);
+                }
+            }
+            cell->data = std::move(value);
+            cell->sequence.store(pos + 1u, std::memory_order_release);
+
+            // Pairs with the fence of pop(): either the consumer sees the cell, or this producer sees it waiting
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (_waiting.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> lock{ _mutex };
+                _condNewData.notify_one();
+            }
+        }
+
+        /// @brief Pops the oldest element. **Shall only be called by a single thread.**
+        /// @details Blocks while the queue is empty.
+        /// @returns false once the queue is stopped and empty
+        bool pop(T& value)
+        {
+            while (!ready())
+            {
+                _waiting.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                {
+                    std::unique_lock<std::mutex> lock{ _mutex };
+                    _condNewData.wait(lock, [this] {
+                        return ready() || _stopRequested.load(std::memory_order_acquire);
+                    });
+                }
+                _waiting.store(false, std::memory_order_relaxed);
+                if (!ready()) { // Stopped
+                    return false;
+                }
+            }
+
+            auto& cell = _cells[_pos_pop & _mask];
+            value = std::move(cell.data);
+            cell.sequence.store(_pos_pop + _mask + 1u, std::memory_order_release);
+            ++_pos_pop;
+            return true;
+        }
+
+        /// @brief Stops waiting for new elements. The elements already pushed can still be popped.
+        void stop()
+        {
+            std::lock_guard<std::mutex> lock{ _mutex };
+            _stopRequested.store(true, std::memory_order_release);
+            _condNewData.notify_all();
+        }
+
+    private:
+        struct cell_t {
+            std::atomic<std::size_t> sequence;  ///< Position the cell is ready for. Ready to be read at position + 1.
+            T data;
+        };
+
+        /// @brief Returns true if the oldest element can be popped
+        inline bool ready() const {
+            return _cells[_pos_pop & _mask].sequence.load(std::memory_order_acquire) == _pos_pop + 1u;
+        }
+
+        /// @brief Returns the smallest power of two greater or equal to capacity
+        static std::size_t roundCapacity(const std::size_t capacity) {
+            std::size_t rounded = 2u;
+            while (rounded < capacity) {
+                rounded <<= 1;
+            }
+            return rounded;
+        }
+
+        static constexpr std::size_t SIZE_CACHE_LINE = 64u;
+
+        const std::size_t _mask;                    ///< Number of cells minus one
+        const std::unique_ptr<cell_t[]> _cells;
+        char _pad_0[SIZE_CACHE_LINE];               ///< Keeps the producers' position away from the other members
+        std::atomic<std::size_t> _pos_push;         ///< Next position to be reserved by a producer
+        char _pad_1[SIZE_CACHE_LINE];               ///< Keeps the consumer's position away from the producers' one
+        std::size_t _pos_pop;                       ///< Next position to be read by the consumer
+        std::atomic_bool _waiting;                  ///< Is the consumer waiting for new elements?
+        std::atomic_bool _stopRequested;
+        std::mutex _mutex;                          ///< Only used to wake up the consumer
+        std::condition_variable _condNewData;       ///< Condition used to notify that new data are available
+    };
+
+}
+
+#endif /* _SRC_TQueueMpsc_hpp__ */
@@ -15,109 +15,197 @@
 16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
 17 */
 
-#include <sstream>
 #include <iostream>
+#include <fstream>
+#include <locale>
 #include <codecvt>
 #include <array>
 
-#include <boost/property_tree/ptree.hpp>
-#include <boost/property_tree/json_parser.hpp>
-
 #include "CompareFolders.hpp"
+#include "Utilities.hpp"
 
 
 
 using namespace std;
-namespace pt = boost::property_tree;
 
 
 
 namespace cf
 {
-	/// @details The JSON is coded in wstring in order to handle any special character in the filepaths
-    wstring Json(const diff_t diff)
+    /// @brief Appends a JSON array of strings, indented by the given level
+    static void AppendJsonArray(string& json, const list<string>& entries, const unsigned level)
     {
-        pt::wptree root;
-        root.put(JSON_KEYS.GENERATOR, JSON_CONST_VALUES.GENERATOR);
-
-        // identical files
-        if (!diff.identical.empty()) {
-            pt::wptree node_identical;
-            for (const auto& entry : diff.identical) {
-                pt::wptree node_entry;
-                node_entry.put(wstring{}, entry);
-                node_identical.push_back(make_pair(wstring{}, node_entry));
-            }
-            root.add_child(JSON_KEYS.DIFF.IDENTICAL, node_identical);
+        if (entries.empty()) {
+            json += "[]";
+            return;
         }
-
-        // different files
-        if (!diff.different.empty()) {
-            pt::wptree node_different;
-            for (const auto& entry : diff.different) {
-                pt::wptree node_entry;
-                node_entry.put(wstring{}, entry);
-                node_different.push_back(make_pair(wstring{}, node_entry));
-            }
-            root.add_child(JSON_KEYS.DIFF.DIFFERENT, node_different);
+        const string indent(4u * level, ' ');
+        json += "[\n";
+        auto separator = "";
+        for (const auto& entry : entries) {
+            json += separator;
+            json += indent;
+            json += "    ";
+            AppendJsonString(json, entry);
+            separator = ",\n";
         }
+        json += '\n';
+        json += indent;
+        json += ']';
+    }
 
-        // files unique to the left
-        if (!diff.unique_left.empty()) {
-            pt::wptree node_unique_left;
-            for (const auto& entry : diff.unique_left) {
-                pt::wptree node_entry;
-                node_entry.put(wstring{}, entry);
-                node_unique_left.push_back(make_pair(wstring{}, node_entry));
-            }
-            root.add_child(JSON_KEYS.DIFF.UNIQUE_LEFT, node_unique_left);
-        }
 
-        // files unique to the right
-        if (!diff.unique_right.empty()) {
-            pt::wptree node_unique_right;
-            for (const auto& entry : diff.unique_right) {
-                pt::wptree node_entry;
-                node_entry.put(wstring{}, entry);
-                node_unique_right.push_back(make_pair(wstring{}, node_entry));
+	/// @details The JSON is encoded in UTF-8 like all the paths handled by the library
+    string Json(const diff_t& diff)
+    {
+        string json{ "{\n    " };
+        AppendJsonString(json, JSON_KEYS.GENERATOR);
+        json += ": ";
+        AppendJsonString(json, JSON_CONST_VALUES.GENERATOR);
+
+        const auto appendList = [&json](const string& key, const list<string>& entries) {
+            if (!entries.empty()) {
+                json += ",\n    ";
+                AppendJsonString(json, key);
+                json += ": ";
+                AppendJsonArray(json, entries, 1u);
             }
-            root.add_child(JSON_KEYS.DIFF.UNIQUE_RIGHT, node_unique_right);
-        }
+        };
+        appendList(JSON_KEYS.DIFF.IDENTICAL, diff.identical);
+        appendList(JSON_KEYS.DIFF.DIFFERENT, diff.different);
+        appendList(JSON_KEYS.DIFF.UNIQUE_LEFT, diff.unique_left);
+        appendList(JSON_KEYS.DIFF.UNIQUE_RIGHT, diff.unique_right);
 
         // renamed and duplicates
-        if (!diff.renamed.empty()) {
-            pt::wptree renamed;
+        if (!diff.renamed.empty())
+        {
+            json += ",\n    ";
+            AppendJsonString(json, JSON_KEYS.DIFF.RENAMED);
+            json += ": {\n";
+            auto separator = "";
             for (const auto& entry : diff.renamed)
             {
-                pt::wptree names;
-                pt::wptree left;
-                for (const auto& entry_left : entry.left) {
-                    pt::wptree node_entry;
-                    node_entry.put(wstring{}, entry_left);
-                    left.push_back(make_pair(wstring{}, node_entry));
-                }
-                names.push_back(make_pair(JSON_KEYS.DIFF.LEFT, left));
-
-                pt::wptree right;
-                for (const auto& entry_right : entry.right) {
-                    pt::wptree node_entry;
-                    node_entry.put(wstring{}, entry_right);
-                    right.push_back(make_pair(wstring{}, node_entry));
-                }
-                names.push_back(make_pair(JSON_KEYS.DIFF.RIGHT, right));
-                renamed.push_back(make_pair(wstring{begin(entry.hash), end(entry.hash)}, names)); // Conversion ok because, hashes is plains 7-bit ASCII
+                json += separator;
+                json += "        ";
+                AppendJsonString(json, entry.hash);
+                json += ": {\n            ";
+                AppendJsonString(json, JSON_KEYS.DIFF.LEFT);
+                json += ": ";
+                AppendJsonArray(json, entry.left, 3u);
+                json += ",\n            ";
+                AppendJsonString(json, JSON_KEYS.DIFF.RIGHT);
+                json += ": ";
+                AppendJsonArray(json, entry.right, 3u);
+                json += "\n        }";
+                separator = ",\n";
             }
-            root.add_child(JSON_KEYS.DIFF.RENAMED, renamed);
+            json += "\n    }";
         }
 
-        // Get the string and returns
-        wstringstream stream{ ios_base::out };
-        pt::write_json(stream, root);
-        return stream.str();
+        json += "\n}\n";
+        return json;
+    }
+
+
+
+    /// --------
+    void CDiffWriterNdjson::identical(const string& path)
+    {
+        write(JSON_KEYS.DIFF.IDENTICAL, path);
+    }
+
+    void CDiffWriterNdjson::different(const string& path)
+    {
+        write(JSON_KEYS.DIFF.DIFFERENT, path);
+    }
+
+    void CDiffWriterNdjson::uniqueLeft(const string& path)
+    {
+        write(JSON_KEYS.DIFF.UNIQUE_LEFT, path);
+    }
+
+    void CDiffWriterNdjson::uniqueRight(const string& path)
+    {
+        write(JSON_KEYS.DIFF.UNIQUE_RIGHT, path);
+    }
+
+    void CDiffWriterNdjson::renamed(const diff_t::renamed_t& renamed)
+    {
+        const auto appendList = [this](const list<string>& entries) {
+            _record += '[';
+            auto separator = "";
+            for (const auto& entry : entries) {
+                _record += separator;
+                AppendJsonString(_record, entry);
+                separator = ",";
+            }
+            _record += ']';
+        };
+
+        _record = "{";
+        AppendJsonString(_record, JSON_KEYS.DIFF.RENAMED);
+        _record += ":{";
+        AppendJsonString(_record, renamed.hash);
+        _record += ":{";
+        AppendJsonString(_record, JSON_KEYS.DIFF.LEFT);
+        _record += ':';
+        appendList(renamed.left);
+        _record += ',';
+        AppendJsonString(_record, JSON_KEYS.DIFF.RIGHT);
+        _record += ':';
+        appendList(renamed.right);
+        _record += "}}}\n";
+        _stream << _record << flush;
+    }
+
+    void CDiffWriterNdjson::write(const string& key, const string& path)
+    {
+        _record = "{";
+        AppendJsonString(_record, key);
+        _record += ':';
+        AppendJsonString(_record, path);
+        _record += "}\n";
+        _stream << _record << flush;
+    }
+
+
+
+    /// --------
+    void AppendJsonString(string& json, const string& utf8)
+    {
+        static const char* const HEX = "0123456789ABCDEF";
+        json += '"';
+        auto begin = utf8.data();
+        const auto end = begin + utf8.size();
+        for (auto it = begin; it != end; ++it)
+        {
+            const auto c = static_cast<unsigned char>(*it);
+            if (c >= 0x20 && c != '"' && c != '\\') { // UTF-8 multibytes sequences are kept as is
+                continue;
+            }
+            json.append(begin, it);
+            begin = it + 1;
+            switch (c)
+            {
+            case '"':   json += "\\\""; break;
+            case '\\':  json += "\\\\"; break;
+            case '\b':  json += "\\b"; break;
+            case '\f':  json += "\\f"; break;
+            case '\n':  json += "\\n"; break;
+            case '\r':  json += "\\r"; break;
+            case '\t':  json += "\\t"; break;
+            default:
+                json += "\\u00";
+                json += HEX[c >> 4];
+                json += HEX[c & 0xF];
+            }
+        }
+        json.append(begin, end);
+        json += '"';
     }
-	
-	
-	
+
+
+
 	/// --------
 	void WriteWString(std::ofstream& stream, const std::wstring& str, const bool withBOM)
 	{
@@ -125,7 +213,27 @@ namespace cf
 			static const array<uint8_t, 3u> BOM = { 0xEF, 0xBB, 0xBF };
 			stream.write(reinterpret_cast<char*>(const_cast<uint8_t*>(BOM.data())), BOM.size());
 		}
-		wstring_convert<std::codecvt_utf8<wchar_t>> codec_to_utf8;
-		stream << codec_to_utf8.to_bytes(str);
+		stream << ToUtf8(str);
 	}
-}
\ No newline at end of file
+
+
+
+	/// --------
+#ifdef _WIN32
+    typedef codecvt_utf8_utf16<wchar_t> codecvt_wide_t;   ///< wchar_t is UTF-16
+#else
+    typedef codecvt_utf8<wchar_t> codecvt_wide_t;         ///< wchar_t is UTF-32
+#endif
+
+    wstring ToWString(const string& utf8)
+    {
+        wstring_convert<codecvt_wide_t> codec;
+        return codec.from_bytes(utf8);
+    }
+
+    string ToUtf8(const wstring& wstr)
+    {
+        wstring_convert<codecvt_wide_t> codec;
+        return codec.to_bytes(wstr);
+    }
+}
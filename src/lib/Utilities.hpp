@@ -0,0 +1,80 @@
+/*
+3  *  Copyright (C) 2017 Christophe Meneboeuf <christophe@xtof.info>
+4  *
+5  *  This program is free software: you can redistribute it and/or modify
+6  *  it under the terms of the GNU General Public License as published by
+7  *  the Free Software Foundation, either version 3 of the License, or
+8  *  (at your option) any later version.
+9  *
+10  *  This program is distributed in the hope that it will be useful,
+11  *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+12  *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+13  *  GNU General Public License for more details.
+14  *
+15  *  You should have received a copy of the GNU General Public License
+16  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+17 */
+
+#ifndef _SRC_Utilities_hpp__
+#define _SRC_Utilities_hpp__
+
+#include <string>
+
+#include <boost/filesystem.hpp>
+
+#include "CompareFolders.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace  cf {
+
+    /// @brief Returns the UTF-8 representation of a path
+    /// @details On POSIX systems the native representation is used as is: no conversion occurs.
+    inline std::string ToUtf8(const fs::path& path)
+    {
+#ifdef _WIN32
+        return ToUtf8(path.native());
+#else
+        return path.native();
+#endif
+    }
+
+    /// @brief Returns the path represented by an UTF-8 string
+    inline fs::path ToPath(const std::string& utf8)
+    {
+#ifdef _WIN32
+        return fs::path{ ToWString(utf8) };
+#else
+        return fs::path{ utf8 };
+#endif
+    }
+
+    /// @brief Returns the UTF-8 representation of a path located inside root
+    /// @param path         A path, beginning with root
+    /// @param length_root  Length of the native representation of root
+    /// @details Much cheaper than fs::relative() which queries the filesystem.
+    inline std::string RelativeUtf8(const fs::path& path, std::size_t length_root)
+    {
+        const auto& native = path.native();
+#ifdef _WIN32
+        while (length_root < native.size() && (native[length_root] == L'\\' || native[length_root] == L'/')) {
+            ++length_root;
+        }
+        return ToUtf8(native.substr(length_root));
+#else
+        while (length_root < native.size() && native[length_root] == '/') {
+            ++length_root;
+        }
+        return native.substr(length_root);
+#endif
+    }
+
+    /// @brief Appends a string to a JSON document, quoting and escaping it
+    /// @param json The JSON document
+    /// @param utf8 The string to append, UTF-8 encoded
+    void AppendJsonString(std::string& json, const std::string& utf8);
+
+}
+
+
+#endif /* _SRC_Utilities_hpp__ */
@@ -17,6 +17,15 @@
 
 
 #include "CompareFolders.hpp"
+#include "CCollectionInfo.hpp"
+#include "CCollectionSpill.hpp"
+#include "CFactoryInfo.hpp"
+#include "CHashCache.hpp"
+#include "CFilter.hpp"
+#include "CHasher.hpp"
+#include "CHasherMulti.hpp"
+#include "CTreeGenerator.hpp"
+#include "CWatchFolder.hpp"
 
 #include "catch.hpp"
 
@@ -30,12 +39,20 @@
 #include <ctime>
 #include <stdexcept>
 #include <list>
+#include <limits>
+#include <map>
+#include <functional>
 #include <array>
 #include <vector>
 #include <string>
 #include <thread>
 #include <chrono>
 #include <iostream>
+#include <sstream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
 
 namespace fs = boost::filesystem;
 namespace pt = boost::property_tree;
@@ -57,6 +74,30 @@ pair<fs::path, fs::path> FoldersFast;
 static cf::diff_t Diff;
 
 
+/// @brief Logger keeping the last progress reported
+class CLoggerProgress : public cf::ILogger
+{
+public:
+    explicit CLoggerProgress(cf::progress_t& progress) : _progress(progress) {}
+    void error(const std::string&) override {}
+    void message(const std::string&) override {}
+    void progress(const cf::progress_t& progress) override { _progress = progress; }
+private:
+    cf::progress_t& _progress;
+};
+
+
+/// @brief Returns a JSON snapshot without the time of its scan, which differs from scan to scan
+string Without_Scan_Time(const string& json)
+{
+    const auto begin = json.find("    \"" + cf::JSON_KEYS.TIME_SCAN + "\"");
+    if (begin == string::npos) {
+        return json;
+    }
+    return json.substr(0u, begin) + json.substr(json.find('\n', begin) + 1u);
+}
+
+
 /// @rbrief returns the identical files
 list<fs::path> Get_Identical_Files(const fs::path& dir)
 {
@@ -332,6 +373,13 @@ pair<fs::path, fs::path> Build_Test_Fast_Files(unsigned nb_files, const fs::path
         fs::copy_file(info.path, folder_left / info.path.filename() );
     }
     Copy_Folder(folder_left, folder_right);
+    // The fast hash is sensitive to the nanoseconds: the copies shall not differ by a fraction of second
+    const auto time_copy = time(nullptr);
+    for (const auto& folder : { folder_left, folder_right }) {
+        for (const auto& entry : fs::recursive_directory_iterator(folder)) {
+            fs::last_write_time(entry.path(), time_copy);
+        }
+    }
 
 
     return { folder_left, folder_right };
@@ -525,19 +573,19 @@ TEST_CASE("NOMINAL SECURE")
     }
     for (auto& entry : Diff.unique_left) {
         if (find(begin(files_unique_left), end(files_unique_left), entry) == end(files_unique_left)) {
-            wcout << "NOT FOUND: " << entry;
+            cout << "NOT FOUND: " << entry;
         }
         REQUIRE(find(begin(files_unique_left), end(files_unique_left), entry) != end(files_unique_left));
     }
     for (auto& entry : Diff.unique_right) {
         if (find(begin(files_unique_right), end(files_unique_right), entry) == end(files_unique_right)) {
-            wcout << "NOT FOUND: " << entry;
+            cout << "NOT FOUND: " << entry;
         }
         REQUIRE(find(begin(files_unique_right), end(files_unique_right), entry) != end(files_unique_right));
     }
     for (auto& entry : Diff.renamed) {
         if (find(begin(files_renamed), end(files_renamed), *begin(entry.left)) == end(files_renamed)) {
-            wcout << "NOT FOUND: " << *begin(entry.left);
+            cout << "NOT FOUND: " << *begin(entry.left);
         }
         REQUIRE(find(begin(files_renamed), end(files_renamed), *begin(entry.left)) != end(files_renamed)); // Works because file were renamed in LEFT and there was no duplication
     }
@@ -600,7 +648,7 @@ TEST_CASE("JSON")
 			throw(runtime_error{ "Cannot create " + path_json_left.string() + " required to complete the test." });
 		}
 		auto json_left = cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::SECURE);
-		cf::WriteWString(stream_json_left, json_left);
+		stream_json_left << json_left;
 		stream_json_left.close();
 		// Save folder 2 as a JSON file
 		std::ofstream stream_json_right{ path_json_right.string(), ios::out };
@@ -608,7 +656,7 @@ TEST_CASE("JSON")
 			throw(runtime_error{ "Cannot create " + path_json_right.string() + " required to complete the test." });
 		}
 		auto json_right = cf::ScanFolder(Folders.second.string(), cf::eCollectingAlgorithm::SECURE);
-		cf::WriteWString(stream_json_right, json_right);
+		stream_json_right << json_right;
 		stream_json_right.close();
 
 		// Use the JSON files to compare the folders
@@ -622,7 +670,7 @@ TEST_CASE("JSON")
             throw(runtime_error{ "Cannot create " + path_json_right_fast.string() + " required to complete the test." });
         }
         auto json_right_fast = cf::ScanFolder(Folders.second.string(), cf::eCollectingAlgorithm::FAST);
-        cf::WriteWString(stream_json_right_fast, json_right_fast);
+        stream_json_right_fast << json_right_fast;
         stream_json_right_fast.close();
         // Comparison should throw an exception as the hashers are different
         bool exception = false;
@@ -672,3 +720,1477 @@ TEST_CASE("JSON")
 }
 
 
+
+TEST_CASE("NDJSON")
+{
+    /// @brief Counts the flushes of the stream
+    class CBufferFlushes : public stringbuf
+    {
+    public:
+        size_t flushes = 0u;
+    protected:
+        int sync() override {
+            ++flushes;
+            return stringbuf::sync();
+        }
+    };
+
+    // Stream the differences, then compare them to the ones collected
+    CBufferFlushes buffer;
+    ostream stream{ &buffer };
+    cf::CDiffWriterNdjson writer{ stream };
+    cf::CompareFolders(Folders.first.string(), Folders.second.string(), cf::eCollectingAlgorithm::SECURE, writer);
+    const auto diff = cf::CompareFolders(Folders.first.string(), Folders.second.string(), cf::eCollectingAlgorithm::SECURE);
+
+    const auto count = [](const string& ndjson, const string& key) {
+        size_t nb = 0u;
+        istringstream lines{ ndjson };
+        string line;
+        while (getline(lines, line)) {
+            if (line.compare(0u, key.size() + 4u, "{\"" + key + "\":") == 0) {
+                ++nb;
+            }
+        }
+        return nb;
+    };
+    const auto ndjson = buffer.str();
+    REQUIRE(count(ndjson, "identical") == diff.identical.size());
+    REQUIRE(count(ndjson, "different") == diff.different.size());
+    REQUIRE(count(ndjson, "unique left") == diff.unique_left.size());
+    REQUIRE(count(ndjson, "unique right") == diff.unique_right.size());
+    REQUIRE(count(ndjson, "renamed and duplicates") == diff.renamed.size());
+    REQUIRE(!diff.identical.empty());
+    REQUIRE(buffer.flushes == static_cast<size_t>(std::count(ndjson.begin(), ndjson.end(), '\n')));   // each record is flushed
+    for (const auto& entry : diff.identical) {
+        string record{ "{\"identical\":\"" };
+        record += entry + "\"}\n";
+        REQUIRE(ndjson.find(record) != string::npos);
+    }
+}
+
+
+
+TEST_CASE("WIDE STRINGS")
+{
+    // The former API, handling the paths as wide strings, is still available
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_wide" };
+    fs::remove_all(folder);
+    fs::create_directories(folder / "left");
+    fs::create_directories(folder / "right");
+    const wstring name{ L"αβγ €.txt" };
+    for (const auto& side : { "left", "right" }) {
+        fs::ofstream stream{ folder / side / name, ios::out | ios::binary };
+        stream << "content";
+    }
+    {
+        fs::ofstream stream{ folder / "left" / "unique", ios::out | ios::binary };
+        stream << "unique";
+    }
+
+    const auto left = (folder / "left").wstring();
+    const auto right = (folder / "right").wstring();
+    const cf::wdiff_t diff = cf::CompareFolders(left, right, cf::eCollectingAlgorithm::SECURE);
+    REQUIRE(diff.identical == list<wstring>{ name });
+    REQUIRE(diff.unique_left == list<wstring>{ L"unique" });
+    REQUIRE(diff.utf8() == cf::CompareFolders(cf::ToUtf8(left), cf::ToUtf8(right), cf::eCollectingAlgorithm::SECURE));
+    REQUIRE(cf::Json(diff) == cf::ToWString(cf::Json(diff.utf8())));
+    REQUIRE(cf::Json(diff).find(name) != wstring::npos);
+    REQUIRE(cf::ScanFolder(left, cf::eCollectingAlgorithm::FAST).find(name) != wstring::npos);
+
+    fs::remove_all(folder);
+}
+
+
+
+TEST_CASE("JSON PARALLEL LOADING")
+{
+    // Build a file large enough to be split among several threads
+    constexpr unsigned NB_FILES = 50000u;
+    const fs::path path_json{ fs::temp_directory_path() / "compare_folder_parallel.json" };
+    {
+        std::ofstream stream{ path_json.string(), ios::out | ios::binary };
+        stream << "{\n    \"Generator\": \"info.xtof.COMPARE_FOLDERS\",\n    \"hash\": \"secure\",\n    \"root\": \"\\/tmp\\/root\",\n    \"files\": {\n";
+        for (auto i = 0u; i < NB_FILES; ++i) {
+            stream << "        \"dir_" << i % 100u << "\\/file \\\"" << i << "\\\" \\u00e9\\u50c3\": {\n"
+                   << "            \"hash\": \"" << Random_String(39u) << "\",\n"
+                   << "            \"last_modified\": \"" << i << "\",\n"
+                   << "            \"size\": \"" << rand() << "\"\n"
+                   << "        }" << (i + 1u < NB_FILES ? ",\n" : "\n");
+        }
+        stream << "    }\n}\n";
+    }
+
+    auto collection_single = cf::AFactoryInfo::ReadInfo(path_json, 1u);
+    auto collection_parallel = cf::AFactoryInfo::ReadInfo(path_json, 8u);
+
+    REQUIRE(collection_single.size() == NB_FILES);
+    REQUIRE(collection_parallel.size() == NB_FILES);
+    const auto json = collection_parallel.json();
+    REQUIRE(json == collection_single.json());
+    REQUIRE(json.find("dir_7/file \\\"7\\\" \xC3\xA9\xE5\x83\x83") != string::npos);
+
+    fs::remove(path_json);
+}
+
+
+
+TEST_CASE("HASH CACHE")
+{
+    const fs::path path_cache{ fs::temp_directory_path() / "compare_folder_hashes.cache" };
+    fs::remove(path_cache);
+
+    // Entries survive a save and are invalidated by any change of their status
+    const cf::CHashCache::stat_t stat{ 1u, 42u, 1234u, 1500000000123456789, 1500000000987654321 };
+    {
+        cf::CHashCache cache{ path_cache, "secure" };
+        string hash;
+        REQUIRE(cache.find(stat, hash) == false);
+        cache.add(stat, "0123456789ABCDEF");
+        cache.save();
+    }
+    {
+        const cf::CHashCache cache{ path_cache, "secure" };
+        string hash;
+        REQUIRE(cache.find(stat, hash) == true);
+        REQUIRE(hash == "0123456789ABCDEF");
+        REQUIRE(cache.hits() == 1u);
+        auto stat_modified = stat;
+        stat_modified.time_changed_ns += 1;
+        REQUIRE(cache.find(stat_modified, hash) == false);
+        stat_modified = stat;
+        stat_modified.size += 1u;
+        REQUIRE(cache.find(stat_modified, hash) == false);
+    }
+    {
+        const cf::CHashCache cache{ path_cache, "fast" };
+        string hash;
+        REQUIRE(cache.find(stat, hash) == false);
+    }
+    fs::remove(path_cache);
+
+    // Scanning with a cache does not alter the result
+    cf::options_t options;
+    options.path_cache = path_cache.string();
+    const auto json = cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::SECURE);
+    REQUIRE(Without_Scan_Time(cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options)) == Without_Scan_Time(json));
+    REQUIRE(fs::exists(path_cache));
+    REQUIRE(Without_Scan_Time(cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options)) == Without_Scan_Time(json));
+    fs::remove(path_cache);
+
+    // The entries neither found nor touched are dropped when saving
+    const auto stat_other = cf::CHashCache::stat_t{ 1u, 43u, 1234u, 1500000000123456789, 1500000000987654321 };
+    {
+        cf::CHashCache cache{ path_cache, "secure" };
+        cache.add(stat, "0123456789ABCDEF");
+        cache.add(stat_other, "FEDCBA9876543210");
+        cache.save();
+    }
+    {
+        cf::CHashCache cache{ path_cache, "secure" };
+        string hash;
+        REQUIRE(cache.find(stat, hash));
+        cache.save();
+    }
+    {
+        const cf::CHashCache cache{ path_cache, "secure" };
+        string hash;
+        REQUIRE(cache.find(stat, hash));
+        REQUIRE(!cache.find(stat_other, hash));
+    }
+    fs::remove(path_cache);
+
+#ifndef _WIN32
+    // Comparing two folders with a cache keeps the entries of both, but drops the files removed
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_cache" };
+    fs::remove_all(folder);
+    fs::create_directories(folder / "left");
+    fs::create_directories(folder / "right");
+    for (const auto& file : { "left/a", "left/b", "right/c" }) {
+        std::ofstream stream{ (folder / file).string(), ios::out | ios::binary };
+        stream << file;
+    }
+    this_thread::sleep_for(chrono::milliseconds{ 1500 }); // beyond the margin of the timestamps' granularity
+    const auto compare = [&folder, &options] {
+        options.stats = make_shared<cf::stats_t>();
+        cf::CompareFolders((folder / "left").string(), (folder / "right").string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options);
+        return options.stats->cache_hits;
+    };
+    REQUIRE(compare() == 0u);
+    REQUIRE(compare() == 3u);
+    cf::CHashCache::stat_t stat_a, stat_b;
+    REQUIRE(cf::CHashCache::ReadStat(folder / "left/a", stat_a));
+    REQUIRE(cf::CHashCache::ReadStat(folder / "left/b", stat_b));
+    fs::remove(folder / "left/b");
+    REQUIRE(compare() == 2u);
+    {
+        const cf::CHashCache cache{ path_cache, "secure" };
+        string hash;
+        REQUIRE(cache.find(stat_a, hash));
+        REQUIRE(!cache.find(stat_b, hash));
+    }
+    fs::remove_all(folder);
+    fs::remove(path_cache);
+#endif
+}
+
+
+
+TEST_CASE("INCREMENTAL SCAN")
+{
+    const fs::path path_json{ fs::temp_directory_path() / "compare_folder_baseline.json" };
+    const auto json = cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::SECURE);
+    {
+        std::ofstream stream{ path_json.string(), ios::out };
+        stream << json;
+    }
+
+    // Nothing changed: same result as a full scan
+    REQUIRE(Without_Scan_Time(cf::ScanFolder(Folders.first.string(), cf::json_t{ path_json.string() })) == Without_Scan_Time(json));
+
+    // A folder whose files changed: the modified ones must be hashed again
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_incremental" };
+    fs::remove_all(folder);
+    fs::create_directories(folder);
+    const auto write = [&folder](const string& name, const string& content) {
+        std::ofstream stream{ (folder / name).string(), ios::out | ios::binary };
+        stream << content;
+    };
+    write("unchanged", "unchanged");
+    write("modified", "before");
+    {
+        std::ofstream stream{ path_json.string(), ios::out };
+        stream << cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE);
+    }
+    write("modified", "after, with a different size");
+    write("added", "added");
+    const auto json_full = cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE);
+    REQUIRE(Without_Scan_Time(cf::ScanFolder(folder.string(), cf::json_t{ path_json.string() })) == Without_Scan_Time(json_full));
+
+    // Rewritten at the same size within the second of the baseline's scan: hashed again
+    const auto time_scan = time(nullptr);
+    write("rewritten", "before");
+    fs::last_write_time(folder / "rewritten", time_scan);
+    {
+        std::ofstream stream{ path_json.string(), ios::out };
+        stream << cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE);
+    }
+    write("rewritten", "after!");
+    fs::last_write_time(folder / "rewritten", time_scan);
+    REQUIRE(Without_Scan_Time(cf::ScanFolder(folder.string(), cf::json_t{ path_json.string() }))
+        == Without_Scan_Time(cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE)));
+
+    // Modified well before the baseline's scan: carried forward, unless the baseline does not tell its scan time
+    for (const auto& name : { "unchanged", "modified", "added", "rewritten" }) {
+        fs::last_write_time(folder / name, time_scan - 3600);
+    }
+    const auto json_baseline = cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE);
+    for (const auto& baseline : { json_baseline, Without_Scan_Time(json_baseline) }) {
+        {
+            std::ofstream stream{ path_json.string(), ios::out };
+            stream << baseline;
+        }
+        cf::options_t options;
+        options.stats = make_shared<cf::stats_t>();
+        cf::ScanFolder(folder.string(), cf::json_t{ path_json.string() }, make_unique<cf::CLoggerNull>(), options);
+        REQUIRE(options.stats->cache_hits == ((baseline == json_baseline) ? 4u : 0u));
+    }
+
+    fs::remove_all(folder);
+    fs::remove(path_json);
+}
+
+
+
+TEST_CASE("MERKLE")
+{
+    cf::CCollectionInfo left{ "left", cf::eCollectingAlgorithm::SECURE };
+    left.setInfo("a/x", { "11", 0, 1u });
+    left.setInfo("a/b/y", { "22", 0, 1u });
+    left.setInfo("a.txt", { "33", 0, 1u });
+    left.setInfo("c/z", { "44", 0, 1u });
+    left.setInfo("c/w", { "55", 0, 1u });
+    auto right = left;
+    right.setInfo("c/z", { "66", 0, 1u });
+    right.setInfo("d/w", { "55", 0, 1u });
+    right.removePath("c/w");
+
+    // Only the directories whose content changed have a different digest
+    const auto& digests_left = left.digests();
+    const auto& digests_right = right.digests();
+    REQUIRE(digests_left.size() == 4u);
+    REQUIRE(digests_left.at("a") == digests_right.at("a"));
+    REQUIRE(digests_left.at("a/b") == digests_right.at("a/b"));
+    REQUIRE(digests_left.at("c") != digests_right.at("c"));
+    REQUIRE(digests_left.at("") != digests_right.at(""));
+
+    // Pruning the identical directories does not alter the differences
+    const auto diff = left.compare(right);
+    REQUIRE(diff.identical == list<string>{ "a.txt", "a/b/y", "a/x" });
+    REQUIRE(diff.different == list<string>{ "c/z" });
+    REQUIRE(diff.unique_left.empty());
+    REQUIRE(diff.unique_right.empty());
+    REQUIRE(diff.renamed.size() == 1u);
+    REQUIRE(diff.renamed.front().left == list<string>{ "c/w" });
+    REQUIRE(diff.renamed.front().right == list<string>{ "d/w" });
+    REQUIRE(left.compare(left).identical.size() == left.size());
+
+    // The digests are computed once, whichever thread requires them first
+    const auto copy = left;
+    vector<map<string, string>> digests_copy(4u);
+    {
+        vector<thread> threads;
+        for (auto& digests : digests_copy) {
+            threads.emplace_back([&copy, &digests]() { digests = copy.digests(); });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    for (const auto& digests : digests_copy) {
+        REQUIRE(digests == digests_left);
+    }
+
+    // The digests are stored in the snapshots, only if requested
+    REQUIRE(left.json().find("\"directories\"") == string::npos);
+    const fs::path path_json{ fs::temp_directory_path() / "compare_folder_merkle.json" };
+    {
+        std::ofstream stream{ path_json.string(), ios::out };
+        stream << left.json(true);
+    }
+    const auto loaded = cf::AFactoryInfo::ReadInfo(path_json);
+    REQUIRE(loaded.digests() == digests_left);
+    fs::remove(path_json);
+}
+
+
+
+TEST_CASE("DELTA")
+{
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_delta" };
+    const fs::path path_base{ fs::temp_directory_path() / "compare_folder_base.json" };
+    const fs::path path_delta_1{ fs::temp_directory_path() / "compare_folder_delta_1.json" };
+    const fs::path path_delta_2{ fs::temp_directory_path() / "compare_folder_delta_2.json" };
+    const fs::path path_current{ fs::temp_directory_path() / "compare_folder_current.json" };
+    fs::remove_all(folder);
+    fs::create_directories(folder / "sub");
+    const auto write = [](const fs::path& path, const string& content) {
+        std::ofstream stream{ path.string(), ios::out | ios::binary };
+        stream << content;
+    };
+    write(folder / "unchanged", "unchanged");
+    write(folder / "modified", "before");
+    write(folder / "sub/removed", "removed");
+    write(path_base, cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE));
+
+    // First night
+    write(folder / "modified", "after, with a different size");
+    write(folder / "sub/added", "added");
+    fs::remove(folder / "sub/removed");
+    const auto delta_1 = cf::ScanFolderDelta(folder.string(), cf::json_t{ path_base.string() });
+    REQUIRE(delta_1.find("unchanged") == string::npos);
+    write(path_delta_1, delta_1);
+
+    // Second night
+    write(folder / "added", "added");
+    fs::remove(folder / "modified");
+    write(path_delta_2, cf::ScanFolderDelta(folder.string(), cf::json_t{ path_base.string(), { path_delta_1.string() } }));
+
+    // The chain rebuilds the current state
+    write(path_current, cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE));
+    const auto diff = cf::CompareFolders(cf::json_t{ path_base.string(), { path_delta_1.string(), path_delta_2.string() } }, cf::json_t{ path_current.string() });
+    REQUIRE(diff.identical.size() == 3u);
+    REQUIRE(diff.different.empty());
+    REQUIRE(diff.unique_left.empty());
+    REQUIRE(diff.unique_right.empty());
+    REQUIRE(diff.renamed.empty());
+
+    // A broken chain is detected
+    bool exception = false;
+    try {
+        cf::CompareFolders(cf::json_t{ path_base.string(), { path_delta_2.string() } }, cf::json_t{ path_current.string() });
+    }
+    catch (const cf::ExceptionFatal&) {
+        exception = true;
+    }
+    REQUIRE(exception == true);
+
+    // Rewritten at the same size within the second of the base's scan: listed as modified
+    const auto time_scan = time(nullptr);
+    fs::last_write_time(folder / "unchanged", time_scan);
+    write(path_base, cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE));
+    write(folder / "unchanged", "rewritten");
+    fs::last_write_time(folder / "unchanged", time_scan);
+    const auto delta_3 = cf::ScanFolderDelta(folder.string(), cf::json_t{ path_base.string() });
+    REQUIRE(delta_3.find("\"unchanged\"") != string::npos);
+    write(path_delta_1, delta_3);
+    write(path_current, cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE));
+    const auto diff_rewritten = cf::CompareFolders(cf::json_t{ path_base.string(), { path_delta_1.string() } }, cf::json_t{ path_current.string() });
+    REQUIRE(diff_rewritten.identical.size() == 3u);
+    REQUIRE(diff_rewritten.different.empty());
+
+    fs::remove_all(folder);
+    for (const auto& path : { path_base, path_delta_1, path_delta_2, path_current }) {
+        fs::remove(path);
+    }
+}
+
+
+TEST_CASE("PROGRESS")
+{
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_progress" };
+    fs::remove_all(folder);
+    fs::create_directories(folder / "sub");
+    const auto write = [](const fs::path& path, const string& content) {
+        std::ofstream stream{ path.string(), ios::out | ios::binary };
+        stream << content;
+    };
+    write(folder / "a", "12345");
+    write(folder / "sub/b", "1234567890");
+    write(folder / "sub/c", "");
+
+    // The last report is sent once the operation is done
+    cf::options_t options;
+    options.period_progress_ms = 10u;
+    cf::progress_t progress{ 0u, 0u, 0u, 0u, 0.0 };
+    cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE, make_unique<CLoggerProgress>(progress), options);
+    REQUIRE(progress.files_enumerated == 3u);
+    REQUIRE(progress.files_hashed == 3u);
+    REQUIRE(progress.bytes_hashed == 15u);
+    REQUIRE(progress.files_compared == 0u);
+    REQUIRE(progress.eta() == 0.0);
+
+    progress = cf::progress_t{ 0u, 0u, 0u, 0u, 0.0 };
+    cf::CompareFolders(folder.string(), folder.string(), cf::eCollectingAlgorithm::FAST, make_unique<CLoggerProgress>(progress), options);
+    REQUIRE(progress.files_enumerated == 6u);
+    REQUIRE(progress.files_hashed == 6u);
+    REQUIRE(progress.files_compared == 3u);
+
+    // No report if disabled
+    options.period_progress_ms = 0u;
+    progress = cf::progress_t{ 0u, 0u, 0u, 0u, 0.0 };
+    cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE, make_unique<CLoggerProgress>(progress), options);
+    REQUIRE(progress.files_enumerated == 0u);
+
+    fs::remove_all(folder);
+}
+
+
+TEST_CASE("STATS")
+{
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_stats" };
+    fs::remove_all(folder);
+    fs::create_directories(folder / "sub");
+    {
+        std::ofstream stream{ (folder / "small").string(), ios::out | ios::binary };
+        stream << "1234567890";
+    }
+    {
+        std::ofstream stream{ (folder / "sub/large").string(), ios::out | ios::binary };
+        stream << string(100000u, 'x');
+    }
+    {
+        std::ofstream stream{ (folder / "sub/empty").string(), ios::out | ios::binary };
+    }
+
+    // Scanning
+    cf::options_t options;
+    options.stats = make_shared<cf::stats_t>();
+    const auto json = cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options);
+    REQUIRE(options.stats->files_hashed == 3u);
+    REQUIRE(options.stats->bytes_hashed == 100010u);
+    REQUIRE(options.stats->files_compared == 0u);
+    REQUIRE(options.stats->operations >= 3u * 3u);
+    REQUIRE(options.stats->hashing.wall > 0.0);
+    REQUIRE(options.stats->serializing.wall > 0.0);
+    REQUIRE(options.stats->comparing.wall == 0.0);
+    REQUIRE(options.stats->total.wall >= options.stats->serializing.wall);
+#ifndef _WIN32
+    REQUIRE(options.stats->memory_peak > 0u);
+#endif
+
+    // Comparing two folders
+    options.stats = make_shared<cf::stats_t>();
+    cf::CompareFolders(folder.string(), folder.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options);
+    REQUIRE(options.stats->files_hashed == 6u);
+    REQUIRE(options.stats->files_compared == 3u);
+    REQUIRE(options.stats->comparing.wall > 0.0);
+
+    // A file renamed counts once, whatever the size of its group
+    const fs::path folder_renamed{ fs::temp_directory_path() / "compare_folder_stats_renamed" };
+    fs::remove_all(folder_renamed);
+    fs::create_directories(folder_renamed / "sub");
+    fs::copy_file(folder / "small", folder_renamed / "moved");
+    fs::copy_file(folder / "small", folder_renamed / "copy");
+    fs::copy_file(folder / "sub/large", folder_renamed / "sub/large");
+    fs::copy_file(folder / "sub/empty", folder_renamed / "sub/empty");
+    options.stats = make_shared<cf::stats_t>();
+    const auto diff_renamed = cf::CompareFolders(folder.string(), folder_renamed.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options);
+    REQUIRE(diff_renamed.renamed.size() == 1u);
+    REQUIRE(diff_renamed.renamed.front().right.size() == 2u);
+    REQUIRE(options.stats->files_compared == 3u);
+    fs::remove_all(folder_renamed);
+
+    // Comparing two JSON files: nothing is hashed
+    const fs::path path_json{ fs::temp_directory_path() / "compare_folder_stats.json" };
+    {
+        std::ofstream stream{ path_json.string(), ios::out };
+        stream << json;
+    }
+    options.stats = make_shared<cf::stats_t>();
+    cf::CompareFolders(cf::json_t{ path_json.string() }, cf::json_t{ path_json.string() }, options);
+    REQUIRE(options.stats->files_hashed == 0u);
+    REQUIRE(options.stats->files_compared == 3u);
+    REQUIRE(options.stats->parsing.wall > 0.0);
+
+    fs::remove(path_json);
+    fs::remove_all(folder);
+}
+
+TEST_CASE("FILTER")
+{
+    // Patterns
+    const cf::CFilter filter{ {}, { "# comment", ".git/", "build", "*.o", "!keep.o", "/top.txt", "doc/**/*.tmp", "**/cache/", "file[0-9].log", "a?c" } };
+    REQUIRE(!filter.empty());
+    REQUIRE(filter.isExcluded(".git", true));
+    REQUIRE(!filter.isExcluded(".git", false));
+    REQUIRE(filter.isExcluded("src/.git", true));
+    REQUIRE(filter.isExcluded("build", false));
+    REQUIRE(filter.isExcluded("src/build", true));
+    REQUIRE(filter.isExcluded("src/main.o", false));
+    REQUIRE(!filter.isExcluded("src/keep.o", false));
+    REQUIRE(filter.isExcluded("top.txt", false));
+    REQUIRE(!filter.isExcluded("src/top.txt", false));
+    REQUIRE(filter.isExcluded("doc/a.tmp", false));
+    REQUIRE(filter.isExcluded("doc/a/b/c.tmp", false));
+    REQUIRE(!filter.isExcluded("src/doc/a.tmp", false));
+    REQUIRE(filter.isExcluded("cache", true));
+    REQUIRE(filter.isExcluded("a/b/cache", true));
+    REQUIRE(filter.isExcluded("file7.log", false));
+    REQUIRE(!filter.isExcluded("fileA.log", false));
+    REQUIRE(filter.isExcluded("abc", false));
+    REQUIRE(!filter.isExcluded("a/c", false));
+    REQUIRE(!filter.isExcluded("# comment", false));
+    REQUIRE(filter.excludesTree("src/build/debug"));
+    REQUIRE(!filter.excludesTree("src/debug"));
+    REQUIRE(!filter.accepts("build/main.cpp"));
+    REQUIRE(!filter.accepts("src/main.o/file"));
+    REQUIRE(filter.accepts("src/keep.o/file"));
+    REQUIRE(filter.accepts("src/main.cpp"));
+
+    const cf::CFilter includes{ { "src/", "*.md", "!*.txt" }, { "src/generated/" } };
+    REQUIRE(includes.isIncluded("src/a/b.cpp"));
+    REQUIRE(!includes.isIncluded("src/a/b.txt"));
+    REQUIRE(includes.isIncluded("doc/readme.md"));
+    REQUIRE(!includes.isIncluded("doc/readme.rst"));
+    REQUIRE(!includes.accepts("src/generated/a.cpp"));
+    REQUIRE(cf::CFilter{ {}, {} }.empty());
+    REQUIRE(cf::CFilter{ {}, {} }.accepts("anything"));
+
+    // The nested paths, with their native separators
+    const cf::CFilter nested{ { "src/" }, { "src/gen/*.tmp" } };
+    REQUIRE(!nested.accepts((fs::path{ "src" } / "gen" / "a.tmp").string()));
+    REQUIRE(nested.accepts((fs::path{ "src" } / "gen" / "deep" / "a.tmp").string()));
+    REQUIRE(nested.accepts((fs::path{ "src" } / "a.tmp").string()));
+    REQUIRE(!nested.accepts((fs::path{ "doc" } / "gen" / "a.txt").string()));
+    REQUIRE(nested.excludesTree((fs::path{ "src" } / "gen" / "a.tmp").string()));
+
+    // Scanning: the excluded directories are not listed
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_filter" };
+    fs::remove_all(folder);
+    for (const auto& directory : { "src", "build/obj", ".git", "src/.git" }) {
+        fs::create_directories(folder / directory);
+    }
+    for (const auto& file : { "src/main.cpp", "src/main.o", "src/.git/HEAD", "build/obj/main.o", "build/out", ".git/HEAD", "README.md" }) {
+        std::ofstream stream{ (folder / file).string(), ios::out | ios::binary };
+        stream << file;
+    }
+    cf::options_t options;
+    options.excludes = { ".git/", "build/", "*.o" };
+    for (const auto algo : { cf::eCollectingAlgorithm::SECURE, cf::eCollectingAlgorithm::FAST }) {
+        options.stats = make_shared<cf::stats_t>();
+        const auto json = cf::ScanFolder(folder.string(), algo, make_unique<cf::CLoggerNull>(), options);
+        REQUIRE(json.find("main.cpp") != string::npos);
+        REQUIRE(json.find("README.md") != string::npos);
+        REQUIRE(json.find(".o\"") == string::npos);
+        REQUIRE(json.find("HEAD") == string::npos);
+        REQUIRE(json.find("out") == string::npos);
+        REQUIRE(options.stats->files_hashed == 2u);
+    }
+
+    options.includes = { "src/" };
+    const auto diff = cf::CompareFolders(folder.string(), folder.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options);
+    REQUIRE(diff.identical == list<string>{ "src/main.cpp" });
+
+    // The JSON files compared, and the baselines, are filtered the same way
+    const fs::path path_json{ fs::temp_directory_path() / "compare_folder_filter.json" };
+    {
+        std::ofstream stream{ path_json.string(), ios::out };
+        stream << cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE);
+    }
+    const cf::json_t json{ path_json.string() };
+    options = cf::options_t{};
+    options.excludes = { ".git/", "build/", "*.o" };
+    for (const size_t budget : { 0u, 4096u }) {
+        options.memory_budget = budget;
+        auto diff_json = cf::CompareFolders(folder.string(), json, make_unique<cf::CLoggerNull>(), options);
+        REQUIRE(diff_json.identical == list<string>{ "README.md", "src/main.cpp" });
+        REQUIRE(diff_json.unique_right.empty());
+        diff_json = cf::CompareFolders(json, json, options);
+        REQUIRE(diff_json.identical == list<string>{ "README.md", "src/main.cpp" });
+    }
+    options.memory_budget = 0u;
+    const auto json_baseline = cf::ScanFolder(folder.string(), json, make_unique<cf::CLoggerNull>(), options);
+    REQUIRE(json_baseline.find("main.cpp") != string::npos);
+    REQUIRE(json_baseline.find("HEAD") == string::npos);
+
+    // The anchored patterns apply to the nested paths, when scanning and when filtering a JSON file
+    fs::create_directories(folder / "src/gen/deep");
+    for (const auto& file : { "src/gen/a.tmp", "src/gen/deep/b.tmp" }) {
+        std::ofstream stream{ (folder / file).string(), ios::out | ios::binary };
+        stream << file;
+    }
+    {
+        std::ofstream stream{ path_json.string(), ios::out };
+        stream << cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE);
+    }
+    options = cf::options_t{};
+    options.excludes = { ".git/", "build/", "src/gen/*.tmp" };
+    const auto json_nested = cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options);
+    REQUIRE(json_nested.find("a.tmp") == string::npos);
+    REQUIRE(json_nested.find("b.tmp") != string::npos);
+    const auto diff_nested = cf::CompareFolders(json, json, options);
+    REQUIRE(diff_nested.identical == list<string>{ "README.md", "src/gen/deep/b.tmp", "src/main.cpp", "src/main.o" });
+
+    fs::remove(path_json);
+    fs::remove_all(folder);
+}
+
+TEST_CASE("SAMPLING")
+{
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_sampling" };
+    fs::remove_all(folder);
+    fs::create_directories(folder / "left");
+    const auto write = [](const fs::path& path, const string& content) {
+        std::ofstream stream{ path.string(), ios::out | ios::binary };
+        stream << content;
+    };
+    const auto size_block = 64u * 1024u;
+    string content(2u * 1024u * 1024u, '\0');
+    for (auto i = 0u; i < content.size(); ++i) {
+        content[i] = static_cast<char>(i * 7u + i / 251u);
+    }
+    write(folder / "left/large", content);
+    write(folder / "left/small", "small");
+
+    cf::options_t options;
+    options.size_sampling = 1024u * 1024u;
+    options.nb_samples = 4u;
+    const cf::CFactoryInfoSecure full{ make_unique<cf::CLoggerNull>() };
+    const cf::CFactoryInfoSecure sampling{ make_unique<cf::CLoggerNull>(), options };
+    const auto hash_full = full.collectFile(folder / "left/large").hash;
+    const auto hash_sampled = sampling.collectFile(folder / "left/large").hash;
+    REQUIRE(hash_full.find(cf::JSON_CONST_VALUES.HASH_SAMPLED) == string::npos);
+    const auto tag = cf::JSON_CONST_VALUES.HASH_SAMPLED + "1048576x4:";
+    REQUIRE(hash_sampled.find(tag) == 0u);
+    REQUIRE(hash_sampled.size() == tag.size() + hash_full.size());
+    REQUIRE(cf::CCollectionInfo::HashSampling(hash_sampled) == tag);
+    REQUIRE(cf::CCollectionInfo::HashSampling(hash_full).empty());
+    REQUIRE(sampling.collectFile(folder / "left/small").hash == full.collectFile(folder / "left/small").hash);
+
+    // Only the samples are read
+    options.stats = make_shared<cf::stats_t>();
+    const auto json = cf::ScanFolder((folder / "left").string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options);
+    REQUIRE(json.find(hash_sampled) != string::npos);
+    REQUIRE(options.stats->bytes_hashed == 6u * size_block + 5u);
+
+    // The sampled blocks and the size are covered, not the bytes in between
+    auto modified = content;
+    modified[10u] ^= 1;
+    write(folder / "right_head", modified);
+    REQUIRE(sampling.collectFile(folder / "right_head").hash != hash_sampled);
+    modified = content;
+    modified[content.size() - 1u] ^= 1;
+    write(folder / "right_tail", modified);
+    REQUIRE(sampling.collectFile(folder / "right_tail").hash != hash_sampled);
+    modified = content;
+    modified[2u * size_block] ^= 1;
+    write(folder / "right_between", modified);
+    REQUIRE(sampling.collectFile(folder / "right_between").hash == hash_sampled);
+    REQUIRE(full.collectFile(folder / "right_between").hash != hash_full);
+    write(folder / "right_longer", content + '\0');
+    REQUIRE(sampling.collectFile(folder / "right_longer").hash != hash_sampled);
+
+    // Small enough to be read whole
+    options.nb_samples = 30u;
+    const cf::CFactoryInfoSecure dense{ make_unique<cf::CLoggerNull>(), options };
+    REQUIRE(dense.collectFile(folder / "left/large").hash == hash_full);
+
+    // A baseline sampled differently is hashed again
+    cf::CFactoryInfoSecure rescan_full{ make_unique<cf::CLoggerNull>() };
+    cf::options_t options_sampled;
+    options_sampled.size_sampling = 1024u * 1024u;
+    options_sampled.nb_samples = 4u;
+    cf::CFactoryInfoSecure rescan_sampled{ make_unique<cf::CLoggerNull>(), options_sampled };
+    const auto baseline_sampled = rescan_sampled.collectInfo(folder / "left");
+    const auto baseline_full = rescan_full.collectInfo(folder / "left");
+    REQUIRE(rescan_full.collectInfo(folder / "left", &baseline_sampled).find("large")->hash == hash_full);
+    REQUIRE(rescan_sampled.collectInfo(folder / "left", &baseline_full).find("large")->hash == hash_sampled);
+    REQUIRE(rescan_sampled.collectInfo(folder / "left", &baseline_sampled).find("large")->hash == hash_sampled);
+
+    // Snapshots sampled differently cannot be compared
+    options.nb_samples = 5u;
+    cf::CFactoryInfoSecure other{ make_unique<cf::CLoggerNull>(), options };
+    const auto collection_other = other.collectInfo(folder / "left");
+    REQUIRE_THROWS_AS(baseline_sampled.compare(collection_other), cf::ExceptionFatal);
+    REQUIRE_THROWS_AS(baseline_sampled.compare(baseline_full), cf::ExceptionFatal);
+    REQUIRE(baseline_sampled.compare(baseline_sampled).identical.size() == 2u);
+
+    // No overflow with the largest number of samples: the file is then read whole
+    options.nb_samples = std::numeric_limits<unsigned>::max();
+    const cf::CFactoryInfoSecure most{ make_unique<cf::CLoggerNull>(), options };
+    REQUIRE(most.collectFile(folder / "left/large").hash == hash_full);
+
+    fs::remove_all(folder);
+}
+
+TEST_CASE("HASHER")
+{
+    const string content{ "abc" };
+    const string million(1000000u, 'a');
+
+    cf::CHasher sha1;
+    REQUIRE(sha1.name() == "SHA-1");
+    REQUIRE(!sha1.provider().empty());
+    sha1.update(content.data(), content.size());
+    REQUIRE(sha1.digest() == "A9993E364706816ABA3E25717850C26C9CD0D89D");
+    // Restarted after each digest, fed by chunks of any size
+    for (size_t pos = 0u, size = 1u; pos < million.size(); pos += size, size = size * 3u + 1u) {
+        sha1.update(million.data() + pos, min(size, million.size() - pos));
+    }
+    REQUIRE(sha1.digest() == "34AA973CD4C4DAA4F61EEB2BDBAD27316534016F");
+    REQUIRE(sha1.digest() == "DA39A3EE5E6B4B0D3255BFEF95601890AFD80709");
+
+    cf::CHasher sha256{ cf::CHasher::eAlgorithm::SHA256 };
+    REQUIRE(sha256.name() == "SHA-256");
+    sha256.update(content.data(), content.size());
+    REQUIRE(sha256.digest() == "BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD");
+    sha256.update(million.data(), million.size());
+    REQUIRE(sha256.digest() == "CDC76E5C9914FB9281A1C7E284D73E67F1809A48A497200E046D39CCC7112CD0");
+
+    // Multi-buffer: same digests, whatever the lengths around the padding boundaries
+    REQUIRE(cf::CHasherMulti::Lanes() >= 1u);
+    vector<string> messages;
+    for (auto size = 0u; size < 300u; ++size) {
+        string message(size, '\0');
+        for (auto& byte : message) {
+            byte = static_cast<char>(rand());
+        }
+        messages.push_back(std::move(message));
+    }
+    messages.push_back(million);
+    messages.push_back(content);
+    const auto digests = cf::CHasherMulti::Digests(messages);
+    REQUIRE(digests.size() == messages.size());
+    for (auto i = 0u; i < messages.size(); ++i) {
+        sha1.update(messages[i].data(), messages[i].size());
+        REQUIRE(digests[i] == sha1.digest());
+    }
+    REQUIRE(cf::CHasherMulti::Digests(vector<string>{}).empty());
+}
+
+#ifndef _WIN32
+TEST_CASE("NANOSECONDS")
+{
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_nanoseconds" };
+    fs::remove_all(folder);
+    fs::create_directories(folder / "left");
+    fs::create_directories(folder / "right");
+    for (const auto& side : { "left", "right" }) {
+        std::ofstream stream{ (folder / side / "file").string(), ios::out | ios::binary };
+        stream << "same size";
+    }
+    const auto set_time = [](const fs::path& path, const time_t seconds, const long nanoseconds) {
+        const timespec times[2] = { { seconds, nanoseconds }, { seconds, nanoseconds } };
+        REQUIRE(utimensat(AT_FDCWD, path.c_str(), times, 0) == 0);
+    };
+    const time_t seconds = 1500000000;
+    set_time(folder / "left" / "file", seconds, 0);
+    set_time(folder / "right" / "file", seconds, 0);
+
+    // The status is read in nanoseconds
+    cf::CHashCache::stat_t stat;
+    REQUIRE(cf::CHashCache::ReadStat(folder / "left" / "file", stat));
+    REQUIRE(stat.size == 9u);
+    REQUIRE(stat.time_modified_ns == int64_t{ seconds } * 1000000000);
+    REQUIRE(stat.links == 1u);
+    REQUIRE(stat.regular);
+    cf::CHashCache::stat_t stat_directory;
+    REQUIRE(cf::CHashCache::ReadStat(folder / "left", stat_directory));
+    REQUIRE(!stat_directory.regular);
+    struct stat status;
+    REQUIRE(::stat((folder / "left" / "file").c_str(), &status) == 0);
+    REQUIRE(stat.device == static_cast<uint64_t>(status.st_dev));
+    REQUIRE(stat.inode == static_cast<uint64_t>(status.st_ino));
+
+    // Same second, same size
+    auto diff = cf::CompareFolders((folder / "left").string(), (folder / "right").string(), cf::eCollectingAlgorithm::FAST);
+    REQUIRE(diff.identical.size() == 1u);
+
+    // Rewritten within the same second: not identical anymore
+    set_time(folder / "right" / "file", seconds, 500000000);
+    REQUIRE(cf::CHashCache::ReadStat(folder / "right" / "file", stat));
+    REQUIRE(stat.time_modified_ns == int64_t{ seconds } * 1000000000 + 500000000);
+    diff = cf::CompareFolders((folder / "left").string(), (folder / "right").string(), cf::eCollectingAlgorithm::FAST);
+    REQUIRE(diff.different.size() == 1u);
+
+    // The JSON records the time in seconds, then its fraction
+    pt::ptree tree;
+    std::istringstream stream{ cf::ScanFolder((folder / "right").string(), cf::eCollectingAlgorithm::FAST) };
+    pt::read_json(stream, tree);
+    REQUIRE(stream.str().find("\"1500000000.500000000\"") != string::npos);
+    REQUIRE(cf::CCollectionInfo::TimeString(int64_t{ seconds } * 1000000000) == "1500000000");
+    REQUIRE(cf::CCollectionInfo::TimeString(-1) == "-1.999999999");
+    REQUIRE(cf::CCollectionInfo::ParseTime("-1.999999999") == -1);
+    REQUIRE(cf::CCollectionInfo::ParseTime("1500000000.5") == int64_t{ seconds } * 1000000000 + 500000000);
+    REQUIRE_THROWS_AS(cf::CCollectionInfo::ParseTime("1500000000.5x"), std::invalid_argument);
+    REQUIRE_THROWS_AS(cf::CCollectionInfo::ParseTime("99999999999999999"), std::out_of_range);
+
+    // The fraction of second is written in decimal on 9 digits, in a snapshot tagged as such
+    set_time(folder / "right" / "file", seconds, 5000);
+    const auto json_ns = cf::ScanFolder((folder / "right").string(), cf::eCollectingAlgorithm::FAST);
+    REQUIRE(json_ns.find("\"fast_ns\"") != string::npos);
+    REQUIRE(json_ns.find("\"59682F009.000005000\"") != string::npos);
+
+    // The snapshots of the former versions, in whole seconds, remain comparable: the fractions are ignored
+    const fs::path path_old{ fs::temp_directory_path() / "compare_folder_nanoseconds_old.json" };
+    const fs::path path_ns{ fs::temp_directory_path() / "compare_folder_nanoseconds_ns.json" };
+    {
+        std::ofstream stream_old{ path_old.string(), ios::out };
+        stream_old << "{\n"
+            "    \"Generator\": \"info.xtof.COMPARE_FOLDERS\",\n"
+            "    \"hash\": \"fast\",\n"
+            "    \"root\": \"right\",\n"
+            "    \"files\": {\n"
+            "        \"file\": {\n"
+            "            \"hash\": \"59682F009\",\n"
+            "            \"last_modified\": \"1500000000\",\n"
+            "            \"size\": \"9\"\n"
+            "        }\n"
+            "    }\n"
+            "}\n";
+        std::ofstream stream_ns{ path_ns.string(), ios::out };
+        stream_ns << json_ns;
+    }
+    const cf::json_t json_old{ path_old.string() };
+    for (const size_t budget : { 0u, 4096u }) {
+        cf::options_t options;
+        options.memory_budget = budget;
+        diff = cf::CompareFolders((folder / "right").string(), json_old, make_unique<cf::CLoggerNull>(), options);
+        REQUIRE(diff.identical == list<string>{ "file" });
+        diff = cf::CompareFolders(cf::json_t{ path_ns.string() }, json_old, options);
+        REQUIRE(diff.identical == list<string>{ "file" });
+    }
+    const auto collection_old = cf::AFactoryInfo::ReadInfo(path_old);
+    REQUIRE(collection_old.secondsOnly());
+    REQUIRE(collection_old.find("file")->time_modified_ns == int64_t{ seconds } * 1000000000);
+    REQUIRE(cf::AFactoryInfo::ReadInfo(path_ns).find("file")->time_modified_ns == int64_t{ seconds } * 1000000000 + 5000);
+    REQUIRE(collection_old.json().find("\"fast\"") != string::npos);
+
+    fs::remove(path_old);
+    fs::remove(path_ns);
+    fs::remove_all(folder);
+}
+#endif
+
+#ifndef _WIN32
+TEST_CASE("SYMBOLIC LINKS")
+{
+    // The links to files are followed, the others are skipped
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_links" };
+    fs::remove_all(folder);
+    fs::create_directories(folder / "directory");
+    {
+        std::ofstream stream{ (folder / "file").string(), ios::out | ios::binary };
+        stream << "content";
+    }
+    fs::create_symlink(folder / "file", folder / "link_file");
+    fs::create_symlink(folder / "directory", folder / "link_directory");
+    fs::create_symlink(folder / "missing", folder / "link_dangling");
+
+    for (const auto algo : { cf::eCollectingAlgorithm::SECURE, cf::eCollectingAlgorithm::FAST }) {
+        const auto json = cf::ScanFolder(folder.string(), algo);
+        REQUIRE(json.find("\"file\"") != string::npos);
+        REQUIRE(json.find("\"link_file\"") != string::npos);
+        REQUIRE(json.find("link_directory") == string::npos);
+        REQUIRE(json.find("link_dangling") == string::npos);
+    }
+    const auto diff = cf::CompareFolders(folder.string(), folder.string(), cf::eCollectingAlgorithm::SECURE);
+    REQUIRE(diff.identical == list<string>{ "file", "link_file" });
+
+    fs::remove_all(folder);
+}
+#endif
+
+TEST_CASE("TRACE")
+{
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_trace" };
+    const fs::path path_trace{ fs::temp_directory_path() / "compare_folder_trace.json" };
+    fs::remove_all(folder);
+    fs::remove(path_trace);
+    fs::create_directories(folder / "sub");
+    for (auto i = 0u; i < 10u; ++i) {
+        std::ofstream stream{ (folder / "sub" / to_string(i)).string(), ios::out | ios::binary };
+        stream << string(1000u * i, 'x');
+    }
+
+    // Not traced by default
+    cf::options_t options;
+    cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options);
+    REQUIRE(!fs::exists(path_trace));
+
+    options.path_trace = path_trace.string();
+    cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options);
+    REQUIRE(fs::exists(path_trace));
+
+    pt::ptree trace;
+    pt::read_json(path_trace.string(), trace);
+    map<string, unsigned> spans;
+    auto nb_hashers = 0u;
+    for (const auto& event : trace.get_child("traceEvents")) {
+        const auto phase = event.second.get<string>("ph");
+        if (phase == "X") {
+            REQUIRE(event.second.get<double>("dur") >= 0.0);
+            ++spans[event.second.get<string>("name")];
+        }
+        else if (phase == "M" && event.second.get<string>("args.name").find("hasher") == 0u) {
+            ++nb_hashers;
+        }
+    }
+    REQUIRE(spans["walk"] >= 1u);
+    REQUIRE(spans["open"] == 10u);
+    REQUIRE(spans["read"] >= 9u);
+    REQUIRE(spans["hash"] >= 1u); // the small files may be hashed together
+    REQUIRE(spans["serialize"] == 1u);
+    REQUIRE(nb_hashers >= 1u);
+
+    // The recording stopped with the scan
+    fs::remove(path_trace);
+    options.path_trace.clear();
+    cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options);
+    REQUIRE(!fs::exists(path_trace));
+
+    fs::remove_all(folder);
+}
+
+#ifndef _WIN32
+TEST_CASE("HARD LINKS")
+{
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_links" };
+    fs::remove_all(folder);
+    fs::create_directories(folder / "sub");
+    {
+        std::ofstream stream{ (folder / "original").string(), ios::out | ios::binary };
+        stream << "1234567890";
+    }
+    fs::create_hard_link(folder / "original", folder / "link");
+    fs::create_hard_link(folder / "original", folder / "sub/link");
+
+    // The inode is read once, but all its links are recorded with its hash
+    cf::options_t options;
+    options.period_progress_ms = 10u;
+    cf::progress_t progress{ 0u, 0u, 0u, 0u, 0.0 };
+    const auto json = cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE, make_unique<CLoggerProgress>(progress), options);
+    REQUIRE(progress.files_hashed == 3u);
+    REQUIRE(progress.bytes_hashed == 10u);
+
+    const fs::path path_json{ fs::temp_directory_path() / "compare_folder_links.json" };
+    {
+        std::ofstream stream{ path_json.string(), ios::out };
+        stream << json;
+    }
+    const auto collection = cf::AFactoryInfo::ReadInfo(path_json);
+    REQUIRE(collection.size() == 3u);
+    const auto original = collection.find("original");
+    REQUIRE(original != nullptr);
+    REQUIRE(collection.find("link")->hash == original->hash);
+    REQUIRE(collection.find("sub/link")->hash == original->hash);
+
+    fs::remove(path_json);
+    fs::remove_all(folder);
+}
+#endif
+
+
+TEST_CASE("CANCELLATION")
+{
+    const auto cancelled = [](const std::function<void()>& operation) {
+        try {
+            operation();
+        }
+        catch (const cf::ExceptionCancelled&) {
+            return true;
+        }
+        return false;
+    };
+
+    // A cancelled token stops any scan or comparison
+    auto token = make_shared<cf::CCancelToken>();
+    cf::options_t options;
+    options.cancel = token;
+    REQUIRE(!cancelled([&options] { cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options); }));
+    token->cancel();
+    REQUIRE(cancelled([&options] { cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options); }));
+    REQUIRE(cancelled([&options] { cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::FAST, make_unique<cf::CLoggerNull>(), options); }));
+    REQUIRE(cancelled([&options] { cf::CompareFolders(Folders.first.string(), Folders.second.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options); }));
+
+    // So does an exceeded deadline
+    options.cancel = nullptr;
+    options.deadline = chrono::steady_clock::now();
+    REQUIRE(cancelled([&options] { cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options); }));
+    options.deadline = chrono::steady_clock::now() + chrono::hours{ 1 };
+    REQUIRE(!cancelled([&options] { cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options); }));
+}
+
+
+TEST_CASE("UNREADABLE FILES")
+{
+    // Unreadable files are reported as different, unless missing from the other side
+    cf::CCollectionInfo left{ "left", cf::eCollectingAlgorithm::SECURE };
+    left.setInfo("a/x", { "11", 0, 1u });
+    left.setInfo("a/y", { "22", 0, 1u });
+    left.setError("a/z", "Permission denied");
+    left.setError("b", "Permission denied");
+    left.setError("c", "Permission denied");
+    cf::CCollectionInfo right{ "right", cf::eCollectingAlgorithm::SECURE };
+    right.setInfo("a/x", { "11", 0, 1u });
+    right.setError("a/y", "Permission denied");
+    right.setInfo("a/z", { "33", 0, 1u });
+    right.setError("b", "Permission denied");
+    right.setError("d", "Permission denied");
+    auto diff = left.compare(right);
+    diff.different.sort();
+    REQUIRE(diff.identical == list<string>{ "a/x" });
+    REQUIRE(diff.different == list<string>{ "a/y", "a/z", "b" });
+    REQUIRE(diff.unique_left == list<string>{ "c" });
+    REQUIRE(diff.unique_right == list<string>{ "d" });
+    REQUIRE(diff.renamed.empty());
+
+    // Hashing a file again clears its error
+    right.setInfo("a/y", { "22", 0, 1u });
+    REQUIRE(right.errors().size() == 2u);
+
+    // The errors are stored in the snapshots
+    const fs::path path_json{ fs::temp_directory_path() / "compare_folder_errors.json" };
+    {
+        std::ofstream stream{ path_json.string(), ios::out };
+        stream << left.json();
+    }
+    const auto loaded = cf::AFactoryInfo::ReadInfo(path_json);
+    REQUIRE(loaded.errors() == left.errors());
+    REQUIRE(loaded.size() == left.size());
+    fs::remove(path_json);
+
+#ifndef _WIN32
+    // The scan goes on when a file cannot be read
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_unreadable" };
+    fs::remove_all(folder);
+    fs::create_directories(folder);
+    {
+        std::ofstream stream{ (folder / "readable").string(), ios::out | ios::binary };
+        stream << "readable";
+    }
+    {
+        std::ofstream stream{ (folder / "unreadable").string(), ios::out | ios::binary };
+        stream << "unreadable";
+    }
+    fs::permissions(folder / "unreadable", fs::no_perms);
+    const bool isReadable = static_cast<bool>(std::ifstream{ (folder / "unreadable").string() }); // Always readable by root
+    if (!isReadable) {
+        {
+            std::ofstream stream{ path_json.string(), ios::out };
+            stream << cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE);
+        }
+        const auto scanned = cf::AFactoryInfo::ReadInfo(path_json);
+        REQUIRE(scanned.size() == 1u);
+        REQUIRE(scanned.errors().size() == 1u);
+        REQUIRE(scanned.errors().begin()->first == "unreadable");
+        fs::remove(path_json);
+    }
+    fs::permissions(folder / "unreadable", fs::owner_read | fs::owner_write);
+    fs::remove_all(folder);
+#endif
+}
+
+
+TEST_CASE("MEMORY BUDGET")
+{
+    const fs::path folder_temp{ fs::temp_directory_path() / "compare_folder_spill" };
+    fs::remove_all(folder_temp);
+    fs::create_directories(folder_temp);
+
+    // Spilled entries are merged back in order, errors included
+    cf::CCollectionInfo expected{ "root", cf::eCollectingAlgorithm::SECURE };
+    {
+        cf::CCollectionSpill spill{ "root", cf::eCollectingAlgorithm::SECURE, 1u, folder_temp };
+        const array<string, 4> paths{ { "b/y", "a", "c", "b/x" } };
+        for (const auto& path : paths) {
+            spill.setInfo(path, { path + "00", 1, 2u });
+            expected.setInfo(path, { path + "00", 1, 2u });
+        }
+        spill.setError("b/z", "Permission denied");
+        expected.setError("b/z", "Permission denied");
+        REQUIRE(spill.runs() == 5u);
+        REQUIRE(spill.size() == 5u);
+
+        list<string> visited;
+        spill.visit([&visited](const cf::CCollectionSpill::entry_t& entry) {
+            visited.push_back(entry.path);
+        });
+        REQUIRE(visited == list<string>{ "a", "b/x", "b/y", "b/z", "c" });
+        std::ostringstream stream;
+        spill.json(stream);
+        REQUIRE(Without_Scan_Time(stream.str()) == Without_Scan_Time(expected.json()));
+        std::ostringstream stream_digests;
+        spill.json(stream_digests, true);
+        REQUIRE(Without_Scan_Time(stream_digests.str()) == Without_Scan_Time(expected.json(true)));
+    }
+    REQUIRE(fs::is_empty(folder_temp)); // The runs are removed
+
+    // Too many runs to be opened at once: they are merged by groups first, keeping the order
+    {
+        const auto nb_runs = 3u * cf::CSorterExternal::MAX_RUNS_MERGED + 5u;
+        cf::CSorterExternal sorter{ 1u, folder_temp };
+        for (auto i = 0u; i < nb_runs; ++i) {
+            sorter.add(to_string((i * 7u) % 10u), to_string(i));
+        }
+        REQUIRE(sorter.runs() == nb_runs);
+        auto reader = sorter.read();
+        REQUIRE(sorter.runs() <= cf::CSorterExternal::MAX_RUNS_MERGED);
+        cf::CSorterExternal::record_t record, previous;
+        auto nb_records = 0u;
+        while (reader.next(record)) {
+            if (nb_records++ != 0u) { // sorted by key, then stable
+                REQUIRE(previous.first <= record.first);
+                REQUIRE((previous.first != record.first || stoul(previous.second) < stoul(record.second)));
+            }
+            previous = record;
+        }
+        REQUIRE(nb_records == nb_runs);
+    }
+    REQUIRE(fs::is_empty(folder_temp));
+
+    // Streamed scans with a tiny budget produce the same JSON
+    cf::options_t options;
+    options.memory_budget = 4096u;
+    options.path_temp = folder_temp.string();
+    for (const auto algo : { cf::eCollectingAlgorithm::SECURE, cf::eCollectingAlgorithm::FAST }) {
+        std::ostringstream stream;
+        cf::ScanFolder(Folders.first.string(), algo, stream, make_unique<cf::CLoggerNull>(), options);
+        REQUIRE(Without_Scan_Time(stream.str()) == Without_Scan_Time(cf::ScanFolder(Folders.first.string(), algo)));
+        REQUIRE(fs::is_empty(folder_temp));
+    }
+
+    fs::remove_all(folder_temp);
+}
+
+
+TEST_CASE("MULTI-BUFFER")
+{
+    /// @brief Hashes the small files in SIMD lanes whenever available, even if the processor's SHA instructions are faster
+    class CFactoryMulti : public cf::CFactoryInfoSecure
+    {
+    public:
+        using cf::CFactoryInfoSecure::CFactoryInfoSecure;
+    protected:
+        bool multiBuffer(const std::string&) const override { return cf::CHasherMulti::Lanes() > 1u; }
+    };
+
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_multi" };
+    fs::remove_all(folder);
+    fs::create_directories(folder);
+    for (const auto size : { 0u, 1u, 55u, 56u, 63u, 64u, 65u, 119u, 120u, 1000u, 4096u, 16384u, 16385u }) {
+        std::ofstream stream{ (folder / to_string(size)).string(), ios::out | ios::binary };
+        stream << string(size, static_cast<char>('a' + size % 26u));
+    }
+
+    // The small files hashed several at once have the same hashes as when hashed one by one
+    cf::options_t options;
+    options.size_multi_buffer = 0u;
+    for (const auto& root : { Folders.first, folder }) {
+        const auto expected = cf::CFactoryInfoSecure{ make_unique<cf::CLoggerNull>(), options }.collectInfo(root);
+        CFactoryMulti factory{ make_unique<cf::CLoggerNull>() };
+        REQUIRE(Without_Scan_Time(factory.collectInfo(root).json()) == Without_Scan_Time(expected.json()));
+    }
+
+    fs::remove_all(folder);
+}
+
+
+TEST_CASE("STAT DEPTH")
+{
+    const fs::path folder_temp{ fs::temp_directory_path() / "compare_folder_depth" };
+    fs::remove_all(folder_temp);
+    fs::create_directories(folder_temp);
+
+    // The fast scan does not depend on the number of statuses requested at once, capped to a sane number of threads
+    const auto json_fast = cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::FAST);
+    for (const auto depth : { 0u, 1u, 2u, 64u, 100000u }) {
+        cf::options_t options;
+        options.depth_stat = depth;
+        REQUIRE(Without_Scan_Time(cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::FAST, make_unique<cf::CLoggerNull>(), options)) == Without_Scan_Time(json_fast));
+        std::ostringstream stream;
+        options.memory_budget = 4096u;
+        options.path_temp = folder_temp.string();
+        cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::FAST, stream, make_unique<cf::CLoggerNull>(), options);
+        REQUIRE(Without_Scan_Time(stream.str()) == Without_Scan_Time(json_fast));
+        REQUIRE(fs::is_empty(folder_temp));
+    }
+
+    fs::remove_all(folder_temp);
+}
+
+
+TEST_CASE("EXTERNAL COMPARISON")
+{
+    const fs::path folder_temp{ fs::temp_directory_path() / "compare_folder_external" };
+    fs::remove_all(folder_temp);
+    fs::create_directories(folder_temp);
+
+    // Duplicates, renamed and unreadable files: same result as in memory
+    cf::CCollectionInfo left{ "left", cf::eCollectingAlgorithm::SECURE };
+    cf::CCollectionInfo right{ "right", cf::eCollectingAlgorithm::SECURE };
+    {
+        cf::CCollectionSpill spill_left{ "left", cf::eCollectingAlgorithm::SECURE, 1u, folder_temp };
+        cf::CCollectionSpill spill_right{ "right", cf::eCollectingAlgorithm::SECURE, 1u, folder_temp };
+        const auto add = [](cf::CCollectionInfo& collection, cf::CCollectionSpill& spill, const string& path, const string& hash) {
+            collection.setInfo(path, { hash, 0, 1u });
+            spill.setInfo(path, { hash, 0, 1u });
+        };
+        const auto addError = [](cf::CCollectionInfo& collection, cf::CCollectionSpill& spill, const string& path) {
+            collection.setError(path, "Permission denied");
+            spill.setError(path, "Permission denied");
+        };
+        add(left, spill_left, "identical", "11");
+        add(right, spill_right, "identical", "11");
+        add(left, spill_left, "different", "22");
+        add(right, spill_right, "different", "33");
+        add(left, spill_left, "a/renamed", "44");
+        add(left, spill_left, "a/duplicate", "44");
+        add(right, spill_right, "b/renamed", "44");
+        add(right, spill_right, "b/duplicate", "44");
+        add(right, spill_right, "a/duplicate", "44");
+        add(left, spill_left, "unique", "55");
+        add(right, spill_right, "other", "66");
+        add(right, spill_right, "twin", "11");
+        addError(left, spill_left, "error/both");
+        addError(right, spill_right, "error/both");
+        addError(left, spill_left, "error/left");
+        add(right, spill_right, "error/left", "77");
+        addError(right, spill_right, "error/right");
+
+        REQUIRE(spill_left.runs() > 0u);
+        cf::diff_t diff;
+        cf::CDiffCollector collector{ diff };
+        spill_left.compare(spill_right, collector);
+        diff.root_left = "left";
+        diff.root_right = "right";
+        REQUIRE(diff == left.compare(right));
+        REQUIRE(diff.renamed.size() == 1u);
+    }
+    REQUIRE(fs::is_empty(folder_temp));
+
+    // The entries of both sides and the sort by hash stay within the budgets of both sides
+    for (const size_t budget : { 4096u, 65536u, 1048576u })
+    {
+        cf::CCollectionInfo left{ "left", cf::eCollectingAlgorithm::SECURE };
+        cf::CCollectionInfo right{ "right", cf::eCollectingAlgorithm::SECURE };
+        cf::CCollectionSpill spill_left{ "left", cf::eCollectingAlgorithm::SECURE, budget / 2u, folder_temp };
+        cf::CCollectionSpill spill_right{ "right", cf::eCollectingAlgorithm::SECURE, budget / 2u, folder_temp };
+        for (auto i = 0u; i < 500u; ++i) {
+            const auto hash = to_string(1000u + i);
+            left.setInfo("left/" + hash, { hash, 0, 1u });
+            spill_left.setInfo("left/" + hash, { hash, 0, 1u });
+            right.setInfo((i % 2u == 0u ? "left/" : "right/") + hash, { hash, 0, 1u });
+            spill_right.setInfo((i % 2u == 0u ? "left/" : "right/") + hash, { hash, 0, 1u });
+        }
+        cf::diff_t diff;
+        cf::CDiffCollector collector{ diff };
+        spill_left.compare(spill_right, collector);
+        diff.root_left = "left";
+        diff.root_right = "right";
+        REQUIRE(diff == left.compare(right));
+        REQUIRE(spill_left.peakCompare() > 0u);
+        REQUIRE(spill_left.peakCompare() <= budget);
+    }
+    REQUIRE(fs::is_empty(folder_temp));
+
+    // Folders and JSON files
+    cf::options_t options;
+    options.memory_budget = 8192u;
+    options.path_temp = folder_temp.string();
+    REQUIRE(cf::CompareFolders(Folders.first.string(), Folders.second.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options) ==
+        cf::CompareFolders(Folders.first.string(), Folders.second.string(), cf::eCollectingAlgorithm::SECURE));
+    const fs::path path_left{ fs::temp_directory_path() / "compare_folder_external_left.json" };
+    const fs::path path_right{ fs::temp_directory_path() / "compare_folder_external_right.json" };
+    {
+        std::ofstream stream{ path_left.string(), ios::out };
+        stream << cf::ScanFolder(Folders.first.string(), cf::eCollectingAlgorithm::SECURE);
+    }
+    {
+        std::ofstream stream{ path_right.string(), ios::out };
+        stream << cf::ScanFolder(Folders.second.string(), cf::eCollectingAlgorithm::SECURE);
+    }
+    const cf::json_t json_left{ path_left.string() };
+    const cf::json_t json_right{ path_right.string() };
+    REQUIRE(cf::CompareFolders(json_left, json_right, options) == cf::CompareFolders(json_left, json_right));
+    REQUIRE(cf::CompareFolders(Folders.first.string(), json_right, make_unique<cf::CLoggerNull>(), options) ==
+        cf::CompareFolders(Folders.first.string(), json_right));
+    REQUIRE(fs::is_empty(folder_temp));
+
+    fs::remove(path_left);
+    fs::remove(path_right);
+    fs::remove_all(folder_temp);
+}
+
+
+TEST_CASE("TREE GENERATOR")
+{
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_generator" };
+    fs::remove_all(folder);
+    spec_tree_t spec;
+    spec.seed = 42u;
+    spec.depth = 2u;
+    spec.nb_folders = 3u;
+    spec.nb_files = 20u;
+    spec.size_max = 4096u;
+    spec.ratio_duplicates = 0.1;
+    spec.ratio_modified = 0.1;
+    spec.ratio_renamed = 0.1;
+    spec.ratio_removed = 0.1;
+    spec.ratio_added = 0.1;
+
+    // The differences found are the expected ones
+    const cf::CFactoryInfoSecure factory{ make_unique<cf::CLoggerNull>() };
+    CTreeGenerator generator{ spec };
+    const auto expected = generator.generate(folder / "left", folder / "right", [&factory](const fs::path& path) {
+        return factory.collectFile(path).hash;
+    });
+    REQUIRE(generator.nbFilesLeft() == (1u + 3u + 9u) * 20u);
+    const auto diff = cf::CompareFolders((folder / "left").string(), (folder / "right").string(), cf::eCollectingAlgorithm::SECURE);
+    REQUIRE(diff == expected);
+    REQUIRE(!diff.different.empty());
+    REQUIRE(!diff.unique_left.empty());
+    REQUIRE(!diff.unique_right.empty());
+    REQUIRE(!diff.renamed.empty());
+    REQUIRE(diff.renamed.size() == expected.renamed.size());
+    for (const auto& renamed : expected.renamed) {
+        REQUIRE(find(begin(diff.renamed), end(diff.renamed), renamed) != end(diff.renamed));
+    }
+
+    // Same seed, same tree
+    CTreeGenerator{ spec }.generate(folder / "again");
+    const auto again = cf::CompareFolders((folder / "left").string(), (folder / "again").string(), cf::eCollectingAlgorithm::SECURE);
+    REQUIRE(again.identical.size() == generator.nbFilesLeft());
+    REQUIRE(again.different.empty());
+    REQUIRE(again.unique_left.empty());
+    REQUIRE(again.unique_right.empty());
+
+    // Inconsistent ratios
+    spec.ratio_removed = 0.9;
+    REQUIRE_THROWS_AS(CTreeGenerator{ spec }, std::invalid_argument);
+
+    fs::remove_all(folder);
+}
+
+#ifdef __linux__
+TEST_CASE("WATCH")
+{
+    const fs::path folder{ fs::temp_directory_path() / "compare_folder_watch" };
+    fs::remove_all(folder);
+    fs::create_directories(folder / "sub");
+    const auto write = [&folder](const string& name, const string& content) {
+        std::ofstream stream{ (folder / name).string(), ios::out | ios::binary };
+        stream << content;
+    };
+    write("unchanged", "unchanged");
+    write("modified", "before");
+    write("removed", "removed");
+    write("sub/moved", "moved");
+
+    cf::CWatcher watcher{ folder.string(), cf::eCollectingAlgorithm::SECURE };
+    REQUIRE(Without_Scan_Time(watcher.json()) == Without_Scan_Time(cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE)));
+
+    write("modified", "after");
+    write("added", "added");
+    fs::remove(folder / "removed");
+    fs::create_directories(folder / "new/deep");
+    write("new/deep/file", "file");
+    fs::rename(folder / "sub", folder / "renamed");
+
+    // The events are applied asynchronously
+    const auto json = cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE);
+    for (auto i = 0u; i < 100u && Without_Scan_Time(watcher.json()) != Without_Scan_Time(json); ++i) {
+        this_thread::sleep_for(chrono::milliseconds{ 50 });
+    }
+    REQUIRE(Without_Scan_Time(watcher.json()) == Without_Scan_Time(json));
+    REQUIRE(watcher.changes() > 0u);
+    const auto diff = watcher.compare(folder.string());
+    REQUIRE(diff.identical.size() == 5u);
+    REQUIRE(diff.different.empty());
+    REQUIRE(diff.unique_left.empty());
+    REQUIRE(diff.unique_right.empty());
+
+    // A file that exists but cannot be read is recorded as an error, not removed
+    class CFactoryUnreadable : public cf::CFactoryInfoSecure
+    {
+    public:
+        using cf::CFactoryInfoSecure::CFactoryInfoSecure;
+        cf::CCollectionInfo::info_t collectFile(const fs::path& path) const override {
+            if (path.filename() == "unreadable") {
+                throw cf::Exception{ "Cannot read " + path.string() };
+            }
+            return cf::CFactoryInfoSecure::collectFile(path);
+        }
+    };
+    cf::CWatchFolder watch_unreadable{ folder, make_unique<CFactoryUnreadable>(make_unique<cf::CLoggerNull>()) };
+    const auto count_errors = [&watch_unreadable] {
+        const auto json = watch_unreadable.json();
+        auto count = 0u;
+        for (auto pos = json.find("Cannot read"); pos != string::npos; pos = json.find("Cannot read", pos + 1u)) {
+            ++count;
+        }
+        return count;
+    };
+    write("unreadable", "unreadable");
+    fs::create_directories(folder / "other");
+    write("other/unreadable", "unreadable");
+    for (auto i = 0u; i < 100u && count_errors() != 2u; ++i) {
+        this_thread::sleep_for(chrono::milliseconds{ 50 });
+    }
+    REQUIRE(count_errors() == 2u);
+    REQUIRE(watch_unreadable.json().find("\"other/unreadable\": \"Error: Cannot read") != string::npos);
+    fs::remove(folder / "unreadable");
+    for (auto i = 0u; i < 100u && count_errors() != 1u; ++i) {
+        this_thread::sleep_for(chrono::milliseconds{ 50 });
+    }
+    REQUIRE(count_errors() == 1u);
+
+    // The cancellation token and the deadline only bound the first scan
+    const auto token = make_shared<cf::CCancelToken>();
+    cf::options_t options;
+    options.cancel = token;
+    options.deadline = chrono::steady_clock::now() + chrono::milliseconds{ 500 };
+    cf::CWatcher bounded{ folder.string(), cf::eCollectingAlgorithm::SECURE, make_unique<cf::CLoggerNull>(), options };
+    token->cancel();
+    this_thread::sleep_until(options.deadline);
+    write("modified", "after the deadline");
+    const auto json_bounded = cf::ScanFolder(folder.string(), cf::eCollectingAlgorithm::SECURE);
+    for (auto i = 0u; i < 100u && Without_Scan_Time(bounded.json()) != Without_Scan_Time(json_bounded); ++i) {
+        this_thread::sleep_for(chrono::milliseconds{ 50 });
+    }
+    REQUIRE(Without_Scan_Time(bounded.json()) == Without_Scan_Time(json_bounded));
+    REQUIRE(bounded.compare(folder.string()).different.empty());
+
+    fs::remove_all(folder);
+}
+#endif
@@ -3,12 +3,14 @@
 
 
 #include "CProxyLogger.hpp"
+#include "TQueueMpsc.hpp"
 
 #include "catch.hpp"
 
 #include <list>
 #include <set>
 #include <thread>
+#include <vector>
 #include <algorithm>
 #include <chrono>
 
@@ -141,4 +143,46 @@ TEST_CASE("MESSAGING")
 }
 
 
+TEST_CASE("QUEUE MPSC")
+{
+    static constexpr int NB_PRODUCERS = 4;
+    static constexpr int NB_VALUES = 20000;
+    cf::TQueueMpsc<int> queue{ 8u }; // Small capacity: the producers will wrap around and wait for the consumer
+
+    list<thread> producers;
+    for (auto producer = 0; producer < NB_PRODUCERS; ++producer) {
+        producers.emplace_back([&queue, producer]() {
+            for (auto i = 0; i < NB_VALUES; ++i) {
+                queue.push(producer * NB_VALUES + i);
+            }
+        });
+    }
+
+    std::vector<int> last(NB_PRODUCERS, -1);
+    auto in_order = true;
+    auto nb_popped = 0;
+    auto value = 0;
+    while (nb_popped < NB_PRODUCERS * NB_VALUES && queue.pop(value)) {
+        const auto producer = value / NB_VALUES;
+        if (value % NB_VALUES != last[producer] + 1) { // The values of a producer are popped in order
+            in_order = false;
+        }
+        last[producer] = value % NB_VALUES;
+        ++nb_popped;
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    REQUIRE(nb_popped == NB_PRODUCERS * NB_VALUES);
+    REQUIRE(in_order);
+
+    // Stopping: the pending values are still popped
+    queue.push(1);
+    queue.stop();
+    REQUIRE(queue.pop(value));
+    REQUIRE(value == 1);
+    REQUIRE(!queue.pop(value));
+}
+
+
 #endif